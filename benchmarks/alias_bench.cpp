@@ -0,0 +1,99 @@
+// Alias expansion with a large alias table: the old path (a std::set for
+// loop detection and a re-tokenize of every body on every use) versus
+// bodies tokenized once with memoized chains.
+//
+// Usage: alias_bench [aliases] [iterations]
+// Global operator new is replaced to count allocations.
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "alias_manager.h"
+#include "shell_utils.h"
+
+static size_t allocation_count = 0;
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// The previous expansion: loop set allocated per command, bodies re-tokenized
+static std::vector<std::string> legacy_expand(const AliasManager& manager, const std::vector<std::string>& tokens,
+                                              std::set<std::string>& seen) {
+    if (tokens.empty() || !manager.has_alias(tokens[0])) return tokens;
+    if (seen.count(tokens[0])) throw std::runtime_error(tokens[0] + ": alias loop detected");
+    seen.insert(tokens[0]);
+    std::vector<std::string> body = tokenize_input(manager.get_alias(tokens[0]));
+    if (!body.empty()) body = legacy_expand(manager, body, seen);
+    body.insert(body.end(), tokens.begin() + 1, tokens.end());
+    seen.erase(tokens[0]);
+    return body;
+}
+
+struct Result {
+    double ns;
+    double allocations;
+};
+
+template <typename Body>
+static Result measure(int iterations, Body body) {
+    size_t before = allocation_count;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) body();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return {ns / iterations, static_cast<double>(allocation_count - before) / iterations};
+}
+
+static void report(const char* label, Result legacy, Result cached) {
+    std::printf("%-22s legacy %8.0f ns %5.1f allocs   cached %8.0f ns %5.1f allocs   speedup %6.1fx\n", label,
+                legacy.ns, legacy.allocations, cached.ns, cached.allocations, legacy.ns / cached.ns);
+}
+
+int main(int argc, char** argv) {
+    int alias_count = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+    AliasManager manager;
+    for (int i = 0; i < alias_count; ++i) {
+        manager.set_alias("g" + std::to_string(i), "git --no-pager log --oneline -n " + std::to_string(i));
+    }
+    // A three-deep chain: ll -> lsc -> lsx
+    manager.set_alias("lsx", "ls --group-directories-first");
+    manager.set_alias("lsc", "lsx --color=auto");
+    manager.set_alias("ll", "lsc -l -h");
+
+    const std::vector<std::string> plain = {"make", "-j8", "all"};
+    const std::vector<std::string> chained = {"ll", "src"};
+    std::vector<std::string> out;
+
+    auto legacy = [&](const std::vector<std::string>& tokens) {
+        return measure(iterations, [&] {
+            std::set<std::string> seen;
+            out = legacy_expand(manager, tokens, seen);
+        });
+    };
+    auto cached = [&](const std::vector<std::string>& tokens) {
+        return measure(iterations, [&] {
+            out.clear();
+            manager.expand_aliases(tokens, out);
+        });
+    };
+    report("not an alias", legacy(plain), cached(plain));
+    report("3-deep alias chain", legacy(chained), cached(chained));
+    return 0;
+}
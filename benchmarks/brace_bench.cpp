@@ -0,0 +1,66 @@
+// Argument lists from brace expansion versus $(seq ...), which forks a
+// process, and lazy generation of a three-way cartesian product versus
+// expanding it one brace at a time with every intermediate list held.
+//
+// Usage: brace_bench [count]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+#include "brace_expansion.h"
+#include "shell_utils.h"
+
+template <typename F>
+static double time_ms(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long max_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    std::string n = std::to_string(count);
+
+    size_t words = 0;
+    double brace_ms = time_ms([&] { words = tokenize_input("echo {1.." + n + "}").size(); });
+    std::printf("echo {1..%s}        %9.2f ms  %zu words\n", n.c_str(), brace_ms, words);
+    double seq_ms = time_ms([&] { words = tokenize_input("echo $(seq 1 " + n + ")").size(); });
+    std::printf("echo $(seq 1 %s)    %9.2f ms  %zu words\n", n.c_str(), seq_ms, words);
+
+    // 1M words of a{1..100}b{1..100}c{1..100}, only counted and discarded
+    std::string word = "a{1..100}b{1..100}c{1..100}";
+    long rss_before = max_rss_kb();
+    size_t bytes = 0;
+    double lazy_ms = time_ms([&] {
+        BraceExpansion braces(word);
+        std::string text;
+        while (braces.next(text)) bytes += text.size();
+    });
+    std::printf("lazy  %s  %9.2f ms  %zu bytes  peak RSS +%ld KB\n", word.c_str(), lazy_ms, bytes,
+                max_rss_kb() - rss_before);
+
+    rss_before = max_rss_kb();
+    bytes = 0;
+    double eager_ms = time_ms([&] {
+        std::vector<std::string> product = {""};
+        for (char prefix : std::string("abc")) {
+            std::vector<std::string> next;
+            for (const std::string& head : product) {
+                for (int i = 1; i <= 100; ++i) next.push_back(head + prefix + std::to_string(i));
+            }
+            product.swap(next);
+        }
+        for (const std::string& text : product) bytes += text.size();
+    });
+    std::printf("eager %s  %9.2f ms  %zu bytes  peak RSS +%ld KB\n", word.c_str(), eager_ms, bytes,
+                max_rss_kb() - rss_before);
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Cost of a pipeline of builtins run by the shell: `echo | cat | cat` with
+// the stages on worker threads, against the same pipeline with one stage
+// redirected, which makes the shell fork a copy of itself for every stage.
+//
+// Usage: builtin_pipe_bench [pipelines per run, default 1000]
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef SHELL_BINARY
+#define SHELL_BINARY "./build/shell"
+#endif
+
+extern char** environ;
+
+// Run the shell with -c script, stdout to /dev/null; returns the seconds taken
+static double run_shell(const std::string& script) {
+    std::vector<char*> argv = {const_cast<char*>("shell"), const_cast<char*>("-c"), const_cast<char*>(script.c_str()),
+                               nullptr};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    if (posix_spawn(&pid, SHELL_BINARY, &actions, nullptr, argv.data(), environ) == 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string repeat(const std::string& line, int count) {
+    std::string script;
+    for (int i = 0; i < count; ++i) script += line + '\n';
+    return script;
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 1000;
+    double baseline = run_shell("true");
+
+    struct Case {
+        const char* name;
+        const char* line;
+    };
+    for (Case c : {Case{"threads", "echo hello | cat | cat"},
+                   Case{"forked", "echo hello 2>/dev/null | cat | cat"}}) {
+        double seconds = run_shell(repeat(c.line, count)) - baseline;
+        std::printf("%-8s %8.1f us per pipeline\n", c.name, seconds / count * 1e6);
+    }
+    return 0;
+}
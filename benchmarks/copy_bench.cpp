@@ -0,0 +1,128 @@
+// Moving bytes with copy_fd() / tee_fd() (copy_file_range, sendfile,
+// splice, tee) versus a read()/write() loop like coreutils cat, for file to
+// file, file to pipe and pipe fan-out. The pipe's reader is a thread that
+// splices everything to /dev/null, so it costs the same in every run.
+//
+// Usage: copy_bench [megabytes, default 512]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "fd_copy.h"
+
+static void read_write(int in, const std::vector<int>& outs) {
+    std::vector<char> buffer(128 * 1024);
+    ssize_t n;
+    while ((n = read(in, buffer.data(), buffer.size())) > 0) {
+        for (int out : outs) {
+            for (ssize_t done = 0; done < n;) done += write(out, buffer.data() + done, n - done);
+        }
+    }
+}
+
+// Time copy(in, out) where out is a pipe drained by a thread
+template <typename Copy>
+static double into_pipe(int in, Copy copy) {
+    int fds[2];
+    if (pipe(fds) == -1) std::exit(1);
+    std::thread reader([fd = fds[0]] {
+        int null = open("/dev/null", O_WRONLY);
+        while (splice(fd, nullptr, null, nullptr, 1 << 20, SPLICE_F_MOVE) > 0) {
+        }
+        close(null);
+    });
+    auto start = std::chrono::steady_clock::now();
+    copy(in, fds[1]);
+    close(fds[1]);
+    reader.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    close(fds[0]);
+    return seconds;
+}
+
+template <typename Copy>
+static double file_to_file(const std::string& from, const std::string& to, Copy copy) {
+    int in = open(from.c_str(), O_RDONLY);
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    auto start = std::chrono::steady_clock::now();
+    copy(in, out);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    close(in);
+    close(out);
+    return seconds;
+}
+
+// A pipe fed from the file by a thread, so the copy under test reads a pipe
+template <typename Copy>
+static double from_pipe(const std::string& from, Copy copy) {
+    int fds[2];
+    if (pipe(fds) == -1) std::exit(1);
+    std::thread writer([&from, fd = fds[1]] {
+        int in = open(from.c_str(), O_RDONLY);
+        copy_fd(in, fd);
+        close(in);
+        close(fd);
+    });
+    double seconds = into_pipe(fds[0], copy);
+    writer.join();
+    close(fds[0]);
+    return seconds;
+}
+
+static void report(const char* label, double megabytes, double baseline, double kernel) {
+    std::printf("%-22s read/write %7.0f MB/s   copy_fd %7.0f MB/s   (%.1fx)\n", label, megabytes / baseline,
+                megabytes / kernel, baseline / kernel);
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+    std::string source = "/tmp/copy_bench_" + std::to_string(getpid());
+    std::string target = source + ".out";
+    std::string tee_target = source + ".tee";
+    {
+        std::vector<char> block(1 << 20, 'x');
+        int fd = open(source.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        for (size_t i = 0; i < megabytes; ++i) {
+            if (write(fd, block.data(), block.size()) != static_cast<ssize_t>(block.size())) return 1;
+        }
+        close(fd);
+    }
+    double mb = static_cast<double>(megabytes);
+
+    report("file -> file", mb, file_to_file(source, target, [](int in, int out) { read_write(in, {out}); }),
+           file_to_file(source, target, [](int in, int out) { copy_fd(in, out); }));
+
+    auto file_to_pipe = [&](auto copy) {
+        int in = open(source.c_str(), O_RDONLY);
+        double seconds = into_pipe(in, copy);
+        close(in);
+        return seconds;
+    };
+    report("file -> pipe", mb, file_to_pipe([](int in, int out) { read_write(in, {out}); }),
+           file_to_pipe([](int in, int out) { copy_fd(in, out); }));
+
+    report("pipe -> pipe", mb, from_pipe(source, [](int in, int out) { read_write(in, {out}); }),
+           from_pipe(source, [](int in, int out) { copy_fd(in, out); }));
+
+    auto tee_to = [&](bool kernel) {
+        return [&, kernel](int in, int out) {
+            int file = open(tee_target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (kernel) {
+                tee_fd(in, {file, out});
+            } else {
+                read_write(in, {file, out});
+            }
+            close(file);
+        };
+    };
+    report("pipe -> file + pipe", mb, from_pipe(source, tee_to(false)), from_pipe(source, tee_to(true)));
+
+    unlink(source.c_str());
+    unlink(target.c_str());
+    unlink(tee_target.c_str());
+    return 0;
+}
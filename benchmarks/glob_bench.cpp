@@ -0,0 +1,58 @@
+// Recursive glob (root/**/*.cpp) over a generated tree, at several thread counts.
+//
+// Usage: glob_bench [files] [directory]
+// The tree is created under the directory (default: a temp dir) and removed afterwards.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glob_utils.h"
+#include "shell_options.h"
+
+namespace fs = std::filesystem;
+
+static void generate_tree(const fs::path& root, size_t files) {
+    // 100 files per leaf directory, 50 leaves per top-level directory
+    size_t created = 0;
+    for (size_t top = 0; created < files; ++top) {
+        for (size_t leaf = 0; leaf < 50 && created < files; ++leaf) {
+            fs::path dir = root / ("top" + std::to_string(top)) / ("leaf" + std::to_string(leaf));
+            fs::create_directories(dir);
+            for (size_t f = 0; f < 100 && created < files; ++f, ++created) {
+                std::ofstream(dir / ("file" + std::to_string(f) + (f % 2 ? ".h" : ".cpp")));
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t files = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    fs::path root = (argc > 2 ? fs::path(argv[2]) : fs::temp_directory_path()) / "glob_bench_tree";
+
+    std::printf("generating %zu files under %s\n", files, root.c_str());
+    fs::remove_all(root);
+    generate_tree(root, files);
+
+    std::string pattern = (root / "**" / "*.cpp").string();
+    std::vector<unsigned> thread_counts = {1, 2, 4, 8};
+    unsigned hardware = std::thread::hardware_concurrency();
+    if (hardware > 8) thread_counts.push_back(hardware);
+
+    double single_ms = 0;
+    for (unsigned threads : thread_counts) {
+        set_shell_option("globthreads=" + std::to_string(threads));
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> matches = expand_single_pattern(pattern);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (threads == 1) single_ms = ms;
+        std::printf("threads %3u  %9.1f ms  %zu matches  speedup %5.2fx\n", threads, ms, matches.size(),
+                    single_ms / ms);
+    }
+
+    fs::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Sorting glob matches: std::sort against sort_matches at several thread counts.
+//
+// Usage: glob_sort_bench [names]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "glob_utils.h"
+#include "shell_options.h"
+
+template <typename F>
+static double time_ms(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    // Names shaped like a large source tree: a shared prefix and a shuffled tail
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        names.push_back("src/module" + std::to_string(i % 97) + "/file" + std::to_string(i) + ".cpp");
+    }
+    std::shuffle(names.begin(), names.end(), std::mt19937(42));
+
+    // A fresh copy for every run, so each sorts strings laid out the same way in memory
+    std::vector<std::string> work = names;
+    double base_ms = time_ms([&] { std::sort(work.begin(), work.end()); });
+    std::printf("std::sort      %9.1f ms  %zu names\n", base_ms, count);
+
+    std::vector<unsigned> thread_counts = {1, 2, 4, 8};
+    unsigned hardware = std::thread::hardware_concurrency();
+    if (hardware > 8) thread_counts.push_back(hardware);
+    for (unsigned threads : thread_counts) {
+        set_shell_option("globthreads=" + std::to_string(threads));
+        work.clear();
+        work.shrink_to_fit();
+        work = names;
+        double ms = time_ms([&] { sort_matches(work.begin(), work.end()); });
+        std::printf("threads %3u    %9.1f ms  speedup %5.2fx\n", threads, ms, base_ms / ms);
+    }
+    return 0;
+}
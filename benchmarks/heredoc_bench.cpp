@@ -0,0 +1,82 @@
+// Throughput of feeding a here-document to a command: the body written to a
+// temporary file on disk (what other shells do) versus open_here_document(),
+// which uses a pipe for small bodies and a memfd for large ones. Each round
+// creates the descriptor, writes the body and reads it all back.
+//
+// Usage: heredoc_bench [tmpdir]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "redirect_guard.h"
+
+static std::string tmpdir = "/tmp";
+static std::vector<char> read_buffer(1 << 16);
+
+static void write_all(int fd, const std::string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t n = write(fd, text.data() + done, text.size() - done);
+        if (n <= 0) {
+            perror("write");
+            std::exit(1);
+        }
+        done += n;
+    }
+}
+
+static size_t drain(int fd) {
+    size_t total = 0;
+    ssize_t n;
+    while ((n = read(fd, read_buffer.data(), read_buffer.size())) > 0) total += n;
+    close(fd);
+    return total;
+}
+
+static int open_tmpfile(const std::string& body) {
+    std::string path = tmpdir + "/heredoc_bench.XXXXXX";
+    int fd = mkstemp(path.data());
+    if (fd < 0) {
+        perror("mkstemp");
+        std::exit(1);
+    }
+    unlink(path.c_str());
+    write_all(fd, body);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+template <typename Open>
+static double mb_per_second(const std::string& body, int rounds, Open open_body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        if (drain(open_body(body)) != body.size()) {
+            std::fprintf(stderr, "short read\n");
+            std::exit(1);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return body.size() * static_cast<double>(rounds) / seconds / 1e6;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) tmpdir = argv[1];
+
+    struct Size {
+        const char* label;
+        size_t bytes;
+        int rounds;
+    };
+    for (Size size : {Size{"1 KB", 1024, 20000}, Size{"1 MB", 1 << 20, 200}, Size{"100 MB", 100 << 20, 3}}) {
+        std::string body(size.bytes, 'x');
+        double tmpfile = mb_per_second(body, size.rounds, open_tmpfile);
+        double memory = mb_per_second(body, size.rounds, [](const std::string& text) {
+            return open_here_document(text);
+        });
+        std::printf("%-7s tmpfile %9.1f MB/s   pipe/memfd %9.1f MB/s   (%.1fx)\n", size.label, tmpfile, memory,
+                    memory / tmpfile);
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Persistent history at scale: append cost, index build time, and search
+// through the trigram index versus scanning every entry.
+//
+// Usage: history_bench [entries]
+// The history file is written to the temporary directory and removed afterwards.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "history_store.h"
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t entries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    namespace fs = std::filesystem;
+    std::string path = (fs::temp_directory_path() / "history_bench").string();
+    fs::remove(path);
+    fs::remove(path + ".idx");
+
+    const char* commands[] = {"git status", "make -j8", "ls -la", "cd src", "grep -rn TODO", "vim main.cpp"};
+    HistoryStore store;
+    store.open(path, entries * 2);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < entries; ++i) {
+        store.append(std::string(commands[i % 6]) + " # " + std::to_string(i));
+    }
+    double append_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    store.rebuild_index();
+    double index_ms = elapsed_ms(start);
+
+    // Scan baseline: every entry read and searched, as `history | grep` would
+    auto scan = [&](const std::string& text) {
+        size_t found = 0;
+        for (const HistoryEntry& entry : store.recent(entries)) {
+            if (entry.line.find(text) != std::string::npos && ++found == 20) break;
+        }
+    };
+    std::string rare = "# " + std::to_string(entries / 3);
+    for (const std::string& query : {rare, std::string("vim main")}) {
+        start = std::chrono::steady_clock::now();
+        store.search(query, 20);
+        double indexed_ms = elapsed_ms(start);
+        start = std::chrono::steady_clock::now();
+        scan(query);
+        double scan_ms = elapsed_ms(start);
+        std::printf("search %-14s indexed %9.3f ms   full scan %9.1f ms\n", ('"' + query + '"').c_str(), indexed_ms,
+                    scan_ms);
+    }
+    std::printf("%zu entries: append %.2f us each, index build %.0f ms, log %.1f MiB, index %.1f MiB\n", entries,
+                append_ms * 1000 / entries, index_ms, fs::file_size(path) / 1048576.0,
+                fs::file_size(path + ".idx") / 1048576.0);
+
+    store.close();
+    fs::remove(path);
+    fs::remove(path + ".idx");
+    return 0;
+}
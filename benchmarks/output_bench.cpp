@@ -0,0 +1,63 @@
+// Syscalls and time for builtin output with the old per-fragment flushing
+// (std::unitbuf) versus one buffered writev() batch per command.
+//
+// Usage: output_bench [echo_iterations] [history_entries]
+// Output goes to /dev/null.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <readline/history.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "output_buffer.h"
+#include "shell_utils.h"
+
+struct Result {
+    size_t write_calls;
+    double ms;
+};
+
+template <typename Body>
+static Result measure(bool unitbuf, Body body) {
+    int fd = open("/dev/null", O_WRONLY);
+    FdOutputBuffer buffer(fd);
+    std::streambuf* old = std::cout.rdbuf(&buffer);
+    if (unitbuf) std::cout << std::unitbuf;
+
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::cout.flush();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::nounitbuf;
+    std::cout.rdbuf(old);
+    Result result{buffer.write_calls(), ms};
+    close(fd);
+    return result;
+}
+
+static void report(const char* label, Result unbuffered, Result buffered) {
+    std::printf("%-10s unitbuf %9zu writes %9.1f ms   buffered %9zu writes %9.1f ms   speedup %5.2fx\n", label,
+                unbuffered.write_calls, unbuffered.ms, buffered.write_calls, buffered.ms, unbuffered.ms / buffered.ms);
+}
+
+int main(int argc, char** argv) {
+    int echo_iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int history_entries = argc > 2 ? std::atoi(argv[2]) : 50000;
+
+    const std::vector<std::string> echo = {"echo", "hello", "buffered", "world"};
+    auto echo_loop = [&] {
+        for (int i = 0; i < echo_iterations; ++i) execute_command(echo);
+    };
+    report("echo loop", measure(true, echo_loop), measure(false, echo_loop));
+
+    for (int i = 0; i < history_entries; ++i) {
+        add_history(("command number " + std::to_string(i)).c_str());
+    }
+    auto history = [] { execute_command({"history"}); };
+    report("history", measure(true, history), measure(false, history));
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Heap allocations and time to turn a command line into commands: the old
+// multi-pass path (split on operators, re-tokenize each segment one char at a
+// time, copy for globbing, copy again into ParsedCommand) versus the
+// single-pass lexer/parser building its AST in a per-line arena.
+//
+// Usage: parser_bench [iterations]
+// Global operator new is replaced to count allocations.
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "command_parser.h"
+#include "line_parser.h"
+
+static size_t allocation_count = 0;
+
+void* operator new(std::size_t size) {
+    ++allocation_count;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// The previous tokenizer's quoting rules (substitution and variables left out)
+static std::vector<std::string> legacy_tokenize(const std::string& input) {
+    std::vector<std::string> tokens;
+    std::string token;
+    enum class State { Normal, Single, Double } state = State::Normal;
+    for (size_t i = 0; i < input.size(); ++i) {
+        char c = input[i];
+        if (state == State::Normal) {
+            if (c == ' ' || c == '\t') {
+                if (!token.empty()) tokens.push_back(token);
+                token.clear();
+            } else if (c == '\'') {
+                state = State::Single;
+            } else if (c == '"') {
+                state = State::Double;
+            } else if (c == '\\' && i + 1 < input.size()) {
+                token += input[++i];
+            } else {
+                token += c;
+            }
+        } else if ((state == State::Single && c == '\'') || (state == State::Double && c == '"')) {
+            state = State::Normal;
+        } else {
+            token += c;
+        }
+    }
+    if (!token.empty()) tokens.push_back(token);
+    return tokens;
+}
+
+// The previous per-line pipeline: split, tokenize, copy for globbing, parse_redirection()
+static size_t legacy_parse(const std::string& input) {
+    size_t commands = 0;
+    std::string current_command;
+    auto flush = [&] {
+        if (current_command.empty()) return;
+        std::vector<std::string> tokens = legacy_tokenize(current_command);
+        std::vector<std::string> expanded(tokens.begin(), tokens.end());
+        ParsedCommand cmd = parse_redirection(expanded);
+        commands += cmd.pipeline.size();
+        current_command.clear();
+    };
+    for (size_t i = 0; i < input.size(); ++i) {
+        char c = input[i];
+        if (c == ';') {
+            flush();
+        } else if ((c == '&' || c == '|') && i + 1 < input.size() && input[i + 1] == c) {
+            flush();
+            ++i;
+        } else {
+            current_command += c;
+        }
+    }
+    flush();
+    return commands;
+}
+
+static size_t arena_parse(const std::string& input) {
+    std::byte initial_buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(initial_buffer, sizeof(initial_buffer));
+    CommandLine line = parse_line(input, arena);
+    size_t commands = 0;
+    for (const auto& list : line.lists) {
+        for (const auto& item : list.items) commands += item.pipeline.commands.size();
+    }
+    return commands;
+}
+
+template <typename Parse>
+static void measure(const char* label, const std::string& input, int iterations, Parse parse) {
+    size_t sink = 0;
+    size_t before = allocation_count;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) sink += parse(input);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double allocations = static_cast<double>(allocation_count - before) / iterations;
+    std::printf("  %-8s %8.1f allocs/line %9.1f ns/line  (%zu commands)\n", label, allocations, ns / iterations,
+                sink / iterations);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    const std::vector<std::string> lines = {
+        "ls -la /tmp",
+        "echo 'hello world' | grep hello > out.txt",
+        "git commit -m \"fix the build\" && echo done || echo failed; pwd",
+        "cat access.log | grep -v healthcheck | cut -d' ' -f1 | sort | uniq -c | sort -rn | head -20 >> report.txt",
+    };
+    for (const auto& line : lines) {
+        std::printf("%s\n", line.c_str());
+        measure("legacy", line, iterations, legacy_parse);
+        measure("arena", line, iterations, arena_parse);
+    }
+    return 0;
+}
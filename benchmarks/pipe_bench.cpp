@@ -0,0 +1,70 @@
+// Throughput of a `yes | head -c N` pipeline run by the shell at different
+// `set -o pipesize` values, with the context switches its stages made.
+// Larger pipes let the producer and consumer each run longer per wakeup.
+//
+// Usage: pipe_bench [bytes, default 1G; K/M/G suffixes as for head -c]
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef SHELL_BINARY
+#define SHELL_BINARY "./build/shell"
+#endif
+
+extern char** environ;
+
+struct Run {
+    double seconds;
+    long context_switches;
+};
+
+// Run the shell with -c script, stdout to /dev/null, and measure it and its children
+static Run run_shell(const std::string& script) {
+    std::vector<char*> argv = {const_cast<char*>("shell"), const_cast<char*>("-c"), const_cast<char*>(script.c_str()),
+                               nullptr};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    rusage before{}, after{};
+    getrusage(RUSAGE_CHILDREN, &before);
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    if (posix_spawn(&pid, SHELL_BINARY, &actions, nullptr, argv.data(), environ) == 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    getrusage(RUSAGE_CHILDREN, &after);
+    posix_spawn_file_actions_destroy(&actions);
+
+    long switches = (after.ru_nvcsw - before.ru_nvcsw) + (after.ru_nivcsw - before.ru_nivcsw);
+    return {seconds, switches};
+}
+
+static double parse_bytes(const std::string& text) {
+    double value = std::stod(text);
+    switch (text.back()) {
+        case 'K': return value * 1024;
+        case 'M': return value * 1024 * 1024;
+        case 'G': return value * 1024 * 1024 * 1024;
+        default: return value;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string bytes = argc > 1 ? argv[1] : "1G";
+    double total = parse_bytes(bytes);
+
+    for (const char* size : {"default", "4K", "256K", "1M"}) {
+        Run run = run_shell(std::string("set -o pipesize=") + size + "; yes | head -c " + bytes);
+        std::printf("pipesize %-8s %8.0f MB/s   %8ld context switches\n", size, total / run.seconds / 1e6,
+                    run.context_switches);
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Startup and per-line overhead of non-interactive input.
+//
+// Usage: script_bench [lines] [startups]
+// Compares the old input path (readline + getcwd prompt per line) with the
+// buffered reader on the same file, then times the real shell binary on
+// `-c true` (startup) and on a script of `true` lines (per-line cost).
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <readline/readline.h>
+#include <spawn.h>
+#include <string>
+#include <string_view>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "line_reader.h"
+
+#ifndef SHELL_BINARY
+#define SHELL_BINARY "./build/shell"
+#endif
+
+extern char** environ;
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void run_shell(const std::vector<std::string>& args) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t pid;
+    if (posix_spawn(&pid, SHELL_BINARY, &actions, nullptr, argv.data(), environ) == 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+}
+
+int main(int argc, char** argv) {
+    size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int startups = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    std::string script = "/tmp/script_bench_" + std::to_string(getpid()) + ".sh";
+    {
+        std::ofstream out(script);
+        for (size_t i = 0; i < lines; ++i) out << "true\n";
+    }
+
+    // Input overhead only: readline with a getcwd() prompt per line
+    FILE* in = std::fopen(script.c_str(), "r");
+    FILE* null_out = std::fopen("/dev/null", "w");
+    rl_instream = in;
+    rl_outstream = null_out;
+    auto start = Clock::now();
+    size_t count = 0;
+    while (char* line = readline("$ ")) {
+        char cwd[4096];
+        if (getcwd(cwd, sizeof(cwd))) ++count;
+        free(line);
+    }
+    double readline_ms = elapsed_ms(start);
+    std::fclose(in);
+    std::fclose(null_out);
+
+    // Input overhead only: buffered reader
+    int fd = open(script.c_str(), O_RDONLY);
+    start = Clock::now();
+    BufferedLineReader reader(fd);
+    std::string_view line;
+    while (reader.next_line(line)) ++count;
+    double buffered_ms = elapsed_ms(start);
+    close(fd);
+
+    std::printf("input     readline+getcwd %8.1f ns/line   buffered reader %8.1f ns/line\n",
+                readline_ms * 1e6 / lines, buffered_ms * 1e6 / lines);
+
+    // The real binary: startup, then per-line cost of a script
+    start = Clock::now();
+    for (int i = 0; i < startups; ++i) run_shell({"shell", "-c", "true"});
+    double startup_ms = elapsed_ms(start) / startups;
+
+    start = Clock::now();
+    run_shell({"shell", script});
+    double script_ms = elapsed_ms(start);
+
+    std::printf("shell     startup %8.3f ms   script of %zu lines %8.1f ms (%.1f ns/line)\n", startup_ms, lines,
+                script_ms, (script_ms - startup_ms) * 1e6 / lines);
+
+    unlink(script.c_str());
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Startup cost of loading a large alias set: parsing the text alias file
+// (getline, trim, tokenize) versus mapping a binary state snapshot and
+// materializing aliases on first use.
+//
+// Usage: snapshot_bench [aliases] [runs]
+// Files are written to the temporary directory and removed afterwards.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "alias_manager.h"
+#include "command_hash.h"
+#include "state_snapshot.h"
+
+template <typename Body>
+static double best_ms(int runs, Body body) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    int alias_count = argc > 1 ? std::atoi(argv[1]) : 10000;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    namespace fs = std::filesystem;
+    std::string text_path = (fs::temp_directory_path() / "snapshot_bench_aliases.txt").string();
+    std::string snapshot_path = (fs::temp_directory_path() / "snapshot_bench.bin").string();
+
+    AliasManager source;
+    for (int i = 0; i < alias_count; ++i) {
+        source.set_alias("a" + std::to_string(i), "git --no-pager log --oneline -n " + std::to_string(i));
+    }
+    source.save_aliases_to_file(text_path);
+    write_snapshot(snapshot_path, source, CommandHash(), {});
+    const std::vector<std::string> command = {"a42", "--stat"};
+
+    double text_ms = best_ms(runs, [&] {
+        AliasManager manager;
+        manager.load_aliases_from_file(text_path);
+        manager.expand_aliases(command);
+    });
+    double snapshot_ms = best_ms(runs, [&] {
+        AliasManager manager;
+        manager.attach_snapshot(StateSnapshot::open(snapshot_path));
+        manager.expand_aliases(command);
+    });
+    double snapshot_all_ms = best_ms(runs, [&] {
+        AliasManager manager;
+        manager.attach_snapshot(StateSnapshot::open(snapshot_path));
+        manager.get_all_aliases();
+    });
+
+    std::printf("%d aliases, best of %d\n", alias_count, runs);
+    std::printf("text file, load + 1 expansion    %9.3f ms\n", text_ms);
+    std::printf("snapshot, map + 1 expansion      %9.3f ms  (%.0fx faster)\n", snapshot_ms, text_ms / snapshot_ms);
+    std::printf("snapshot, map + list all aliases %9.3f ms\n", snapshot_all_ms);
+
+    fs::remove(text_path);
+    fs::remove(snapshot_path);
+    return 0;
+}
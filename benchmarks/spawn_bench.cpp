@@ -0,0 +1,56 @@
+// Spawn latency of fork()+execv() versus posix_spawn() for /bin/true,
+// first in a small shell and then after bloating the heap and alias table.
+//
+// Usage: spawn_bench [iterations] [bloat_mb]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+#include "alias_manager.h"
+#include "shell_utils.h"
+#include "spawn_utils.h"
+
+static double spawn_latency_us(SpawnBackend backend, const std::string& path, int iterations) {
+    const std::vector<std::string> argv = {"true"};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        pid_t pid = spawn_process(backend, path, argv, {});
+        if (pid > 0) waitpid(pid, nullptr, 0);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+static void report(const char* label, const std::string& path, int iterations) {
+    double fork_us = spawn_latency_us(SpawnBackend::Fork, path, iterations);
+    double spawn_us = spawn_latency_us(SpawnBackend::PosixSpawn, path, iterations);
+    std::printf("%-14s fork+execv %9.1f us   posix_spawn %9.1f us   speedup %5.2fx\n", label, fork_us, spawn_us,
+                fork_us / spawn_us);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 500;
+    size_t bloat_mb = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1024;
+
+    std::string path = find_executable("true");
+    if (path.empty()) {
+        std::fprintf(stderr, "true: command not found\n");
+        return 1;
+    }
+
+    report("small shell", path, iterations);
+
+    // Touch every page so fork() has to duplicate a large resident address space
+    std::vector<char> heap(bloat_mb << 20);
+    std::memset(heap.data(), 1, heap.size());
+    for (int i = 0; i < 100000; ++i) {
+        alias_manager.set_alias("alias" + std::to_string(i), "echo bloated shell " + std::to_string(i));
+    }
+
+    std::string label = "+" + std::to_string(bloat_mb) + " MiB";
+    report(label.c_str(), path, iterations);
+    return 0;
+}
@@ -0,0 +1,38 @@
+// Cost of a TraceSpan with tracing disabled (the default) and enabled,
+// against the same loop with no span at all.
+//
+// Usage: trace_bench [iterations]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "trace.h"
+
+static volatile unsigned sink;
+
+template <typename Body>
+static double ns_per_iteration(long iterations, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) body(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    auto bare = [](long i) { sink = sink + static_cast<unsigned>(i); };
+    auto traced = [](long i) {
+        TraceSpan span("bench", "detail");
+        sink = sink + static_cast<unsigned>(i);
+    };
+
+    double none = ns_per_iteration(iterations, bare);
+    double disabled = ns_per_iteration(iterations, traced);
+    tracer.enable();
+    double enabled = ns_per_iteration(iterations, traced);
+    tracer.disable();
+
+    std::printf("no span        %8.2f ns/iteration\n", none);
+    std::printf("span, disabled %8.2f ns/iteration  (+%.2f ns)\n", disabled, disabled - none);
+    std::printf("span, enabled  %8.2f ns/iteration  (+%.2f ns)\n", enabled, enabled - none);
+    return 0;
+}
@@ -0,0 +1,52 @@
+// Variable lookups through the shell's hash table versus getenv(), which
+// scans environ, and the cost of handing a child its environment when envp
+// is cached versus rebuilt for every spawn.
+//
+// Usage: variable_bench [environment_size] [iterations]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "variable_store.h"
+
+extern char** environ;
+
+static volatile size_t sink;
+
+template <typename Body>
+static double ns_per_iteration(int iterations, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) body();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    int environment_size = argc > 1 ? std::atoi(argv[1]) : 100;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 1000000;
+
+    for (int i = 0; i < environment_size; ++i) {
+        setenv(("BENCH_VAR_" + std::to_string(i)).c_str(), "some value that is typical", 1);
+    }
+    VariableStore store; // Imports the environment built above
+    std::string name = "BENCH_VAR_" + std::to_string(environment_size - 1);
+    const char* last = name.c_str();
+
+    double getenv_ns = ns_per_iteration(iterations, [&] { sink = sink + std::strlen(std::getenv(last)); });
+    double store_ns = ns_per_iteration(iterations, [&] { sink = sink + store.get(name)->size(); });
+    std::printf("lookup (%d vars)   getenv %8.1f ns   variable store %8.1f ns\n", environment_size, getenv_ns, store_ns);
+
+    int spawns = iterations / 100;
+    double rebuild_ns = ns_per_iteration(spawns, [&] {
+        std::vector<std::string> copy;
+        for (char** entry = environ; *entry; ++entry) copy.emplace_back(*entry);
+        std::vector<char*> pointers;
+        for (std::string& entry : copy) pointers.push_back(entry.data());
+        pointers.push_back(nullptr);
+        sink = sink + pointers.size();
+    });
+    double cached_ns = ns_per_iteration(spawns, [&] { sink = sink + (store.envp()[0] != nullptr); });
+    std::printf("envp per spawn     rebuilt %7.0f ns   cached %13.1f ns\n", rebuild_ns, cached_ns);
+    return 0;
+}
@@ -1,94 +1,168 @@
 #include "alias_manager.h"
+#include <iterator>
+#include <optional>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
 #include <stdexcept>
 #include "shell_utils.h"
+#include "state_snapshot.h"
+#include "trace.h"
 
 // Global alias manager instance
 AliasManager alias_manager;
 
+void AliasManager::store(const std::string& name, const std::string& value) const {
+    aliases[name] = value;
+    // Expansions and process substitutions must not run before the alias does
+    bool dynamic = value.find('$') != std::string::npos || value.find("<(") != std::string::npos ||
+                   value.find(">(") != std::string::npos;
+    bodies[name] = {dynamic ? std::vector<std::string>() : tokenize_input(value), dynamic};
+}
+
+const AliasManager::Body* AliasManager::find_body(std::string_view name) const {
+    auto it = bodies.find(name);
+    if (it != bodies.end()) return &it->second;
+    if (!snapshot || hidden.find(name) != hidden.end()) return nullptr;
+
+    std::optional<StateSnapshot::Entry> entry = snapshot->find(StateSnapshot::Section::Aliases, name);
+    if (!entry) return nullptr;
+    std::string key(name);
+    store(key, std::string(entry->value));
+    return &bodies.find(key)->second;
+}
+
+void AliasManager::materialize_all() const {
+    if (fully_materialized) return;
+    for (size_t i = 0; i < snapshot->size(StateSnapshot::Section::Aliases); ++i) {
+        StateSnapshot::Entry entry = snapshot->at(StateSnapshot::Section::Aliases, i);
+        if (aliases.find(entry.key) == aliases.end() && hidden.find(entry.key) == hidden.end()) {
+            store(std::string(entry.key), std::string(entry.value));
+        }
+    }
+    fully_materialized = true;
+}
+
 void AliasManager::set_alias(const std::string& name, const std::string& value) {
+    std::lock_guard lock(mutex);
     // Don't allow empty alias names
     if (name.empty()) {
         return;
     }
     
-    // Store the alias
-    aliases[name] = value;
+    // Store the alias, split into words once
+    store(name, value);
+    hidden.erase(name);
+    expansions.clear();
 }
 
 bool AliasManager::remove_alias(const std::string& name) {
-    auto it = aliases.find(name);
-    if (it != aliases.end()) {
-        aliases.erase(it);
-        return true;
+    std::lock_guard lock(mutex);
+    if (!find_body(name)) {
+        return false;
     }
-    return false;
+    aliases.erase(name);
+    bodies.erase(name);
+    if (snapshot) hidden[name] = true;
+    expansions.clear();
+    return true;
 }
 
 std::string AliasManager::get_alias(const std::string& name) const {
-    auto it = aliases.find(name);
-    return (it != aliases.end()) ? it->second : "";
+    std::lock_guard lock(mutex);
+    if (!find_body(name)) return "";
+    return aliases.find(name)->second;
 }
 
 bool AliasManager::has_alias(const std::string& name) const {
-    return aliases.find(name) != aliases.end();
+    std::lock_guard lock(mutex);
+    return find_body(name) != nullptr;
 }
 
-const std::unordered_map<std::string, std::string>& AliasManager::get_all_aliases() const {
+StringMap<std::string> AliasManager::get_all_aliases() const {
+    std::lock_guard lock(mutex);
+    materialize_all();
     return aliases;
 }
 
+void AliasManager::attach_snapshot(std::shared_ptr<const StateSnapshot> new_snapshot) {
+    std::lock_guard lock(mutex);
+    snapshot = std::move(new_snapshot);
+    hidden.clear();
+    expansions.clear();
+    fully_materialized = snapshot == nullptr;
+}
+
 std::vector<std::string> AliasManager::expand_aliases(const std::vector<std::string>& tokens) const {
-    std::set<std::string> expanded_aliases;
-    return expand_aliases_with_recursion_check(tokens, expanded_aliases);
+    std::vector<std::string> expanded;
+    if (!expand_aliases(tokens, expanded)) return tokens;
+    return expanded;
 }
 
-std::vector<std::string> AliasManager::expand_aliases_with_recursion_check(const std::vector<std::string>& tokens, std::set<std::string>& expanded_aliases) const {
-    if (tokens.empty()) {
-        return tokens;
-    }
-    
-    // Check if the first token is an alias
-    const std::string& first_token = tokens[0];
-    if (!has_alias(first_token)) {
-        return tokens;
-    }
-    
-    // Check for recursion
-    if (expanded_aliases.find(first_token) != expanded_aliases.end()) {
-        // Recursion detected - throw error with format consistent with other shell errors
-        throw std::runtime_error(first_token + ": alias loop detected");
-    }
-    
-    // Add this alias to the expansion set
-    expanded_aliases.insert(first_token);
-    
-    // Get the alias value
-    std::string alias_value = get_alias(first_token);
-    
-    // Tokenize the alias value
-    std::vector<std::string> alias_tokens = tokenize_input(alias_value);
-    
-    // Recursively expand the first token of the alias if it's also an alias
-    if (!alias_tokens.empty()) {
-        alias_tokens = expand_aliases_with_recursion_check(alias_tokens, expanded_aliases);
+bool AliasManager::expand_aliases(const std::vector<std::string>& tokens, std::vector<std::string>& expanded,
+                                  std::vector<ProcessSubstitution>* substitutions) const {
+    if (tokens.empty()) return false;
+    std::unique_lock lock(mutex);
+    // The common case: one probe (two with a snapshot), nothing allocated
+    if (!find_body(tokens[0])) return false;
+
+    TraceSpan span("expand_aliases", tokens[0]);
+    auto cached = expansions.find(tokens[0]);
+    if (cached != expansions.end()) {
+        expanded = cached->second;
+    } else {
+        bool cacheable = true;
+        expanded = expand_chain(tokens[0], lock, cacheable, substitutions);
+        if (cacheable) expansions.emplace(tokens[0], expanded);
     }
-    
-    // Create the expanded command: alias tokens + remaining original tokens (skipping first)
-    std::vector<std::string> expanded_tokens = alias_tokens;
-    
-    // Add the remaining original tokens (excluding the alias name)
-    for (size_t i = 1; i < tokens.size(); ++i) {
-        expanded_tokens.push_back(tokens[i]);
+    // Remaining original tokens follow the expansion
+    expanded.insert(expanded.end(), tokens.begin() + 1, tokens.end());
+    return true;
+}
+
+// Follows aliases of aliases one body at a time. A dynamic body is copied
+// out and tokenized with the lock released: its $(...) may run aliases
+// again or fork, and a forked child must not inherit a held lock.
+std::vector<std::string> AliasManager::expand_chain(const std::string& name, std::unique_lock<std::mutex>& lock,
+                                                    bool& cacheable,
+                                                    std::vector<ProcessSubstitution>* substitutions) const {
+    std::vector<std::string> seen;
+    std::vector<std::string> tail; // Words of outer bodies that follow the current one
+    std::string current = name;
+    while (true) {
+        if (std::find(seen.begin(), seen.end(), current) != seen.end()) {
+            throw std::runtime_error(current + ": alias loop detected");
+        }
+        seen.push_back(current);
+
+        // The body may be gone if the alias was removed while unlocked
+        const Body* body = find_body(current);
+        std::vector<std::string> words;
+        if (body && body->dynamic) {
+            cacheable = false;
+            std::string text = aliases.find(current)->second;
+            lock.unlock();
+            words = tokenize_input(text, substitutions);
+            lock.lock();
+        } else if (body) {
+            words = body->tokens;
+        } else {
+            words = {current};
+        }
+
+        words.insert(words.end(), std::make_move_iterator(tail.begin()), std::make_move_iterator(tail.end()));
+        // Expand the first word of the body too if it is also an alias
+        if (words.empty() || !find_body(words[0])) return words;
+        auto cached = cacheable ? expansions.find(words[0]) : expansions.end();
+        if (cached != expansions.end()) {
+            std::vector<std::string> result = cached->second;
+            result.insert(result.end(), std::make_move_iterator(words.begin() + 1), std::make_move_iterator(words.end()));
+            return result;
+        }
+        current = words[0];
+        tail.assign(std::make_move_iterator(words.begin() + 1), std::make_move_iterator(words.end()));
     }
-    
-    // Remove this alias from the expansion set (backtrack)
-    expanded_aliases.erase(first_token);
-    
-    return expanded_tokens;
 }
 
 bool AliasManager::load_aliases_from_file(const std::string& filename) {
@@ -135,7 +209,7 @@ bool AliasManager::save_aliases_to_file(const std::string& filename) const {
     
     file << "# Shell aliases - auto-generated file\n\n";
     
-    for (const auto& pair : aliases) {
+    for (const auto& pair : get_all_aliases()) {
         // Quote the value to handle spaces and special characters
         file << pair.first << "='" << pair.second << "'\n";
     }
@@ -1,12 +1,67 @@
 #pragma once
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
-#include <set>
+#include "process_substitution.h"
 
+class StateSnapshot;
+
+// Hash for maps keyed by std::string that can be probed with a string_view
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+template <typename Value>
+using StringMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
+
+/**
+ * Alias table. Bodies are tokenized once, when the alias is set, and the
+ * fully expanded token prefix of each alias (following aliases of aliases)
+ * is memoized until the next set_alias or remove_alias. Bodies containing
+ * '$', <(...) or >(...) are tokenized again on every use, so variables and
+ * $(...) see the state at expansion time, as they do in other shells, and
+ * process substitutions start only when the alias runs.
+ *
+ * With a StateSnapshot attached, its aliases are visible too and are copied
+ * into the table one at a time, the first time each is looked up.
+ *
+ * Lookups may come from several threads (the `alias` builtin can run as a
+ * pipeline stage on a worker thread). The lock is never held while a
+ * dynamic body is tokenized, since its $(...) can expand aliases again or
+ * fork a subshell.
+ */
 class AliasManager {
 private:
-    std::unordered_map<std::string, std::string> aliases;
+    mutable std::mutex mutex;
+    // An alias body split into words
+    struct Body {
+        std::vector<std::string> tokens;
+        bool dynamic; // Contains '$', <( or >(: re-tokenized on each use
+    };
+
+    // Materialized lazily from the snapshot, hence mutable
+    mutable StringMap<std::string> aliases;
+    mutable StringMap<Body> bodies;
+    mutable StringMap<std::vector<std::string>> expansions; // Memoized chains of static bodies
+    std::shared_ptr<const StateSnapshot> snapshot;
+    StringMap<bool> hidden; // Snapshot aliases removed with unalias
+    mutable bool fully_materialized = true;
+
+    // Body of an alias, copying it in from the snapshot if needed; nullptr if none
+    const Body* find_body(std::string_view name) const;
+    void store(const std::string& name, const std::string& value) const;
+    void materialize_all() const;
+
+    // Expanded token prefix for an alias; throws on an alias loop. Sets
+    // cacheable to false if a dynamic body was involved. Unlocks lock while
+    // tokenizing dynamic bodies.
+    std::vector<std::string> expand_chain(const std::string& name, std::unique_lock<std::mutex>& lock,
+                                          bool& cacheable, std::vector<ProcessSubstitution>* substitutions) const;
 
 public:
     // Add or update an alias
@@ -21,13 +76,22 @@ public:
     // Check if an alias exists
     bool has_alias(const std::string& name) const;
     
-    // Get all aliases
-    const std::unordered_map<std::string, std::string>& get_all_aliases() const;
+    // Get a copy of all aliases, taken under the lock
+    StringMap<std::string> get_all_aliases() const;
     
     // Expand aliases in a command token list
     std::vector<std::string> expand_aliases(const std::vector<std::string>& tokens) const;
-    std::vector<std::string> expand_aliases_with_recursion_check(const std::vector<std::string>& tokens, std::set<std::string>& expanded_aliases) const;
+
+    // Expand aliases into expanded. Returns false without touching expanded
+    // (or allocating) when the first token is not an alias. Throws
+    // std::runtime_error on an alias loop. Process substitutions in dynamic
+    // bodies are moved to substitutions if given (see tokenize_input).
+    bool expand_aliases(const std::vector<std::string>& tokens, std::vector<std::string>& expanded,
+                        std::vector<ProcessSubstitution>* substitutions = nullptr) const;
     
+    // Make the aliases in a snapshot visible (those set here take precedence)
+    void attach_snapshot(std::shared_ptr<const StateSnapshot> snapshot);
+
     // Load aliases from config file
     bool load_aliases_from_file(const std::string& filename);
     
@@ -0,0 +1,261 @@
+#include "brace_expansion.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+namespace {
+    // Braces nested deeper than this are left as literal text, which bounds
+    // the parser's recursion on hostile input
+    constexpr unsigned max_depth = 64;
+
+    bool has_top_level_comma(std::string_view body) {
+        unsigned depth = 0;
+        for (char c : body) {
+            if (c == '{') {
+                ++depth;
+            } else if (c == '}') {
+                if (depth > 0) --depth;
+            } else if (c == ',' && depth == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parse_integer(std::string_view text, int64_t& value) {
+        if (text.empty()) return false;
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc() && end == text.data() + text.size();
+    }
+
+    // 0-padded endpoints such as 01 or -007 fix the width of every number
+    bool is_padded(std::string_view text) {
+        if (text.starts_with('-')) text.remove_prefix(1);
+        return text.size() > 1 && text[0] == '0';
+    }
+
+    uint64_t saturating_add(uint64_t a, uint64_t b) {
+        return a > std::numeric_limits<uint64_t>::max() - b ? std::numeric_limits<uint64_t>::max() : a + b;
+    }
+
+    uint64_t saturating_multiply(uint64_t a, uint64_t b) {
+        if (a != 0 && b > std::numeric_limits<uint64_t>::max() / a) return std::numeric_limits<uint64_t>::max();
+        return a * b;
+    }
+} // namespace
+
+BraceExpansion::BraceExpansion(std::string_view word) : word_(word), closes_(word.size(), std::string_view::npos) {
+    // Match every brace up front so the parser never rescans the word
+    std::vector<size_t> open;
+    for (size_t i = 0; i < word_.size(); ++i) {
+        if (word_[i] == '{') {
+            open.push_back(i);
+        } else if (word_[i] == '}' && !open.empty()) {
+            closes_[open.back()] = i;
+            open.pop_back();
+        }
+    }
+    size_t pos = 0;
+    root_ = parse_sequence(word_, false, pos);
+    size_ = count(root_);
+}
+
+uint32_t BraceExpansion::add_node(Node node) {
+    nodes_.push_back(node);
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+uint32_t BraceExpansion::add_parent(Node::Kind kind, const std::vector<uint32_t>& children) {
+    Node node{.kind = kind};
+    node.first_child = static_cast<uint32_t>(children_.size());
+    node.child_count = static_cast<uint32_t>(children.size());
+    children_.insert(children_.end(), children.begin(), children.end());
+    return add_node(node);
+}
+
+// Literal text and braces up to the end of text, or in an alternation up to
+// the next top-level comma. text is always a prefix of word_, so positions
+// in it are positions in word_.
+uint32_t BraceExpansion::parse_sequence(std::string_view text, bool in_alternation, size_t& pos) {
+    std::vector<uint32_t> items;
+    size_t literal_start = pos;
+    auto flush_literal = [&] {
+        if (pos > literal_start) {
+            items.push_back(add_node({.kind = Node::Kind::Literal, .text = text.substr(literal_start, pos - literal_start)}));
+        }
+    };
+
+    while (pos < text.size()) {
+        char c = text[pos];
+        if (in_alternation && c == ',') break;
+        size_t close = c == '{' ? closes_[pos] : std::string_view::npos;
+        if (close == std::string_view::npos) {
+            ++pos;
+            continue;
+        }
+        flush_literal();
+        parse_brace(text, pos, close, items);
+        pos = close + 1;
+        literal_start = pos;
+    }
+    flush_literal();
+    return add_parent(Node::Kind::Sequence, items);
+}
+
+// The brace text[open..close] as an alternation, a range, or literal braces
+// around text that may hold further braces
+void BraceExpansion::parse_brace(std::string_view text, size_t open, size_t close, std::vector<uint32_t>& items) {
+    std::string_view body = text.substr(open + 1, close - open - 1);
+    std::string_view inner = text.substr(0, close);
+    if (depth_ >= max_depth) {
+        items.push_back(add_node({.kind = Node::Kind::Literal, .text = text.substr(open, close - open + 1)}));
+        return;
+    }
+    ++depth_;
+
+    if (has_top_level_comma(body)) {
+        std::vector<uint32_t> alternatives;
+        size_t pos = open + 1;
+        while (true) {
+            alternatives.push_back(parse_sequence(inner, true, pos));
+            if (pos >= close) break;
+            ++pos; // The comma
+        }
+        items.push_back(add_parent(Node::Kind::Alternation, alternatives));
+        has_braces_ = true;
+    } else if (parse_range(body, items)) {
+        has_braces_ = true;
+    } else {
+        size_t pos = open + 1;
+        items.push_back(add_node({.kind = Node::Kind::Literal, .text = text.substr(open, 1)}));
+        items.push_back(parse_sequence(inner, false, pos));
+        items.push_back(add_node({.kind = Node::Kind::Literal, .text = text.substr(close, 1)}));
+    }
+    --depth_;
+}
+
+// x..y or x..y..step, where x and y are both integers or both single letters
+bool BraceExpansion::parse_range(std::string_view body, std::vector<uint32_t>& items) {
+    size_t dots = body.find("..");
+    if (dots == std::string_view::npos) return false;
+    std::string_view first = body.substr(0, dots);
+    std::string_view last = body.substr(dots + 2);
+    int64_t step = 1;
+    if (size_t step_dots = last.find(".."); step_dots != std::string_view::npos) {
+        if (!parse_integer(last.substr(step_dots + 2), step) || step == std::numeric_limits<int64_t>::min()) {
+            return false;
+        }
+        last = last.substr(0, step_dots);
+    }
+
+    Node node{.kind = Node::Kind::Range};
+    int64_t end = 0;
+    if (parse_integer(first, node.start) && parse_integer(last, end)) {
+        if (is_padded(first) || is_padded(last)) node.width = static_cast<unsigned>(std::max(first.size(), last.size()));
+    } else if (first.size() == 1 && last.size() == 1 && std::isalpha(static_cast<unsigned char>(first[0])) &&
+               std::isalpha(static_cast<unsigned char>(last[0]))) {
+        node.start = first[0];
+        end = last[0];
+        node.letters = true;
+    } else {
+        return false;
+    }
+
+    // The sign of the step is ignored; values run from x towards y
+    uint64_t magnitude = step == 0 ? 1 : static_cast<uint64_t>(step < 0 ? -step : step);
+    uint64_t distance = end >= node.start ? static_cast<uint64_t>(end) - static_cast<uint64_t>(node.start)
+                                          : static_cast<uint64_t>(node.start) - static_cast<uint64_t>(end);
+    node.step = static_cast<int64_t>(end >= node.start ? magnitude : 0 - magnitude);
+    node.count = saturating_add(distance / magnitude, 1);
+    items.push_back(add_node(node));
+    return true;
+}
+
+uint64_t BraceExpansion::count(uint32_t id) const {
+    const Node& node = nodes_[id];
+    switch (node.kind) {
+    case Node::Kind::Literal:
+        return 1;
+    case Node::Kind::Range:
+        return node.count;
+    case Node::Kind::Sequence: {
+        uint64_t total = 1;
+        for (uint32_t i = 0; i < node.child_count; ++i) total = saturating_multiply(total, count(children_[node.first_child + i]));
+        return total;
+    }
+    case Node::Kind::Alternation: {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < node.child_count; ++i) total = saturating_add(total, count(children_[node.first_child + i]));
+        return total;
+    }
+    }
+    return 1;
+}
+
+void BraceExpansion::emit(uint32_t id, std::string& out) const {
+    const Node& node = nodes_[id];
+    switch (node.kind) {
+    case Node::Kind::Literal:
+        out += node.text;
+        break;
+    case Node::Kind::Sequence:
+        for (uint32_t i = 0; i < node.child_count; ++i) emit(children_[node.first_child + i], out);
+        break;
+    case Node::Kind::Alternation:
+        emit(children_[node.first_child + node.current], out);
+        break;
+    case Node::Kind::Range: {
+        // Unsigned arithmetic, so stepping towards an extreme endpoint cannot overflow
+        int64_t value = static_cast<int64_t>(static_cast<uint64_t>(node.start) +
+                                             node.current * static_cast<uint64_t>(node.step));
+        if (node.letters) {
+            out += static_cast<char>(value);
+            break;
+        }
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        std::string_view number(digits, static_cast<size_t>(end - digits));
+        if (number.starts_with('-')) {
+            out += '-';
+            number.remove_prefix(1);
+        }
+        size_t width = node.width > 0 ? node.width - (value < 0) : 0;
+        if (number.size() < width) out.append(width - number.size(), '0');
+        out += number;
+        break;
+    }
+    }
+}
+
+// Move to the next choice; false when the node wraps back to its first one
+bool BraceExpansion::advance(uint32_t id) {
+    Node& node = nodes_[id];
+    switch (node.kind) {
+    case Node::Kind::Literal:
+        return false;
+    case Node::Kind::Range:
+        if (++node.current < node.count) return true;
+        node.current = 0;
+        return false;
+    case Node::Kind::Sequence:
+        for (uint32_t i = node.child_count; i > 0; --i) {
+            if (advance(children_[node.first_child + i - 1])) return true;
+        }
+        return false;
+    case Node::Kind::Alternation:
+        if (advance(children_[node.first_child + node.current])) return true;
+        if (++node.current < node.child_count) return true;
+        node.current = 0;
+        return false;
+    }
+    return false;
+}
+
+bool BraceExpansion::next(std::string& out) {
+    if (done_) return false;
+    out.clear();
+    emit(root_, out);
+    done_ = !advance(root_);
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Brace expansion of one word, generated lazily. The word is parsed once into
+ * a tree of literals, {a,b,c} alternations (which nest) and {x..y[..step]}
+ * ranges of integers or letters; next() then steps through the results like
+ * an odometer, rightmost brace fastest, writing each into the caller's
+ * string. Only the current choice of every brace is kept, so {1..1000}{a,b}
+ * costs the same memory as {1..2}{a,b}, and nothing is stored between words.
+ *
+ * As in bash, a brace needs a top-level comma or a valid range to expand,
+ * otherwise it is literal text. A range endpoint with a leading zero pads
+ * every number to the width of the longer endpoint ({01..10}).
+ */
+class BraceExpansion {
+public:
+    explicit BraceExpansion(std::string_view word);
+    BraceExpansion(const BraceExpansion&) = delete; // Literals are views into word_
+    BraceExpansion& operator=(const BraceExpansion&) = delete;
+
+    // Whether the word has any brace that expands
+    bool has_braces() const { return has_braces_; }
+
+    // Number of words the expansion produces, saturating at UINT64_MAX
+    uint64_t size() const { return size_; }
+
+    // Write the next word to out; false once every word has been produced
+    bool next(std::string& out);
+
+private:
+    struct Node {
+        enum class Kind { Literal, Sequence, Alternation, Range } kind;
+        std::string_view text{};   // Literal
+        uint32_t first_child = 0;  // Sequence, Alternation: index into children_
+        uint32_t child_count = 0;
+        int64_t start = 0;         // Range: first value, difference between values, number of values
+        int64_t step = 1;
+        uint64_t count = 1;
+        unsigned width = 0;        // Range: zero-padded width, 0 for none
+        bool letters = false;      // Range: values are characters
+        uint64_t current = 0;      // Alternation: chosen alternative; Range: index of the current value
+    };
+
+    uint32_t parse_sequence(std::string_view text, bool in_alternation, size_t& pos);
+    void parse_brace(std::string_view text, size_t open, size_t close, std::vector<uint32_t>& items);
+    bool parse_range(std::string_view body, std::vector<uint32_t>& items);
+    uint32_t add_node(Node node);
+    uint32_t add_parent(Node::Kind kind, const std::vector<uint32_t>& children);
+    uint64_t count(uint32_t id) const;
+    void emit(uint32_t id, std::string& out) const;
+    bool advance(uint32_t id);
+
+    std::string word_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> children_;
+    std::vector<size_t> closes_; // For each '{' in word_, the position of its matching '}' (npos if none)
+    unsigned depth_ = 0;         // Braces being parsed around the current position
+    uint32_t root_ = 0;
+    uint64_t size_ = 1;
+    bool has_braces_ = false;
+    bool done_ = false;
+};
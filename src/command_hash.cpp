@@ -0,0 +1,76 @@
+#include "command_hash.h"
+#include <cstdlib>
+#include <optional>
+#include <unistd.h>
+#include "state_snapshot.h"
+
+// Global command hash instance
+CommandHash command_hash;
+
+void CommandHash::sync_with_path() {
+    const char* path_env = std::getenv("PATH");
+    bool has_path = path_env != nullptr;
+    if (has_path == has_hashed_path && (!has_path || hashed_path == path_env)) {
+        return;
+    }
+
+    // $PATH changed (e.g. `export PATH=...`): every entry may now resolve elsewhere
+    entries.clear();
+    snapshot.reset();
+    has_hashed_path = has_path;
+    hashed_path = has_path ? path_env : "";
+}
+
+std::string CommandHash::lookup(const std::string& name, bool count_hit) {
+    std::lock_guard lock(mutex);
+    sync_with_path();
+
+    auto it = entries.find(name);
+    if (it == entries.end()) {
+        std::optional<StateSnapshot::Entry> saved =
+            snapshot ? snapshot->find(StateSnapshot::Section::Commands, name) : std::nullopt;
+        if (!saved) return "";
+        it = entries.emplace(name, HashedCommand{std::string(saved->value), saved->number}).first;
+    }
+
+    // One access() instead of a full $PATH walk; forget binaries that were removed
+    if (access(it->second.path.c_str(), X_OK) != 0) {
+        entries.erase(it);
+        return "";
+    }
+
+    if (count_hit) ++it->second.hits;
+    return it->second.path;
+}
+
+void CommandHash::remember(const std::string& name, const std::string& path, unsigned long hits) {
+    std::lock_guard lock(mutex);
+    sync_with_path();
+    entries[name] = HashedCommand{path, hits};
+}
+
+void CommandHash::clear() {
+    std::lock_guard lock(mutex);
+    entries.clear();
+    snapshot.reset();
+}
+
+std::unordered_map<std::string, HashedCommand> CommandHash::get_all_entries() const {
+    std::lock_guard lock(mutex);
+    if (snapshot) {
+        for (size_t i = 0; i < snapshot->size(StateSnapshot::Section::Commands); ++i) {
+            StateSnapshot::Entry saved = snapshot->at(StateSnapshot::Section::Commands, i);
+            entries.try_emplace(std::string(saved.key), HashedCommand{std::string(saved.value), saved.number});
+        }
+        snapshot.reset();
+    }
+    return entries;
+}
+
+void CommandHash::attach_snapshot(std::shared_ptr<const StateSnapshot> new_snapshot) {
+    std::lock_guard lock(mutex);
+    sync_with_path();
+    const char* path_env = std::getenv("PATH");
+    if (new_snapshot && new_snapshot->hashed_path() != (path_env ? path_env : "")) return;
+    snapshot = std::move(new_snapshot);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class StateSnapshot;
+
+// A remembered command location, as reported by the `hash` builtin.
+struct HashedCommand {
+    std::string path;
+    unsigned long hits = 0;
+};
+
+// Cache of command name -> resolved executable path, so repeated commands
+// skip the $PATH walk. Entries are dropped when $PATH changes or when a
+// cached path stops being executable. Entries from an attached snapshot are
+// used while $PATH matches the one it was written with, and copied in on
+// first use. Safe to use from several threads: builtin pipeline stages
+// resolve commands on worker threads.
+class CommandHash {
+private:
+    mutable std::mutex mutex;
+    mutable std::unordered_map<std::string, HashedCommand> entries; // Materialized lazily from the snapshot
+    mutable std::shared_ptr<const StateSnapshot> snapshot; // Dropped once fully copied in
+    std::string hashed_path; // Value of $PATH the entries were resolved against
+    bool has_hashed_path = false;
+
+    // Clear the table if $PATH differs from the one the entries came from
+    void sync_with_path();
+
+public:
+    // Return the cached path for a command, or "" if the command is not
+    // cached (or its cached path is no longer executable). A hit is counted
+    // unless the caller only asks where the command is (type, which, hash).
+    std::string lookup(const std::string& name, bool count_hit = true);
+
+    // Add or replace the location of a command
+    void remember(const std::string& name, const std::string& path, unsigned long hits = 0);
+
+    // Remove all remembered locations
+    void clear();
+
+    // Get a copy of all remembered locations, taken under the lock
+    std::unordered_map<std::string, HashedCommand> get_all_entries() const;
+
+    // Use the command locations in a snapshot, if it was taken with the current $PATH
+    void attach_snapshot(std::shared_ptr<const StateSnapshot> snapshot);
+};
+
+// Global command hash instance
+extern CommandHash command_hash;
@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
+#include "process_substitution.h"
 
 enum class RedirectType {
   None,
@@ -10,13 +11,32 @@ enum class RedirectType {
   StdoutAppend,
   StderrAppend,
   Stdin,
-  BothAppend
+  BothAppend,
+  StderrToStdout, // 2>&1
+  StdoutToStderr, // >&2
+  HereDocument    // <<, <<- and <<<: the target is the text itself, fed to stdin
+};
+
+// One redirection of a command's standard streams
+struct Redirection {
+    RedirectType type;
+    std::string target; // File name (here-document text); empty for descriptor duplication
+};
+
+// Arguments of a command from the first one glob or brace expansion produced
+// to the last, [begin, end) in its argv; empty when nothing expanded
+struct ExpandedRange {
+    size_t begin = 0;
+    size_t end = 0;
 };
 
 struct ParsedCommand {
     std::vector<std::vector<std::string>> pipeline; // Each command in the pipeline
-    std::string redirect_file;
+    std::vector<std::vector<Redirection>> redirections; // Per command, applied in order (may be shorter than pipeline)
+    std::string redirect_file; // Redirection of the last command, applied after its own
     RedirectType redirect_type = RedirectType::None;
+    std::vector<ProcessSubstitution> substitutions; // Already running; waited for with the stages
+    std::vector<ExpandedRange> expanded; // Per command (may be shorter than pipeline)
 };
 
 ParsedCommand parse_redirection(std::vector<std::string> tokens);
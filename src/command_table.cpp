@@ -1,4 +1,8 @@
 #include "command_table.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <readline/history.h>
 #include <readline/readline.h>
@@ -6,11 +10,44 @@
 #include <algorithm>
 #include "shell_utils.h"
 #include "alias_manager.h"
+#include "command_hash.h"
+#include "dir_cache.h"
+#include "fd_copy.h"
+#include "job_table.h"
+#include "history_store.h"
+#include "shell_options.h"
+#include "state_snapshot.h"
+#include "variable_store.h"
+
+// Most matches `history -s` prints
+static constexpr size_t history_search_limit = 200;
+
+// cat and tee only build in their plain forms; other options run the real program
+static bool has_other_options(const std::vector<std::string>& args, const std::vector<std::string>& known) {
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i].size() > 1 && args[i][0] == '-' && std::find(known.begin(), known.end(), args[i]) == known.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+thread_local BuiltinStreams builtin_streams;
 
 // Built-in commands
 std::unordered_map<std::string, CommandHandler> command_table = {
     {
-        "exit", [](const std::vector<std::string> &/*args*/) {
+        "exit", [](const std::vector<std::string> &args) {
+            // exit [N]: without N the shell exits with the last command's status
+            if (args.size() > 1) {
+                long long status = 0;
+                auto [end, ec] = std::from_chars(args[1].data(), args[1].data() + args[1].size(), status);
+                if (ec != std::errc() || end != args[1].data() + args[1].size()) {
+                    builtin_errors() << "exit: " << args[1] << ": numeric argument required" << std::endl;
+                    status = 2;
+                }
+                last_exit_status = static_cast<int>(status & 0xff);
+            }
             return true;
         }
     },
@@ -53,26 +90,26 @@ std::unordered_map<std::string, CommandHandler> command_table = {
                     output = processed;
                 }
                 
-                std::cout << output << (i == args.size() - 1 ? "" : " ");
+                builtin_output() << output << (i == args.size() - 1 ? "" : " ");
             }
-            std::cout << std::endl;
+            builtin_output() << '\n';
             return false;
         }
     },
     {
         "type", [](const std::vector<std::string> &args) {
        if (args.size() < 2) {
-         std::cerr << "type: missing argument" << std::endl;
+         builtin_errors() << "type: missing argument" << std::endl;
        } else {
          const std::string &cmd_to_check = args[1];
          if (command_table.count(cmd_to_check)) {
-           std::cout << cmd_to_check << " is a shell builtin" << std::endl;
+           builtin_output() << cmd_to_check << " is a shell builtin" << '\n';
          } else {
-           const std::string cmd_path_str = find_executable(cmd_to_check);
+           const std::string cmd_path_str = find_executable(cmd_to_check, false);
            if (!cmd_path_str.empty()) {
-             std::cout << cmd_to_check << " is " << cmd_path_str << std::endl;
+             builtin_output() << cmd_to_check << " is " << cmd_path_str << '\n';
            } else {
-             std::cout << cmd_to_check << ": not found" << std::endl;
+             builtin_output() << cmd_to_check << ": not found" << '\n';
            }
          }
        }
@@ -81,6 +118,41 @@ std::unordered_map<std::string, CommandHandler> command_table = {
     },
     {
         "history", [](const std::vector<std::string> &args) {
+            // history -s text: distinct commands containing text, newest first
+            if (args.size() >= 2 && args[1] == "-s") {
+                std::string text;
+                for (size_t i = 2; i < args.size(); ++i) {
+                    if (i > 2) text += ' ';
+                    text += args[i];
+                }
+                if (history_store.is_open()) {
+                    for (const HistoryEntry& entry : history_store.search(text, history_search_limit)) {
+                        builtin_output() << entry.number << "  " << entry.line << '\n';
+                    }
+                    return false;
+                }
+                HIST_ENTRY** hist_list = history_list();
+                for (int i = history_length - 1; hist_list && i >= 0; --i) {
+                    if (hist_list[i] && std::string_view(hist_list[i]->line).find(text) != std::string_view::npos)
+                        builtin_output() << i + history_base << "  " << hist_list[i]->line << '\n';
+                }
+                return false;
+            }
+
+            // The persistent history, shared with other shells, when there is one
+            if (history_store.is_open()) {
+                size_t count = history_store.size();
+                if (args.size() == 2) {
+                    try {
+                        count = std::min<size_t>(count, std::stoul(args[1]));
+                    } catch (...) {}
+                }
+                for (const HistoryEntry& entry : history_store.recent(count)) {
+                    builtin_output() << entry.number << "  " << entry.line << '\n';
+                }
+                return false;
+            }
+
             HIST_ENTRY** hist_list = history_list();
        int start = 1;
        int end = history_length;
@@ -93,7 +165,7 @@ std::unordered_map<std::string, CommandHandler> command_table = {
        if (hist_list) {
          for (int i = start - 1; i < end; ++i) {
            if (hist_list[i])
-                        std::cout << i + history_base << "  " << hist_list[i]->line << std::endl;
+                        builtin_output() << i + history_base << "  " << hist_list[i]->line << '\n';
          }
        }
        return false;
@@ -103,7 +175,7 @@ std::unordered_map<std::string, CommandHandler> command_table = {
         "pwd", [](const std::vector<std::string> &args) {
        char cwd[4096];
        if (getcwd(cwd, sizeof(cwd)) != nullptr) {
-         std::cout << cwd << std::endl;
+         builtin_output() << cwd << '\n';
        } else {
          std::perror("pwd");
        }
@@ -129,7 +201,7 @@ std::unordered_map<std::string, CommandHandler> command_table = {
                     return false;
                 }
                 target = prev_dir.c_str();
-                std::cout << target << std::endl;
+                builtin_output() << target << '\n';
             } else {
                 path = args[1];
                 // Expand ~ to HOME
@@ -142,7 +214,7 @@ std::unordered_map<std::string, CommandHandler> command_table = {
                 target = path.c_str();
             }
             if (chdir(target) != 0) {
-                std::cerr << "cd: " << target << ": No such file or directory" << std::endl;
+                builtin_errors() << "cd: " << target << ": No such file or directory" << std::endl;
             } else {
                 prev_dir = cwd;
             }
@@ -152,21 +224,70 @@ std::unordered_map<std::string, CommandHandler> command_table = {
     {
         "which", [](const std::vector<std::string>& args) {
        if (args.size() < 2) {
-         std::cerr << "which: missing operand\n";
+         builtin_errors() << "which: missing operand\n";
          return false;
        }
-       std::string path = find_executable(args[1]);
+       std::string path = find_executable(args[1], false);
        if (!path.empty())
-         std::cout << path << std::endl;
+         builtin_output() << path << '\n';
        else
-         std::cerr << args[1] << ": command not found\n";
+         builtin_errors() << args[1] << ": command not found\n";
        return false;
         }
     },
+    {
+        "hash", [](const std::vector<std::string>& args) {
+            if (args.size() == 1) {
+                // List remembered commands
+                auto all_entries = command_hash.get_all_entries();
+                if (all_entries.empty()) {
+                    builtin_output() << "hash: hash table empty\n";
+                    return false;
+                }
+
+                // Sort by name for consistent output
+                std::vector<std::pair<std::string, HashedCommand>> sorted_entries(all_entries.begin(), all_entries.end());
+                std::sort(sorted_entries.begin(), sorted_entries.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; });
+
+                builtin_output() << "hits\tcommand\n";
+                for (const auto& [name, entry] : sorted_entries) {
+                    std::string hits = std::to_string(entry.hits);
+                    if (hits.size() < 4) hits.insert(0, 4 - hits.size(), ' ');
+                    builtin_output() << hits << '\t' << entry.path << '\n';
+                }
+                return false;
+            }
+
+            if (args[1] == "-r") {
+                command_hash.clear();
+                return false;
+            }
+
+            if (args[1] == "-p") {
+                if (args.size() < 4) {
+                    builtin_errors() << "hash: usage: hash -p path name\n";
+                    return false;
+                }
+                command_hash.remember(args[3], args[2]);
+                return false;
+            }
+
+            // Resolve and remember each named command
+            for (size_t i = 1; i < args.size(); ++i) {
+                const std::string& name = args[i];
+                if (command_table.count(name)) continue;
+                if (find_executable(name, false).empty()) {
+                    builtin_errors() << "hash: " << name << ": not found\n";
+                }
+            }
+            return false;
+        }
+    },
     {
         "export", [](const std::vector<std::string>& args) {
             if (args.size() < 2) {
-                std::cerr << "export: missing argument" << std::endl;
+                builtin_errors() << "export: missing argument" << std::endl;
                 return false;
             }
             
@@ -174,31 +295,30 @@ std::unordered_map<std::string, CommandHandler> command_table = {
                 const std::string& arg = args[i];
                 size_t eq_pos = arg.find('=');
                 
+                std::string name = arg.substr(0, eq_pos);
+                if (!VariableStore::is_valid_name(name)) {
+                    builtin_errors() << "export: `" << arg << "': not a valid identifier\n";
+                    last_exit_status = 1;
+                    continue;
+                }
                 if (eq_pos != std::string::npos) {
-                    std::string name = arg.substr(0, eq_pos);
-                    std::string value = arg.substr(eq_pos + 1);
-                    
-                    if (setenv(name.c_str(), value.c_str(), 1) != 0) {
-                        perror("export");
-                    }
+                    variable_store.set_exported(name, std::string_view(arg).substr(eq_pos + 1));
                 } else {
-                    // Export existing variable (make it available to child processes)
-                    const char* value = std::getenv(arg.c_str());
-                    if (value) {
-                        if (setenv(arg.c_str(), value, 1) != 0) {
-                            perror("export");
-                        }
-                    } else {
-                        // Variable doesn't exist, set it to empty
-                        if (setenv(arg.c_str(), "", 1) != 0) {
-                            perror("export");
-                        }
-                    }
+                    // Export existing variable (an unset one becomes empty)
+                    variable_store.export_variable(name);
                 }
             }
             return false;
         }
     },
+    {
+        "unset", [](const std::vector<std::string>& args) {
+            for (size_t i = 1; i < args.size(); ++i) {
+                variable_store.unset(args[i]);
+            }
+            return false;
+        }
+    },
     {
         "true", [](const std::vector<std::string>& /*args*/) {
             return false; // true command never causes shell exit
@@ -206,6 +326,7 @@ std::unordered_map<std::string, CommandHandler> command_table = {
     },
     {
         "false", [](const std::vector<std::string>& /*args*/) {
+            last_exit_status = 1;
             return false; // false command also never causes shell exit, but indicates failure
         }
     },
@@ -213,7 +334,7 @@ std::unordered_map<std::string, CommandHandler> command_table = {
         "alias", [](const std::vector<std::string>& args) {
             if (args.size() == 1) {
                 // List all aliases
-                const auto& all_aliases = alias_manager.get_all_aliases();
+                auto all_aliases = alias_manager.get_all_aliases();
                 if (all_aliases.empty()) {
                     // No output if no aliases are defined
                     return false;
@@ -224,7 +345,7 @@ std::unordered_map<std::string, CommandHandler> command_table = {
                 std::sort(sorted_aliases.begin(), sorted_aliases.end());
                 
                 for (const auto& pair : sorted_aliases) {
-                    std::cout << pair.first << "='" << pair.second << "'\n";
+                    builtin_output() << pair.first << "='" << pair.second << "'\n";
                 }
                 return false;
             }
@@ -251,9 +372,9 @@ std::unordered_map<std::string, CommandHandler> command_table = {
                 } else {
                     // Show specific alias
                     if (alias_manager.has_alias(arg)) {
-                        std::cout << arg << "='" << alias_manager.get_alias(arg) << "'\n";
+                        builtin_output() << arg << "='" << alias_manager.get_alias(arg) << "'\n";
                     } else {
-                        std::cerr << arg << ": not found\n";
+                        builtin_errors() << arg << ": not found\n";
                     }
                 }
             }
@@ -264,18 +385,229 @@ std::unordered_map<std::string, CommandHandler> command_table = {
     {
         "unalias", [](const std::vector<std::string>& args) {
             if (args.size() < 2) {
-                std::cerr << "unalias: usage: unalias name [name ...]\n";
+                builtin_errors() << "unalias: usage: unalias name [name ...]\n";
                 return false;
             }
             
             for (size_t i = 1; i < args.size(); ++i) {
                 const std::string& name = args[i];
                 if (!alias_manager.remove_alias(name)) {
-                    std::cerr << "unalias: " << name << ": not found\n";
+                    builtin_errors() << "unalias: " << name << ": not found\n";
                 }
             }
             
+            return false;
+        }
+    },
+    {
+        "jobs", [](const std::vector<std::string>& /*args*/) {
+            job_table.print(builtin_output());
+            return false;
+        }
+    },
+    {
+        "fg", [](const std::vector<std::string>& args) {
+            std::string spec = args.size() > 1 ? args[1] : "";
+            Job* job = job_table.find(spec);
+            if (!job) {
+                builtin_errors() << "fg: " << (spec.empty() ? "current" : spec) << ": no such job\n";
+                last_exit_status = 1;
+                return false;
+            }
+            last_exit_status = job_table.foreground(*job);
+            return false;
+        }
+    },
+    {
+        "bg", [](const std::vector<std::string>& args) {
+            std::string spec = args.size() > 1 ? args[1] : "";
+            Job* job = job_table.find(spec);
+            if (!job) {
+                builtin_errors() << "bg: " << (spec.empty() ? "current" : spec) << ": no such job\n";
+                last_exit_status = 1;
+                return false;
+            }
+            job_table.resume(*job);
+            return false;
+        }
+    },
+    {
+        "wait", [](const std::vector<std::string>& args) {
+            if (args.size() == 1) {
+                // Wait for every running job; stopped jobs stay in the table
+                while (Job* job = job_table.wait_any()) {
+                    job_table.remove(job->id);
+                }
+                return false;
+            }
+
+            if (args[1] == "-n") {
+                // Wait for whichever job finishes next
+                Job* job = job_table.wait_any();
+                if (!job) {
+                    last_exit_status = 127;
+                    return false;
+                }
+                last_exit_status = job->status();
+                job_table.remove(job->id);
+                return false;
+            }
+
+            for (size_t i = 1; i < args.size(); ++i) {
+                const std::string& spec = args[i];
+                Job* job = nullptr;
+                if (spec.starts_with('%')) {
+                    job = job_table.find(spec);
+                } else {
+                    try {
+                        job = job_table.find_pid(std::stoi(spec));
+                    } catch (...) {}
+                }
+                if (!job) {
+                    builtin_errors() << "wait: " << spec << ": no such job\n";
+                    last_exit_status = 127;
+                    continue;
+                }
+                last_exit_status = job_table.wait(*job);
+                job_table.remove(job->id);
+            }
+            return false;
+        }
+    },
+    {
+        "set", [](const std::vector<std::string>& args) {
+            if (args.size() < 2 || args[1] != "-o") {
+                builtin_errors() << "set: usage: set -o [name=value ...]\n";
+                return false;
+            }
+
+            if (args.size() == 2) {
+                print_shell_options(builtin_output());
+                return false;
+            }
+
+            for (size_t i = 2; i < args.size(); ++i) {
+                set_shell_option(args[i]);
+            }
+            return false;
+        }
+    },
+    {
+        "cat", [](const std::vector<std::string>& args) {
+            if (has_other_options(args, {"-u"})) {
+                run_external_command(args);
+                return false;
+            }
+            // Bytes go straight to the descriptor, after anything already buffered
+            builtin_output().flush();
+            std::vector<std::string> files;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] != "-u") files.push_back(args[i]);
+            }
+            if (files.empty()) files.push_back("-");
+
+            for (const std::string& file : files) {
+                bool from_stdin = file == "-";
+                int fd = from_stdin ? builtin_streams.in : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+                bool copied = fd >= 0 && copy_fd(fd, builtin_streams.out);
+                int error = errno;
+                if (!from_stdin && fd >= 0) close(fd);
+                if (!copied) {
+                    last_exit_status = 1;
+                    // The reader went away: stop quietly, like a cat killed by SIGPIPE
+                    if (error == EPIPE) break;
+                    builtin_errors() << "cat: " << file << ": " << std::strerror(error) << '\n';
+                }
+            }
+            return false;
+        }
+    },
+    {
+        "tee", [](const std::vector<std::string>& args) {
+            if (has_other_options(args, {"-a"})) {
+                run_external_command(args);
+                return false;
+            }
+            builtin_output().flush();
+            bool append = std::find(args.begin() + 1, args.end(), "-a") != args.end();
+            int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+            std::vector<int> outputs;
+            for (size_t i = 1; i < args.size(); ++i) {
+                if (args[i] == "-a") continue;
+                int fd = open(args[i].c_str(), flags, 0666);
+                if (fd < 0) {
+                    builtin_errors() << "tee: " << args[i] << ": " << std::strerror(errno) << '\n';
+                    last_exit_status = 1;
+                    continue;
+                }
+                outputs.push_back(fd);
+            }
+            // stdout last: it takes the data off stdin once the files have their copies
+            outputs.push_back(builtin_streams.out);
+            if (!tee_fd(builtin_streams.in, outputs)) {
+                if (errno != EPIPE) builtin_errors() << "tee: " << std::strerror(errno) << '\n';
+                last_exit_status = 1;
+            }
+            for (size_t i = 0; i + 1 < outputs.size(); ++i) close(outputs[i]);
+            return false;
+        }
+    },
+    {
+        "dircache", [](const std::vector<std::string>& args) {
+            // dircache -r forgets every listing; the counters keep running
+            if (args.size() > 1) {
+                if (args[1] != "-r") {
+                    builtin_errors() << "dircache: usage: dircache [-r]\n";
+                    last_exit_status = 2;
+                    return false;
+                }
+                dir_cache.clear();
+                return false;
+            }
+            size_t hits = dir_cache.hits();
+            size_t lookups = hits + dir_cache.misses();
+            std::ostream& out = builtin_output();
+            out << "hits      " << hits << '\n';
+            out << "misses    " << dir_cache.misses() << '\n';
+            out << "hit rate  " << (lookups ? hits * 100 / lookups : 0) << "%\n";
+            out << "listings  " << dir_cache.size() << '\n';
+            out << "bytes     " << dir_cache.bytes() << " of " << dir_cache.capacity() << '\n';
+            return false;
+        }
+    },
+    {
+        "snapshot", [](const std::vector<std::string>& args) {
+            // Save aliases, command locations and history for fast startup
+            std::string path = args.size() > 1 ? args[1] : state_snapshot_path();
+            if (path.empty()) {
+                builtin_errors() << "snapshot: usage: snapshot file (or set SHELL_SNAPSHOT)\n";
+                last_exit_status = 2;
+                return false;
+            }
+            if (!save_state_snapshot(path)) {
+                builtin_errors() << "snapshot: " << path << ": cannot write snapshot\n";
+                last_exit_status = 1;
+            }
             return false;
         }
     }
 };
+
+bool builtin_runs_on_thread(const std::vector<std::string>& args) {
+    if (args.empty()) return false;
+    const std::string& name = args[0];
+    if (name == "echo" || name == "pwd" || name == "true" || name == "false" || name == "type" || name == "which" ||
+        name == "history" || (name == "dircache" && args.size() == 1)) {
+        return true;
+    }
+    // Listing aliases, not defining them
+    if (name == "alias") {
+        return std::none_of(args.begin() + 1, args.end(),
+                            [](const std::string& arg) { return arg.find('=') != std::string::npos; });
+    }
+    if (name == "set") return args.size() == 2 && args[1] == "-o";
+    // The external fallbacks spawn onto the shell's own descriptors
+    if (name == "cat") return !has_other_options(args, {"-u"});
+    if (name == "tee") return !has_other_options(args, {"-a"});
+    return false;
+}
@@ -1,8 +1,36 @@
 #pragma once
 #include <functional>
+#include <iostream>
 #include <string>
+#include <unistd.h>
 #include <unordered_map>
 #include <vector>
 
 using CommandHandler = std::function<bool(const std::vector<std::string>&)>;
 extern std::unordered_map<std::string, CommandHandler> command_table;
+
+// Standard input and output of the builtins running on this thread. A
+// pipeline stage on a worker thread gets its pipe ends here; otherwise they
+// are the shell's own descriptors and std::cout.
+struct BuiltinStreams {
+    int in = STDIN_FILENO;
+    int out = STDOUT_FILENO;
+    std::ostream* stream = nullptr; // Writes to out; nullptr for std::cout
+    std::ostream* errors = nullptr; // Writes to stderr; nullptr for std::cerr
+};
+extern thread_local BuiltinStreams builtin_streams;
+
+// Stream builtins print to
+inline std::ostream& builtin_output() {
+    return builtin_streams.stream ? *builtin_streams.stream : std::cout;
+}
+
+// Stream builtins report errors on. std::cerr is tied to std::cout, so a
+// worker thread writing to it would flush the shell's shared stdout buffer.
+inline std::ostream& builtin_errors() {
+    return builtin_streams.errors ? *builtin_streams.errors : std::cerr;
+}
+
+// Whether a builtin call only reads shell state, so a pipeline can run it
+// on a worker thread instead of in a forked copy of the shell
+bool builtin_runs_on_thread(const std::vector<std::string>& args);
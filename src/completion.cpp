@@ -2,15 +2,17 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <dirent.h>
 #include <filesystem>
 #include <optional>
 #include <readline/readline.h>
 #include <set>
-#include <sstream>
 #include <string>
 #include <unistd.h>
 #include <vector>
 #include "command_table.h"
+#include "dir_cache.h"
+#include "path_index.h"
 
 namespace fs = std::filesystem;
 
@@ -26,27 +28,8 @@ static bool is_first_word() {
 
 // Add all executable files from $PATH that start with the given prefix
 void add_path_executables_matching_prefix(const std::string& prefix, std::set<std::string>& out) {
-    const char* path_env = std::getenv("PATH");
-    if (!path_env) return;
-
-    std::istringstream path_stream(path_env);
-    std::string dir;
-    std::error_code ec;
-
-    while (std::getline(path_stream, dir, ':')) {
-        if (dir.empty()) dir = ".";
-        fs::path dir_path(dir);
-        if (!fs::exists(dir_path, ec) || !fs::is_directory(dir_path, ec)) continue;
-
-        for (const auto& entry : fs::directory_iterator(dir_path, fs::directory_options::skip_permission_denied, ec)) {
-            const auto& path = entry.path();
-            const std::string filename = path.filename().string();
-
-            if (entry.is_regular_file(ec) && filename.starts_with(prefix) && access(path.c_str(), X_OK) == 0) {
-                out.insert(filename);
-            }
-        }
-    }
+    path_command_index.refresh();
+    path_command_index.add_matching(prefix, out);
 }
 
 // Add path/file completions based on prefix (supporting ~ expansion and
@@ -71,21 +54,24 @@ void add_file_completions(const std::string& prefix, std::set<std::string>& out)
         }
     }
 
-    if (!fs::exists(dir, ec) || !fs::is_directory(dir, ec)) return;
-
-    for (const auto& entry : fs::directory_iterator(dir, fs::directory_options::skip_permission_denied, ec)) {
-        std::string filename = entry.path().filename().string();
-        if (!filename.starts_with(base)) continue;
-        if (filename[0] == '.' && (base.empty() || base[0] != '.')) continue;
+    // Filter the directory's cached listing on the raw names; only matching links are stat'ed
+    std::shared_ptr<const DirListing> listing = dir_cache.get(dir.string());
+    for (size_t i = 0; listing && i < listing->size(); ++i) {
+        DirEntry entry = (*listing)[i];
+        if (!entry.name.starts_with(base)) continue;
+        if (entry.name[0] == '.' && (base.empty() || base[0] != '.')) continue;
 
+        fs::path entry_path = dir / entry.name;
         std::string result;
         if (tilde_expanded && home) {
-            result = "~/" + fs::relative(entry.path(), home).string();
+            result = "~/" + fs::relative(entry_path, home, ec).string();
+        } else if (dir == ".") {
+            result = entry.name;
         } else {
-            result = (dir == "." ? filename : (dir / filename).string());
+            result = entry_path.string();
         }
 
-        if (entry.is_directory(ec)) result += "/";
+        if (followed_type(entry, entry_path.string()) == DT_DIR) result += "/";
         out.insert(result);
     }
 }
@@ -0,0 +1,127 @@
+#include "dir_cache.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+// Global directory listing cache instance
+DirCache dir_cache;
+
+void DirListing::add(std::string_view name, unsigned char type) {
+    slots_.push_back({static_cast<uint32_t>(names_.size()), static_cast<uint32_t>(name.size()), type});
+    names_ += name;
+    names_ += '\0';
+}
+
+void DirListing::shrink_to_fit() {
+    names_.shrink_to_fit();
+    slots_.shrink_to_fit();
+}
+
+// Bytes an entry costs beyond its listing
+static size_t entry_overhead(const std::string& path) {
+    return path.capacity() + 64;
+}
+
+std::shared_ptr<const DirListing> DirCache::get(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return nullptr;
+
+    {
+        std::lock_guard lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end()) {
+            Entry& entry = *it->second;
+            if (!entry.racy && entry.device == st.st_dev && entry.inode == st.st_ino &&
+                entry.mtime.tv_sec == st.st_mtim.tv_sec && entry.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                ++hits_;
+                lru_.splice(lru_.begin(), lru_, it->second);
+                return entry.listing;
+            }
+        }
+        ++misses_;
+    }
+
+    // Read outside the lock; types are resolved without following links,
+    // which a rename would show in the directory's mtime
+    TraceSpan span("scan_directory", path);
+    timespec scanned_at;
+    clock_gettime(CLOCK_REALTIME, &scanned_at);
+    DirScanner scanner(path.c_str());
+    if (!scanner.is_open()) return nullptr;
+    auto listing = std::make_shared<DirListing>();
+    DirEntry dir_entry;
+    while (scanner.next(dir_entry)) {
+        listing->add(dir_entry.name, scanner.type_of(dir_entry, false));
+    }
+    listing->shrink_to_fit();
+
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(path);
+    if (it != index_.end()) {
+        auto stale = it->second;
+        bytes_ -= stale->listing->bytes() + entry_overhead(stale->path);
+        index_.erase(it);
+        lru_.erase(stale);
+    }
+    Entry entry{path, st.st_dev, st.st_ino, st.st_mtim, st.st_mtim.tv_sec >= scanned_at.tv_sec - 1, listing};
+    size_t cost = listing->bytes() + entry_overhead(entry.path);
+    if (cost <= capacity_) {
+        evict_to(capacity_ - cost);
+        lru_.push_front(std::move(entry));
+        index_.emplace(lru_.front().path, lru_.begin());
+        bytes_ += cost;
+    }
+    return listing;
+}
+
+void DirCache::evict_to(size_t bytes) {
+    while (bytes_ > bytes && !lru_.empty()) {
+        Entry& oldest = lru_.back();
+        bytes_ -= oldest.listing->bytes() + entry_overhead(oldest.path);
+        index_.erase(oldest.path);
+        lru_.pop_back();
+    }
+}
+
+void DirCache::clear() {
+    std::lock_guard lock(mutex_);
+    evict_to(0);
+}
+
+void DirCache::set_capacity(size_t bytes) {
+    std::lock_guard lock(mutex_);
+    capacity_ = bytes;
+    evict_to(bytes);
+}
+
+size_t DirCache::capacity() const {
+    std::lock_guard lock(mutex_);
+    return capacity_;
+}
+
+size_t DirCache::hits() const {
+    std::lock_guard lock(mutex_);
+    return hits_;
+}
+
+size_t DirCache::misses() const {
+    std::lock_guard lock(mutex_);
+    return misses_;
+}
+
+size_t DirCache::size() const {
+    std::lock_guard lock(mutex_);
+    return lru_.size();
+}
+
+size_t DirCache::bytes() const {
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+unsigned char followed_type(const DirEntry& entry, const std::string& path) {
+    if (entry.type != DT_LNK) return entry.type;
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<unsigned char>(IFTODT(st.st_mode))
+                                        : static_cast<unsigned char>(DT_UNKNOWN);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+#include "dir_scanner.h"
+
+// The entries of one directory, names packed into a single buffer
+class DirListing {
+public:
+    size_t size() const { return slots_.size(); }
+
+    // Entry i. The type is never DT_UNKNOWN unless the entry could not be
+    // stat'ed; a DT_LNK still has to be followed by the caller.
+    DirEntry operator[](size_t i) const {
+        const Slot& slot = slots_[i];
+        return {std::string_view(names_.data() + slot.offset, slot.length), slot.type};
+    }
+
+    // Memory held, as counted against the cache capacity
+    size_t bytes() const { return names_.capacity() + slots_.capacity() * sizeof(Slot) + sizeof(*this); }
+
+    void add(std::string_view name, unsigned char type);
+    void shrink_to_fit();
+
+private:
+    struct Slot {
+        uint32_t offset;
+        uint32_t length;
+        unsigned char type;
+    };
+    std::string names_; // Each name followed by a NUL
+    std::vector<Slot> slots_;
+};
+
+/**
+ * Process-wide LRU cache of directory listings, shared by glob expansion
+ * and file completion so repeated globs and Tab presses in one directory
+ * read it once. A listing is reused while the directory's device, inode and
+ * mtime are those seen when it was read; one modified within a second of
+ * its scan is read again, since a change in the same clock tick would not
+ * move the mtime. The cache is bounded by the bytes its listings hold.
+ */
+class DirCache {
+public:
+    static constexpr size_t default_capacity = 8 << 20;
+
+    explicit DirCache(size_t capacity = default_capacity) : capacity_(capacity) {}
+
+    // Listing of the directory at path, cached or freshly read; nullptr if
+    // it cannot be read. The listing stays valid after it is evicted.
+    std::shared_ptr<const DirListing> get(const std::string& path);
+
+    // Drop every listing; the counters are kept
+    void clear();
+
+    // Bytes the listings may hold in total; 0 turns caching off
+    void set_capacity(size_t bytes);
+    size_t capacity() const;
+
+    size_t hits() const;
+    size_t misses() const;
+    size_t size() const;  // Listings held
+    size_t bytes() const; // Bytes they hold
+
+private:
+    struct Entry {
+        std::string path;
+        dev_t device;
+        ino_t inode;
+        timespec mtime;
+        bool racy; // Modified too close to the scan to trust the mtime
+        std::shared_ptr<const DirListing> listing;
+    };
+
+    void evict_to(size_t bytes);
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // Most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_; // Keys view Entry::path
+    size_t capacity_;
+    size_t bytes_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
+
+// Global directory listing cache instance
+extern DirCache dir_cache;
+
+// Type of a listed entry with symbolic links followed (a stat only for links);
+// path is the entry's full path. DT_UNKNOWN for a dangling link.
+unsigned char followed_type(const DirEntry& entry, const std::string& path);
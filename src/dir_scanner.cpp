@@ -0,0 +1,67 @@
+#include "dir_scanner.h"
+#include <cerrno>
+#include <cstdint>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    // Record layout getdents64() fills the buffer with
+    struct LinuxDirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    // One buffer per thread, lent to a scanner while it is open. A scanner
+    // opened while another is in use on the thread allocates its own.
+    thread_local std::vector<char> spare_buffer;
+} // namespace
+
+DirScanner::DirScanner(const char* path) {
+    fd_ = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd_ < 0) return;
+    buffer_ = std::move(spare_buffer);
+    buffer_.resize(buffer_size);
+}
+
+DirScanner::~DirScanner() {
+    if (fd_ < 0) return;
+    close(fd_);
+    if (spare_buffer.empty()) spare_buffer = std::move(buffer_);
+}
+
+bool DirScanner::next(DirEntry& entry) {
+    if (fd_ < 0) return false;
+    while (true) {
+        if (pos_ >= end_) {
+            long n;
+            do {
+                n = syscall(SYS_getdents64, fd_, buffer_.data(), buffer_.size());
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) return false;
+            pos_ = 0;
+            end_ = static_cast<size_t>(n);
+        }
+
+        const auto* record = reinterpret_cast<const LinuxDirent64*>(buffer_.data() + pos_);
+        pos_ += record->d_reclen;
+        const char* name = record->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        entry.name = std::string_view(name);
+        entry.type = record->d_type;
+        return true;
+    }
+}
+
+unsigned char DirScanner::type_of(const DirEntry& entry, bool follow_links) const {
+    if (entry.type != DT_UNKNOWN && (entry.type != DT_LNK || !follow_links)) return entry.type;
+
+    struct stat st;
+    if (fstatat(fd_, entry.name.data(), &st, follow_links ? 0 : AT_SYMLINK_NOFOLLOW) != 0) return DT_UNKNOWN;
+    return IFTODT(st.st_mode);
+}
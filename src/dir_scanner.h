@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// An entry read by DirScanner. The name is NUL-terminated and stays valid
+// until the next call to next().
+struct DirEntry {
+    std::string_view name;
+    unsigned char type; // DT_* as reported by the file system; DT_UNKNOWN if it does not say
+};
+
+/**
+ * Directory reader on raw getdents64(). Entries are handed out straight from
+ * a large buffer, reused by every scan on the thread, together with their
+ * d_type, so callers filter on the name bytes without building paths and
+ * only pay for a stat when the file system leaves the type unknown.
+ * "." and ".." are skipped.
+ */
+class DirScanner {
+public:
+    static constexpr size_t buffer_size = 256 * 1024;
+
+    explicit DirScanner(const char* path);
+    ~DirScanner();
+    DirScanner(const DirScanner&) = delete;
+    DirScanner& operator=(const DirScanner&) = delete;
+
+    bool is_open() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+
+    // Read the next entry; false at the end of the directory or on an error
+    bool next(DirEntry& entry);
+
+    // Type of an entry: its d_type, or from fstatat() when that is DT_UNKNOWN,
+    // or DT_LNK and follow_links is set. DT_UNKNOWN if the stat fails.
+    unsigned char type_of(const DirEntry& entry, bool follow_links) const;
+
+private:
+    int fd_ = -1;
+    std::vector<char> buffer_; // Taken from the thread's spare buffer, returned when done
+    size_t pos_ = 0;
+    size_t end_ = 0;
+};
@@ -0,0 +1,164 @@
+#include "dir_walker.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <dirent.h>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include "dir_scanner.h"
+
+namespace {
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::string> dirs; // Relative paths of directories to scan
+    };
+
+    struct WalkState {
+        std::string root;
+        unsigned max_workers;
+        std::vector<WorkQueue> queues;
+        std::vector<std::vector<std::string>> results; // One buffer per worker, merged at the end
+        std::atomic<size_t> pending{0};   // Directories queued or being scanned
+        std::atomic<size_t> queued{0};    // Directories queued and not yet taken
+        std::atomic<unsigned> sleepers{0}; // Workers waiting for a directory
+        std::atomic<unsigned> started{1}; // Workers running, counting the caller
+        std::mutex idle_mutex;
+        std::condition_variable idle;
+        std::mutex workers_mutex;
+        std::vector<std::thread> workers; // Started by start_worker(); joined by the caller
+        bool spawn_failed = false;
+        const std::function<bool(const WalkEntry&)>& descend;
+        const std::function<bool(const WalkEntry&)>& collect;
+
+        WalkState(const std::string& root_dir, unsigned threads, const std::function<bool(const WalkEntry&)>& d,
+                  const std::function<bool(const WalkEntry&)>& c) :
+            root(root_dir), max_workers(threads), queues(threads), results(threads), descend(d), collect(c) {}
+
+        void push(unsigned worker, std::string relative) {
+            pending.fetch_add(1);
+            {
+                std::lock_guard lock(queues[worker].mutex);
+                queues[worker].dirs.push_back(std::move(relative));
+            }
+            size_t waiting = queued.fetch_add(1) + 1;
+            if (sleepers.load() > 0) {
+                // Taking the lock means the sleeper is either waiting or will see the new count
+                { std::lock_guard lock(idle_mutex); }
+                idle.notify_one();
+            } else if (waiting > 1) {
+                // More directories than the pushing worker will take next
+                start_worker();
+            }
+        }
+
+        // Own queue first (LIFO, for locality), then steal the oldest task from another worker
+        bool take(unsigned worker, std::string& out) {
+            unsigned count = started.load();
+            for (unsigned i = 0; i < count; ++i) {
+                WorkQueue& queue = queues[(worker + i) % count];
+                std::lock_guard lock(queue.mutex);
+                if (queue.dirs.empty()) continue;
+                if (i == 0) {
+                    out = std::move(queue.dirs.back());
+                    queue.dirs.pop_back();
+                } else {
+                    out = std::move(queue.dirs.front());
+                    queue.dirs.pop_front();
+                }
+                queued.fetch_sub(1);
+                return true;
+            }
+            return false;
+        }
+
+        // Block until a directory is queued or the walk is over; false when it is over
+        bool wait_for_work() {
+            std::unique_lock lock(idle_mutex);
+            sleepers.fetch_add(1);
+            idle.wait(lock, [this] { return queued.load() > 0 || pending.load() == 0; });
+            sleepers.fetch_sub(1);
+            return pending.load() != 0;
+        }
+
+        void finish_directory() {
+            if (pending.fetch_sub(1) != 1) return;
+            // The last directory is done: wake every sleeper so it can leave
+            { std::lock_guard lock(idle_mutex); }
+            idle.notify_all();
+        }
+
+        // Add a worker thread unless all are running. Workers are only added
+        // while directories are pending, so none start after the walk ends.
+        void start_worker();
+    };
+
+    void scan_directory(WalkState& state, unsigned worker, const std::string& relative) {
+        std::string dir_path = relative.empty() ? state.root : state.root + "/" + relative;
+        DirScanner scanner(dir_path.c_str());
+        std::vector<std::string>& results = state.results[worker];
+
+        std::string child;
+        DirEntry entry;
+        while (scanner.next(entry)) {
+            bool is_directory = scanner.type_of(entry, false) == DT_DIR;
+
+            child.assign(relative);
+            if (!child.empty()) child += '/';
+            child += entry.name;
+
+            WalkEntry walk_entry{child, std::string_view(child).substr(child.size() - entry.name.size()), is_directory};
+            if (state.collect(walk_entry)) results.push_back(child);
+            if (is_directory && state.descend(walk_entry)) state.push(worker, child);
+        }
+    }
+
+    void run_worker(WalkState& state, unsigned worker) {
+        std::string relative;
+        while (true) {
+            if (state.take(worker, relative)) {
+                scan_directory(state, worker, relative);
+                state.finish_directory();
+            } else if (!state.wait_for_work()) {
+                return;
+            }
+        }
+    }
+
+    void WalkState::start_worker() {
+        std::lock_guard lock(workers_mutex);
+        unsigned index = started.load();
+        if (index >= max_workers || spawn_failed) return;
+        started.store(index + 1);
+        try {
+            workers.emplace_back(run_worker, std::ref(*this), index);
+        } catch (const std::system_error&) {
+            // Out of threads: the workers already running finish the walk
+            started.store(index);
+            spawn_failed = true;
+        }
+    }
+} // namespace
+
+std::vector<std::string> parallel_walk(const std::string& root, unsigned threads,
+                                       const std::function<bool(const WalkEntry&)>& descend,
+                                       const std::function<bool(const WalkEntry&)>& collect) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // The caller is the first worker; the others start as directories pile up
+    WalkState state(root, threads, descend, collect);
+    state.push(0, "");
+    run_worker(state, 0);
+    {
+        std::lock_guard lock(state.workers_mutex);
+        for (auto& worker : state.workers) worker.join();
+    }
+
+    std::vector<std::string> results = std::move(state.results[0]);
+    for (unsigned i = 1; i < threads; ++i) {
+        results.insert(results.end(), std::make_move_iterator(state.results[i].begin()),
+                       std::make_move_iterator(state.results[i].end()));
+    }
+    return results;
+}
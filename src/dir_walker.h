@@ -0,0 +1,33 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// An entry reported by parallel_walk()
+struct WalkEntry {
+    std::string_view relative_path; // Path below the walk root, e.g. "a/b/c.cpp"
+    std::string_view name;          // Final component, e.g. "c.cpp"
+    bool is_directory;
+};
+
+/**
+ * Walk a directory tree with a pool of threads. Each directory is a task:
+ * workers take tasks from the back of their own queue and, when it runs dry,
+ * steal from the front of other workers' queues, sleeping on a condition
+ * variable while there is none. The caller is the first worker; more are
+ * started only while directories are waiting, so a small tree is walked on
+ * the calling thread alone. If a thread cannot be created the walk goes on
+ * with those already running. Symbolic links are reported but never followed.
+ *
+ * Both callbacks run concurrently on the worker threads and must be thread-safe.
+ *
+ * @param root     Directory to walk
+ * @param threads  Most worker threads (0 = one per hardware thread)
+ * @param descend  Decides whether a subdirectory is scanned
+ * @param collect  Decides whether an entry's relative path is returned
+ * @return The collected relative paths, in no particular order
+ */
+std::vector<std::string> parallel_walk(const std::string& root, unsigned threads,
+                                       const std::function<bool(const WalkEntry&)>& descend,
+                                       const std::function<bool(const WalkEntry&)>& collect);
@@ -0,0 +1,174 @@
+#include "fd_copy.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bytes asked of the kernel per call, and the size of the fallback buffer
+static constexpr size_t chunk_size = 1 << 20;
+static constexpr size_t buffer_size = 128 * 1024;
+
+// Errors meaning "not for these descriptors" rather than a failed transfer
+static bool unsupported(int error) {
+    return error == EINVAL || error == EXDEV || error == ENOSYS || error == EOPNOTSUPP || error == EBADF;
+}
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Copy in to every output through a buffer
+static bool read_write(int in, const std::vector<int>& outs) {
+    static thread_local std::vector<char> buffer(buffer_size);
+    while (true) {
+        ssize_t n = read(in, buffer.data(), buffer.size());
+        if (n == 0) return true;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        for (int out : outs) {
+            if (!write_all(out, buffer.data(), n)) return false;
+        }
+    }
+}
+
+// Move exactly size bytes from the pipe in to out, spliced while out accepts it
+static bool drain_pipe(int in, int out, size_t size, bool& spliceable) {
+    static thread_local std::vector<char> buffer(buffer_size);
+    while (size > 0) {
+        ssize_t n;
+        if (spliceable) {
+            n = splice(in, nullptr, out, nullptr, size, SPLICE_F_MOVE);
+            if (n < 0 && unsupported(errno)) {
+                spliceable = false; // A terminal or an O_APPEND file
+                continue;
+            }
+        } else {
+            n = read(in, buffer.data(), std::min(size, buffer.size()));
+            if (n > 0 && !write_all(out, buffer.data(), n)) return false;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) {
+            errno = EIO; // The bytes tee(2) saw are gone
+            return false;
+        }
+        size -= n;
+    }
+    return true;
+}
+
+bool copy_fd(int in, int out, CopyMethod* method) {
+    struct stat in_stat, out_stat;
+    if (fstat(in, &in_stat) == -1 || fstat(out, &out_stat) == -1) return false;
+
+    // /proc and /sys files claim to be empty regular files; only read() sees their contents
+    bool regular_in = S_ISREG(in_stat.st_mode) && in_stat.st_size > 0;
+    CopyMethod current = regular_in && S_ISREG(out_stat.st_mode)         ? CopyMethod::CopyFileRange
+                         : regular_in                                    ? CopyMethod::Sendfile
+                         : S_ISFIFO(in_stat.st_mode) || S_ISFIFO(out_stat.st_mode) ? CopyMethod::Splice
+                                                                                   : CopyMethod::ReadWrite;
+    while (current != CopyMethod::ReadWrite) {
+        ssize_t n;
+        if (current == CopyMethod::CopyFileRange) {
+            n = copy_file_range(in, nullptr, out, nullptr, chunk_size, 0);
+        } else if (current == CopyMethod::Sendfile) {
+            n = sendfile(out, in, nullptr, chunk_size);
+        } else {
+            n = splice(in, nullptr, out, nullptr, chunk_size, SPLICE_F_MOVE);
+        }
+        if (n > 0) continue;
+        if (n == 0) {
+            if (method) *method = current;
+            return true;
+        }
+        if (errno == EINTR) continue;
+        if (!unsupported(errno)) return false;
+        // Carry on from where it stopped with the next, more general method
+        current = current == CopyMethod::CopyFileRange ? CopyMethod::Sendfile
+                  : current == CopyMethod::Sendfile && S_ISFIFO(out_stat.st_mode) ? CopyMethod::Splice
+                                                                                  : CopyMethod::ReadWrite;
+    }
+    if (method) *method = CopyMethod::ReadWrite;
+    return read_write(in, {out});
+}
+
+bool tee_fd(int in, const std::vector<int>& outs, CopyMethod* method) {
+    if (outs.empty()) return true;
+    if (outs.size() == 1) return copy_fd(in, outs[0], method);
+
+    struct stat in_stat;
+    int internal[2];
+    if (fstat(in, &in_stat) == -1) return false;
+    if (!S_ISFIFO(in_stat.st_mode) || pipe2(internal, O_CLOEXEC) == -1) {
+        if (method) *method = CopyMethod::ReadWrite;
+        return read_write(in, outs);
+    }
+    fcntl(internal[1], F_SETPIPE_SZ, static_cast<int>(chunk_size));
+    int capacity = fcntl(internal[1], F_GETPIPE_SZ);
+
+    // Each chunk is duplicated into the empty private pipe once per output
+    // but the last, so every tee(2) after the first gets the same bytes
+    std::vector<bool> spliceable(outs.size(), true);
+    bool ok = true;
+    bool first = true;
+    while (ok) {
+        ssize_t n = tee(in, internal[1], capacity > 0 ? capacity : 65536, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (first && unsupported(errno)) {
+                close(internal[0]);
+                close(internal[1]);
+                if (method) *method = CopyMethod::ReadWrite;
+                return read_write(in, outs);
+            }
+            ok = false;
+            break;
+        }
+        first = false;
+        if (n == 0) break;
+        for (size_t k = 0; ok && k + 1 < outs.size(); ++k) {
+            if (k > 0) {
+                ssize_t again;
+                do {
+                    again = tee(in, internal[1], n, 0);
+                } while (again < 0 && errno == EINTR);
+                if (again != n) {
+                    if (again >= 0) errno = EIO;
+                    ok = false;
+                    break;
+                }
+            }
+            bool spliced = spliceable[k];
+            ok = drain_pipe(internal[0], outs[k], n, spliced);
+            spliceable[k] = spliced;
+        }
+        if (!ok) break;
+        bool spliced = spliceable.back();
+        ok = drain_pipe(in, outs.back(), n, spliced);
+        spliceable.back() = spliced;
+    }
+    int saved_errno = errno;
+    close(internal[0]);
+    close(internal[1]);
+    errno = saved_errno;
+    if (method) {
+        bool all_spliced = std::all_of(spliceable.begin(), spliceable.end(), [](bool s) { return s; });
+        *method = all_spliced ? CopyMethod::Splice : CopyMethod::ReadWrite;
+    }
+    return ok;
+}
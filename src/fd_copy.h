@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+
+// How bytes were moved between descriptors, from most to least direct
+enum class CopyMethod {
+    CopyFileRange, // File to file, inside the file system (may share extents)
+    Sendfile,      // File to anything, through the page cache
+    Splice,        // To or from a pipe, moving page references
+    ReadWrite      // Through a user-space buffer
+};
+
+/**
+ * Copy everything from in (from its current position) to out, keeping the
+ * data in the kernel when the descriptor types allow it. A method the
+ * kernel refuses (EINVAL, EXDEV, ...) falls back to the next one, down to
+ * read()/write().
+ *
+ * @param method If given, receives the method that finished the copy
+ * @return false on a read or write error, with errno set
+ */
+bool copy_fd(int in, int out, CopyMethod* method = nullptr);
+
+/**
+ * Copy in to every descriptor in outs. When in is a pipe each chunk is
+ * duplicated with tee(2) into a private pipe and spliced out from there,
+ * and the last output consumes it from in with splice(2); otherwise the
+ * data goes through one buffer written to every output.
+ */
+bool tee_fd(int in, const std::vector<int>& outs, CopyMethod* method = nullptr);
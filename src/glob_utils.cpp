@@ -1,23 +1,136 @@
 #include "glob_utils.h"
-#include <filesystem>
 #include <algorithm>
+#include <dirent.h>
 #include <iostream>
+#include <thread>
+#include "dir_cache.h"
+#include "dir_walker.h"
+#include "shell_options.h"
+#include "trace.h"
+
+// Match counts from which sort_matches() uses several threads
+static constexpr size_t parallel_sort_threshold = 1 << 16;
+
+GlobPattern::GlobPattern(std::string_view pattern) {
+    segments.emplace_back();
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (c == '*') {
+            segments.emplace_back();
+            continue;
+        }
+
+        Segment& segment = segments.back();
+        if (c == '?') {
+            segment.atoms.push_back({Atom::Kind::Any});
+            segment.is_literal = false;
+            continue;
+        }
+
+        if (c == '[') {
+            // Parse a bracket class; an unterminated '[' is a literal
+            size_t j = i + 1;
+            bool negate = j < pattern.size() && (pattern[j] == '!' || pattern[j] == '^');
+            if (negate) ++j;
+            std::bitset<256> chars;
+            size_t first = j;
+            for (; j < pattern.size() && (pattern[j] != ']' || j == first); ++j) {
+                unsigned char lo = pattern[j];
+                if (j + 2 < pattern.size() && pattern[j + 1] == '-' && pattern[j + 2] != ']') {
+                    unsigned char hi = pattern[j + 2];
+                    for (unsigned ch = lo; ch <= hi; ++ch) chars.set(ch);
+                    j += 2;
+                } else {
+                    chars.set(lo);
+                }
+            }
+            if (j < pattern.size()) {
+                if (negate) chars.flip();
+                segment.atoms.push_back({Atom::Kind::Class, 0, classes.size()});
+                segment.is_literal = false;
+                classes.push_back(chars);
+                i = j;
+                continue;
+            }
+        }
+
+        segment.atoms.push_back({Atom::Kind::Literal, c});
+        segment.literal += c;
+    }
+}
+
+bool GlobPattern::matches_at(const Segment& segment, std::string_view filename, size_t pos) const {
+    if (segment.is_literal) {
+        return filename.compare(pos, segment.literal.size(), segment.literal) == 0;
+    }
+    for (size_t k = 0; k < segment.atoms.size(); ++k) {
+        const Atom& atom = segment.atoms[k];
+        unsigned char c = filename[pos + k];
+        switch (atom.kind) {
+            case Atom::Kind::Literal:
+                if (c != static_cast<unsigned char>(atom.literal)) return false;
+                break;
+            case Atom::Kind::Class:
+                if (!classes[atom.class_index].test(c)) return false;
+                break;
+            case Atom::Kind::Any:
+                break;
+        }
+    }
+    return true;
+}
+
+// Leftmost position >= from where the segment matches and ends by `last`, or npos
+size_t GlobPattern::find_segment(const Segment& segment, std::string_view filename, size_t from, size_t last) const {
+    size_t width = segment.atoms.size();
+    if (from + width > last) return std::string_view::npos;
+    if (segment.is_literal) {
+        return filename.substr(0, last).find(segment.literal, from);
+    }
+    for (size_t pos = from; pos + width <= last; ++pos) {
+        if (matches_at(segment, filename, pos)) return pos;
+    }
+    return std::string_view::npos;
+}
+
+bool GlobPattern::matches(std::string_view filename) const {
+    const Segment& head = segments.front();
+    if (segments.size() == 1) {
+        return filename.size() == head.atoms.size() && matches_at(head, filename, 0);
+    }
+
+    // Anchor the first segment at the start and the last at the end
+    const Segment& tail = segments.back();
+    if (head.atoms.size() + tail.atoms.size() > filename.size()) return false;
+    size_t tail_pos = filename.size() - tail.atoms.size();
+    if (!matches_at(head, filename, 0) || !matches_at(tail, filename, tail_pos)) return false;
+
+    // Place each middle segment at its leftmost match
+    size_t pos = head.atoms.size();
+    for (size_t i = 1; i + 1 < segments.size(); ++i) {
+        size_t found = find_segment(segments[i], filename, pos, tail_pos);
+        if (found == std::string_view::npos) return false;
+        pos = found + segments[i].atoms.size();
+    }
+    return true;
+}
+
+const GlobPattern& GlobPatternCache::get(const std::string& pattern) {
+    auto it = compiled.find(pattern);
+    if (it == compiled.end()) {
+        it = compiled.emplace(pattern, GlobPattern(pattern)).first;
+    }
+    return it->second;
+}
 
 std::vector<std::string> expand_glob_patterns(const std::vector<std::string>& tokens) {
+    TraceSpan span("expand_glob_patterns");
     std::vector<std::string> expanded_tokens;
+    GlobPatternCache cache;
     
     for (const std::string& token : tokens) {
-        if (contains_glob_pattern(token)) {
-            std::vector<std::string> matches = expand_single_pattern(token);
-            if (!matches.empty()) {
-                // Add all matches to the result
-                expanded_tokens.insert(expanded_tokens.end(), matches.begin(), matches.end());
-            } else {
-                // No matches found, keep the literal pattern
-                expanded_tokens.push_back(token);
-            }
-        } else {
-            // No glob pattern, keep as-is
+        // Matches go straight into the result; no matches keeps the literal pattern
+        if (!contains_glob_pattern(token) || expand_single_pattern_into(token, cache, expanded_tokens) == 0) {
             expanded_tokens.push_back(token);
         }
     }
@@ -26,98 +139,201 @@ std::vector<std::string> expand_glob_patterns(const std::vector<std::string>& to
 }
 
 bool contains_glob_pattern(const std::string& str) {
-    return str.find('*') != std::string::npos || str.find('?') != std::string::npos;
+    if (str.find_first_of("*?") != std::string::npos) return true;
+    size_t open = str.find('[');
+    return open != std::string::npos && str.find(']', open + 2) != std::string::npos;
 }
 
 std::vector<std::string> expand_single_pattern(const std::string& pattern) {
-    std::vector<std::string> matches;
-    namespace fs = std::filesystem;
-    
-    try {
-        // Handle different cases based on pattern structure
-        std::string dir_path = ".";
-        std::string filename_pattern = pattern;
-        
-        // Check if pattern contains directory separators
-        size_t last_slash = pattern.find_last_of('/');
-        if (last_slash != std::string::npos) {
-            dir_path = pattern.substr(0, last_slash);
-            filename_pattern = pattern.substr(last_slash + 1);
-            
-            // Handle empty directory path (e.g., "/pattern")
-            if (dir_path.empty()) {
-                dir_path = "/";
+    GlobPatternCache cache;
+    return expand_single_pattern(pattern, cache);
+}
+
+void sort_matches(std::vector<std::string>::iterator first, std::vector<std::string>::iterator last) {
+    size_t count = static_cast<size_t>(last - first);
+    unsigned threads = shell_options.glob_threads ? shell_options.glob_threads : std::thread::hardware_concurrency();
+    threads = static_cast<unsigned>(std::min<size_t>(threads, count / (parallel_sort_threshold / 2)));
+    if (count < parallel_sort_threshold || threads < 2) {
+        std::sort(first, last);
+        return;
+    }
+
+    // Sort equal runs concurrently, then merge neighbouring runs pairwise,
+    // doubling their length each round until one is left
+    TraceSpan span("sort_matches");
+    std::vector<std::vector<std::string>::iterator> bounds;
+    for (unsigned i = 0; i < threads; ++i) bounds.push_back(first + static_cast<std::ptrdiff_t>(count * i / threads));
+    bounds.push_back(last);
+    auto in_parallel = [](size_t jobs, const auto& job) {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < jobs; ++i) workers.emplace_back(job, i);
+        job(0);
+        for (auto& worker : workers) worker.join();
+    };
+    in_parallel(threads, [&](size_t i) { std::sort(bounds[i], bounds[i + 1]); });
+    for (size_t width = 1; width < threads; width *= 2) {
+        in_parallel((threads - width + 2 * width - 1) / (2 * width), [&](size_t k) {
+            size_t i = k * 2 * width;
+            std::inplace_merge(bounds[i], bounds[i + width], bounds[std::min<size_t>(i + 2 * width, threads)]);
+        });
+    }
+}
+
+namespace {
+    // One '/'-separated component of a multi-level pattern
+    struct ComponentPattern {
+        const GlobPattern* glob = nullptr; // nullptr for "**"
+        bool matches_hidden = false;       // Component starts with '.'
+    };
+
+    void split_path(std::string_view path, std::vector<std::string_view>& out) {
+        out.clear();
+        while (!path.empty()) {
+            size_t slash = path.find('/');
+            std::string_view component = path.substr(0, slash);
+            if (!component.empty()) out.push_back(component);
+            if (slash == std::string_view::npos) break;
+            path.remove_prefix(slash + 1);
+        }
+    }
+
+    // Match path components against pattern components, where "**" matches any
+    // number of non-hidden components. With `partial`, also accept a path that
+    // could be extended into a match (used to decide whether to descend).
+    bool match_components(const std::vector<ComponentPattern>& patterns, size_t pi,
+                          const std::vector<std::string_view>& path, size_t ci, bool partial) {
+        if (ci == path.size()) {
+            if (partial) return pi < patterns.size();
+            for (; pi < patterns.size(); ++pi) {
+                if (patterns[pi].glob) return false;
             }
+            return true;
         }
-        
-        // Scan the directory for matches
-        if (fs::exists(dir_path) && fs::is_directory(dir_path)) {
-            for (const auto& entry : fs::directory_iterator(dir_path)) {
-                if (entry.is_regular_file() || entry.is_directory()) {
-                    std::string filename = entry.path().filename().string();
-                    
-                    // Skip hidden files unless pattern explicitly starts with '.'
-                    if (filename[0] == '.' && filename_pattern[0] != '.') {
-                        continue;
-                    }
-                    
-                    if (matches_pattern(filename, filename_pattern)) {
-                        std::string full_path;
-                        if (dir_path == ".") {
-                            full_path = filename;
-                        } else if (dir_path == "/") {
-                            full_path = "/" + filename;
-                        } else {
-                            full_path = dir_path + "/" + filename;
-                        }
-                        matches.push_back(full_path);
-                    }
-                }
+        if (pi == patterns.size()) return false;
+
+        const ComponentPattern& pattern = patterns[pi];
+        bool hidden = path[ci][0] == '.';
+        if (!pattern.glob) {
+            if (match_components(patterns, pi + 1, path, ci, partial)) return true;
+            return !hidden && match_components(patterns, pi, path, ci + 1, partial);
+        }
+        if (hidden && !pattern.matches_hidden) return false;
+        return pattern.glob->matches(path[ci]) && match_components(patterns, pi + 1, path, ci + 1, partial);
+    }
+
+    // Append the matches of a pattern with wildcards above its last component
+    // (including "**") by walking the tree below its longest literal prefix
+    void expand_recursive_pattern(const std::string& pattern, GlobPatternCache& cache, std::vector<std::string>& out) {
+        std::vector<std::string_view> components;
+        split_path(pattern, components);
+
+        std::string root = pattern[0] == '/' ? "/" : "";
+        size_t first_glob = 0;
+        for (; first_glob < components.size(); ++first_glob) {
+            std::string component(components[first_glob]);
+            if (contains_glob_pattern(component)) break;
+            if (!root.empty() && root.back() != '/') root += '/';
+            root += component;
+        }
+        if (root.empty()) root = ".";
+
+        // Compile every component up front; the walk callbacks run on several threads
+        std::vector<ComponentPattern> patterns;
+        for (size_t i = first_glob; i < components.size(); ++i) {
+            std::string component(components[i]);
+            ComponentPattern compiled;
+            if (component != "**") compiled.glob = &cache.get(component);
+            compiled.matches_hidden = component[0] == '.';
+            patterns.push_back(compiled);
+        }
+
+        auto matches_entry = [&patterns](const WalkEntry& entry, bool partial) {
+            thread_local std::vector<std::string_view> path;
+            split_path(entry.relative_path, path);
+            return match_components(patterns, 0, path, 0, partial);
+        };
+        std::vector<std::string> matches = parallel_walk(
+            root, shell_options.glob_threads, [&](const WalkEntry& entry) { return matches_entry(entry, true); },
+            [&](const WalkEntry& entry) { return matches_entry(entry, false); });
+
+        if (root != ".") {
+            std::string prefix = root.back() == '/' ? root : root + "/";
+            for (auto& match : matches) {
+                match.insert(0, prefix);
             }
         }
-    } catch (const fs::filesystem_error& e) {
-        // If filesystem access fails, return empty vector
-        // This will cause the literal pattern to be preserved
-        return {};
+        size_t first = out.size();
+        if (out.empty()) {
+            out = std::move(matches);
+        } else {
+            out.insert(out.end(), std::make_move_iterator(matches.begin()), std::make_move_iterator(matches.end()));
+        }
+        sort_matches(out.begin() + static_cast<std::ptrdiff_t>(first), out.end());
     }
-    
-    // Sort matches for consistent output
-    std::sort(matches.begin(), matches.end());
-    
-    return matches;
-}
+} // namespace
 
-bool matches_pattern(const std::string& filename, const std::string& pattern) {
-    // Use dynamic programming approach for pattern matching
-    size_t f_len = filename.length();
-    size_t p_len = pattern.length();
-    
-    // DP table: dp[i][j] = true if filename[0...i-1] matches pattern[0...j-1]
-    std::vector<std::vector<bool>> dp(f_len + 1, std::vector<bool>(p_len + 1, false));
-    
-    // Empty pattern matches empty filename
-    dp[0][0] = true;
+size_t expand_single_pattern_into(const std::string& pattern, GlobPatternCache& cache, std::vector<std::string>& out) {
+    TraceSpan span("expand_glob", pattern);
+    size_t first = out.size();
+
+    // Wildcards in a directory component (e.g. src/**/*.cpp) or a final "**" need a tree walk
+    size_t slash = pattern.find_last_of('/');
+    std::string_view last_component = std::string_view(pattern).substr(slash == std::string::npos ? 0 : slash + 1);
+    if (last_component == "**" ||
+        (slash != std::string::npos && contains_glob_pattern(pattern.substr(0, slash)))) {
+        expand_recursive_pattern(pattern, cache, out);
+        return out.size() - first;
+    }
     
-    // Handle patterns starting with '*'
-    for (size_t j = 1; j <= p_len; ++j) {
-        if (pattern[j-1] == '*') {
-            dp[0][j] = dp[0][j-1];
+    // Handle different cases based on pattern structure
+    std::string dir_path = ".";
+    std::string filename_pattern = pattern;
+
+    // Check if pattern contains directory separators
+    size_t last_slash = pattern.find_last_of('/');
+    if (last_slash != std::string::npos) {
+        dir_path = pattern.substr(0, last_slash);
+        filename_pattern = pattern.substr(last_slash + 1);
+
+        // Handle empty directory path (e.g., "/pattern")
+        if (dir_path.empty()) {
+            dir_path = "/";
         }
     }
-    
-    for (size_t i = 1; i <= f_len; ++i) {
-        for (size_t j = 1; j <= p_len; ++j) {
-            if (pattern[j-1] == '*') {
-                // '*' can match empty string or any character(s)
-                dp[i][j] = dp[i][j-1] || dp[i-1][j] || dp[i-1][j-1];
-            } else if (pattern[j-1] == '?' || pattern[j-1] == filename[i-1]) {
-                // '?' matches any single character, or exact character match
-                dp[i][j] = dp[i-1][j-1];
-            }
-            // else: characters don't match and pattern is not wildcard
-            // dp[i][j] remains false
+
+    const GlobPattern& compiled = cache.get(filename_pattern);
+    bool matches_hidden = !filename_pattern.empty() && filename_pattern[0] == '.';
+
+    // Match against the directory's cached listing; names are tested before
+    // anything is stat'ed, and only symbolic links need a stat at all
+    std::shared_ptr<const DirListing> listing = dir_cache.get(dir_path);
+    for (size_t i = 0; listing && i < listing->size(); ++i) {
+        DirEntry entry = (*listing)[i];
+        // Skip hidden files unless pattern explicitly starts with '.'
+        if (entry.name[0] == '.' && !matches_hidden) continue;
+        if (!compiled.matches(entry.name)) continue;
+
+        std::string full_path;
+        if (dir_path != ".") {
+            full_path = dir_path;
+            if (dir_path != "/") full_path += '/';
         }
+        full_path += entry.name;
+        unsigned char type = followed_type(entry, full_path);
+        if (type == DT_REG || type == DT_DIR) out.push_back(std::move(full_path));
     }
-    
-    return dp[f_len][p_len];
+
+    // Sort matches for consistent output
+    sort_matches(out.begin() + static_cast<std::ptrdiff_t>(first), out.end());
+    return out.size() - first;
+}
+
+std::vector<std::string> expand_single_pattern(const std::string& pattern, GlobPatternCache& cache) {
+    std::vector<std::string> matches;
+    expand_single_pattern_into(pattern, cache, matches);
+    return matches;
+}
+
+bool matches_pattern(const std::string& filename, const std::string& pattern) {
+    return GlobPattern(pattern).matches(filename);
 }
@@ -1,10 +1,63 @@
 #pragma once
+#include <bitset>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+/**
+ * A glob pattern compiled once and then matched against many filenames.
+ * Supports * (any sequence), ? (any single character) and bracket classes
+ * such as [abc], [a-z] and [!x] (or [^x]).
+ *
+ * The pattern is split at each '*' into fixed-width segments. The first
+ * segment is anchored at the start of the name and the last at the end; the
+ * segments in between are placed at their leftmost match, which is always
+ * optimal for globs, so matching never backtracks.
+ */
+class GlobPattern {
+public:
+    explicit GlobPattern(std::string_view pattern);
+
+    bool matches(std::string_view filename) const;
+
+private:
+    // One atom matches exactly one character
+    struct Atom {
+        enum class Kind { Literal, Any, Class } kind;
+        char literal = 0;
+        size_t class_index = 0;
+    };
+
+    struct Segment {
+        std::vector<Atom> atoms;
+        std::string literal; // The segment's text when every atom is a Literal
+        bool is_literal = true;
+    };
+
+    std::vector<Segment> segments; // Text between stars; always at least one
+    std::vector<std::bitset<256>> classes;
+
+    bool matches_at(const Segment& segment, std::string_view filename, size_t pos) const;
+    size_t find_segment(const Segment& segment, std::string_view filename, size_t from, size_t last) const;
+};
+
+/**
+ * Compiled patterns for one command line, so a pattern used by several
+ * tokens (or tested against many directory entries) is compiled once.
+ */
+class GlobPatternCache {
+public:
+    const GlobPattern& get(const std::string& pattern);
+
+private:
+    std::unordered_map<std::string, GlobPattern> compiled;
+};
+
 /**
  * Expand filesystem globbing patterns in a list of tokens.
- * Patterns containing '*' or '?' are expanded to matching filenames.
+ * Patterns containing '*', '?' or a bracket class are expanded to matching
+ * filenames.
  * Returns a new vector with patterns replaced by their matches (sorted).
  * If no matches are found, the literal pattern is preserved.
  * 
@@ -14,7 +67,7 @@
 std::vector<std::string> expand_glob_patterns(const std::vector<std::string>& tokens);
 
 /**
- * Check if a string contains glob pattern characters (* or ?)
+ * Check if a string contains glob pattern characters (*, ? or a [...] class)
  * 
  * @param str The string to check
  * @return true if the string contains glob patterns, false otherwise
@@ -28,10 +81,28 @@ bool contains_glob_pattern(const std::string& str);
  * @return A vector of matching filenames (sorted), or empty if no matches
  */
 std::vector<std::string> expand_single_pattern(const std::string& pattern);
+std::vector<std::string> expand_single_pattern(const std::string& pattern, GlobPatternCache& cache);
+
+/**
+ * Append the matches of a glob pattern to out, sorted, without going
+ * through a temporary vector: an argv being built receives them directly.
+ * Every match is still held at once, since they are sorted before use.
+ *
+ * @return The number of matches appended (0 leaves out unchanged)
+ */
+size_t expand_single_pattern_into(const std::string& pattern, GlobPatternCache& cache, std::vector<std::string>& out);
+
+/**
+ * Sort glob matches in place. From 64k matches the range is split into runs
+ * sorted on separate threads (`set -o globthreads`) and merged pairwise.
+ */
+void sort_matches(std::vector<std::string>::iterator first, std::vector<std::string>::iterator last);
 
 /**
  * Check if a filename matches a glob pattern.
- * Supports * (matches any sequence) and ? (matches single character).
+ * Supports * (matches any sequence), ? (matches single character) and
+ * bracket classes. Compiles the pattern on every call; use GlobPattern to
+ * test many names against one pattern.
  * 
  * @param filename The filename to test
  * @param pattern The glob pattern
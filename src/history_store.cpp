@@ -0,0 +1,454 @@
+#include "history_store.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+// Global persistent history
+HistoryStore history_store;
+
+namespace {
+
+    constexpr char index_magic[8] = {'S', 'H', 'H', 'I', 'D', 'X', '\0', '\1'};
+
+    // Rebuild the index once this much of the log is past it
+    constexpr uint64_t max_unindexed_bytes = 256 * 1024;
+
+    struct IndexHeader {
+        char magic[8];
+        uint64_t file_size;
+        uint64_t log_device; // The log the index was built from
+        uint64_t log_inode;
+        uint64_t log_size;   // Bytes of the log covered
+        uint64_t entry_count;
+        uint64_t gram_count;
+        uint64_t offsets_offset;  // uint64_t start of each entry in the log
+        uint64_t grams_offset;    // GramList[gram_count], sorted by gram
+        uint64_t postings_offset; // uint32_t entry numbers, ascending within each list
+    };
+
+    struct GramList {
+        uint32_t gram;
+        uint32_t count;
+        uint64_t first; // Index of the first posting
+    };
+
+    uint32_t gram_at(const char* p) {
+        return static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16 |
+               static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8 |
+               static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+    }
+
+    // Distinct trigrams of text, sorted
+    void grams_of(std::string_view text, std::vector<uint32_t>& grams) {
+        grams.clear();
+        for (size_t i = 0; i + 3 <= text.size(); ++i) grams.push_back(gram_at(text.data() + i));
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    }
+
+    std::string escape(std::string_view line) {
+        std::string text;
+        text.reserve(line.size());
+        for (char c : line) {
+            if (c == '\\') {
+                text += "\\\\";
+            } else if (c == '\n') {
+                text += "\\n";
+            } else {
+                text += c;
+            }
+        }
+        return text;
+    }
+
+    std::string unescape(std::string_view text) {
+        std::string line;
+        line.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\\' && i + 1 < text.size()) {
+                line += text[++i] == 'n' ? '\n' : text[i];
+            } else {
+                line += text[i];
+            }
+        }
+        return line;
+    }
+
+    // Replace path with data; readers see the old file or the whole new one
+    bool write_file_atomically(const std::string& path, std::string_view data) {
+        std::string temp_path = path + ".tmp." + std::to_string(getpid());
+        int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0) return false;
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = write(fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            written += static_cast<size_t>(n);
+        }
+        bool ok = written == data.size();
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+            unlink(temp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+} // namespace
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+bool HistoryStore::open(const std::string& path, size_t cap) {
+    close();
+    fd_ = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0) return false;
+    path_ = path;
+    cap_ = std::max<size_t>(cap, 1);
+    map_log();
+    load_index();
+
+    entries_hint_ = size();
+    if (entries_hint_ > cap_ + cap_ / 4) {
+        compact();
+    } else if (log_size_ - indexed_bytes() > max_unindexed_bytes) {
+        rebuild_index();
+    }
+    return true;
+}
+
+void HistoryStore::close() {
+    unload_index();
+    unmap_log();
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    last_line_.clear();
+    entries_hint_ = 0;
+}
+
+// Another shell may have compacted the log, renaming a new file over it
+bool HistoryStore::reopen_if_replaced() {
+    struct stat on_disk, ours;
+    if (stat(path_.c_str(), &on_disk) == 0 && fstat(fd_, &ours) == 0 && on_disk.st_dev == ours.st_dev &&
+        on_disk.st_ino == ours.st_ino) {
+        return true;
+    }
+    int fd = ::open(path_.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    unload_index();
+    unmap_log();
+    ::close(fd_);
+    fd_ = fd;
+    map_log();
+    load_index();
+    return true;
+}
+
+bool HistoryStore::map_log() {
+    struct stat st;
+    if (fstat(fd_, &st) != 0) return false;
+    size_t size = static_cast<size_t>(st.st_size);
+    if (log_ && size == log_size_) return true;
+    unmap_log();
+    if (size == 0) return true;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) return false;
+    log_ = static_cast<const char*>(map);
+    log_size_ = size;
+    return true;
+}
+
+void HistoryStore::unmap_log() {
+    if (log_) munmap(const_cast<char*>(log_), log_size_);
+    log_ = nullptr;
+    log_size_ = 0;
+}
+
+void HistoryStore::load_index() {
+    unload_index();
+    int fd = ::open((path_ + ".idx").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st, log_st;
+    if (fstat(fd, &st) != 0 || fstat(fd_, &log_st) != 0 || static_cast<size_t>(st.st_size) < sizeof(IndexHeader)) {
+        ::close(fd);
+        return;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return;
+    index_ = static_cast<const char*>(map);
+    index_size_ = size;
+
+    // Only use an index of this log that lies entirely inside the file
+    const IndexHeader& header = *reinterpret_cast<const IndexHeader*>(index_);
+    bool valid = std::memcmp(header.magic, index_magic, sizeof(index_magic)) == 0 && header.file_size == size &&
+                 header.log_device == static_cast<uint64_t>(log_st.st_dev) &&
+                 header.log_inode == static_cast<uint64_t>(log_st.st_ino) && header.log_size <= log_size_ &&
+                 header.entry_count <= size / sizeof(uint64_t) &&
+                 header.offsets_offset <= size - header.entry_count * sizeof(uint64_t) &&
+                 header.gram_count <= size / sizeof(GramList) &&
+                 header.grams_offset <= size - header.gram_count * sizeof(GramList) &&
+                 header.postings_offset <= size;
+    if (valid) {
+        const GramList* grams = reinterpret_cast<const GramList*>(index_ + header.grams_offset);
+        uint64_t postings = (size - header.postings_offset) / sizeof(uint32_t);
+        for (uint64_t i = 0; valid && i < header.gram_count; ++i) {
+            valid = grams[i].first <= postings && grams[i].count <= postings - grams[i].first;
+        }
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(index_ + header.offsets_offset);
+        valid = valid && (header.entry_count == 0 || offsets[header.entry_count - 1] < header.log_size);
+    }
+    if (!valid) unload_index();
+}
+
+void HistoryStore::unload_index() {
+    if (index_) munmap(const_cast<char*>(index_), index_size_);
+    index_ = nullptr;
+    index_size_ = 0;
+}
+
+size_t HistoryStore::indexed_entries() const {
+    return index_ ? reinterpret_cast<const IndexHeader*>(index_)->entry_count : 0;
+}
+
+uint64_t HistoryStore::indexed_bytes() const {
+    return index_ ? reinterpret_cast<const IndexHeader*>(index_)->log_size : 0;
+}
+
+std::vector<uint64_t> HistoryStore::tail_offsets() const {
+    std::vector<uint64_t> offsets;
+    uint64_t offset = indexed_bytes();
+    while (offset < log_size_) {
+        const void* newline = std::memchr(log_ + offset, '\n', log_size_ - offset);
+        if (!newline) break; // A line still being written
+        offsets.push_back(offset);
+        offset = static_cast<uint64_t>(static_cast<const char*>(newline) - log_) + 1;
+    }
+    return offsets;
+}
+
+std::string_view HistoryStore::entry_at(uint64_t offset) const {
+    if (offset >= log_size_) return {};
+    const void* newline = std::memchr(log_ + offset, '\n', log_size_ - offset);
+    size_t end = newline ? static_cast<size_t>(static_cast<const char*>(newline) - log_) : log_size_;
+    return {log_ + offset, end - offset};
+}
+
+bool HistoryStore::append(std::string_view line) {
+    if (fd_ < 0 || line.empty() || line == last_line_) return false;
+    reopen_if_replaced();
+
+    // One write() per command: O_APPEND keeps concurrent shells' records whole
+    std::string record = escape(line);
+    record += '\n';
+    ssize_t n;
+    do {
+        n = write(fd_, record.data(), record.size());
+    } while (n < 0 && errno == EINTR);
+    if (n != static_cast<ssize_t>(record.size())) return false;
+    last_line_.assign(line);
+
+    if (++entries_hint_ > cap_ + cap_ / 4) compact();
+    return true;
+}
+
+size_t HistoryStore::size() {
+    std::lock_guard lock(read_mutex_);
+    if (fd_ < 0 || !map_log()) return 0;
+    return indexed_entries() + tail_offsets().size();
+}
+
+std::vector<HistoryEntry> HistoryStore::recent(size_t count) {
+    std::lock_guard lock(read_mutex_);
+    std::vector<HistoryEntry> entries;
+    if (fd_ < 0 || !map_log()) return entries;
+    std::vector<uint64_t> tail = tail_offsets();
+    size_t indexed = indexed_entries();
+    size_t total = indexed + tail.size();
+    size_t first = total > count ? total - count : 0;
+    const uint64_t* offsets =
+        index_ ? reinterpret_cast<const uint64_t*>(index_ + reinterpret_cast<const IndexHeader*>(index_)->offsets_offset)
+               : nullptr;
+    for (size_t i = first; i < total; ++i) {
+        uint64_t offset = i < indexed ? offsets[i] : tail[i - indexed];
+        entries.push_back({i + 1, unescape(entry_at(offset))});
+    }
+    return entries;
+}
+
+std::vector<HistoryEntry> HistoryStore::search(std::string_view text, size_t limit) {
+    std::lock_guard lock(read_mutex_);
+    std::vector<HistoryEntry> results;
+    if (fd_ < 0 || limit == 0 || !map_log()) return results;
+    if (log_size_ - indexed_bytes() > max_unindexed_bytes) rebuild_index();
+
+    std::string needle = escape(text);
+    std::unordered_set<std::string_view> seen;
+    // Returns true once enough has been found
+    auto consider = [&](size_t number, uint64_t offset) {
+        std::string_view entry = entry_at(offset);
+        if (entry.find(needle) != std::string_view::npos && seen.insert(entry).second) {
+            results.push_back({number, unescape(entry)});
+        }
+        return results.size() >= limit;
+    };
+
+    // Newest first: the unindexed tail, then the indexed entries
+    std::vector<uint64_t> tail = tail_offsets();
+    size_t indexed = indexed_entries();
+    for (size_t i = tail.size(); i-- > 0;) {
+        if (consider(indexed + i + 1, tail[i])) return results;
+    }
+    if (!index_) return results;
+
+    const IndexHeader& header = *reinterpret_cast<const IndexHeader*>(index_);
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(index_ + header.offsets_offset);
+    if (needle.size() < 3) {
+        for (size_t i = indexed; i-- > 0;) {
+            if (consider(i + 1, offsets[i])) break;
+        }
+        return results;
+    }
+
+    // Only entries holding the query's rarest trigram can match
+    const GramList* grams = reinterpret_cast<const GramList*>(index_ + header.grams_offset);
+    const GramList* grams_end = grams + header.gram_count;
+    const GramList* rarest = nullptr;
+    std::vector<uint32_t> needle_grams;
+    grams_of(needle, needle_grams);
+    for (uint32_t gram : needle_grams) {
+        const GramList* list = std::lower_bound(grams, grams_end, gram,
+                                                [](const GramList& g, uint32_t value) { return g.gram < value; });
+        if (list == grams_end || list->gram != gram) return results; // Some trigram never occurs
+        if (!rarest || list->count < rarest->count) rarest = list;
+    }
+    const uint32_t* postings = reinterpret_cast<const uint32_t*>(index_ + header.postings_offset) + rarest->first;
+    for (size_t i = rarest->count; i-- > 0;) {
+        uint32_t entry = postings[i];
+        if (entry < indexed && consider(entry + 1, offsets[entry])) break;
+    }
+    return results;
+}
+
+bool HistoryStore::rebuild_index() {
+    if (fd_ < 0 || !map_log()) return false;
+    struct stat log_st;
+    if (fstat(fd_, &log_st) != 0) return false;
+
+    // Entry offsets and the postings count of every trigram
+    std::vector<uint64_t> offsets;
+    std::unordered_map<uint32_t, uint64_t> counts;
+    std::vector<uint32_t> grams;
+    uint64_t covered = 0;
+    while (covered < log_size_) {
+        const void* newline = std::memchr(log_ + covered, '\n', log_size_ - covered);
+        if (!newline) break;
+        uint64_t end = static_cast<uint64_t>(static_cast<const char*>(newline) - log_);
+        offsets.push_back(covered);
+        grams_of({log_ + covered, end - covered}, grams);
+        for (uint32_t gram : grams) ++counts[gram];
+        covered = end + 1;
+    }
+
+    std::vector<GramList> lists;
+    lists.reserve(counts.size());
+    for (const auto& [gram, count] : counts) lists.push_back({gram, static_cast<uint32_t>(count), 0});
+    std::sort(lists.begin(), lists.end(), [](const GramList& a, const GramList& b) { return a.gram < b.gram; });
+    uint64_t total_postings = 0;
+    std::unordered_map<uint32_t, uint64_t> cursor; // Next free posting of each trigram
+    cursor.reserve(lists.size());
+    for (GramList& list : lists) {
+        list.first = total_postings;
+        cursor[list.gram] = total_postings;
+        total_postings += list.count;
+    }
+
+    IndexHeader header{};
+    std::memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.log_device = static_cast<uint64_t>(log_st.st_dev);
+    header.log_inode = static_cast<uint64_t>(log_st.st_ino);
+    header.log_size = covered;
+    header.entry_count = offsets.size();
+    header.gram_count = lists.size();
+    header.offsets_offset = sizeof(IndexHeader);
+    header.grams_offset = header.offsets_offset + offsets.size() * sizeof(uint64_t);
+    header.postings_offset = header.grams_offset + lists.size() * sizeof(GramList);
+    header.file_size = header.postings_offset + total_postings * sizeof(uint32_t);
+
+    std::string image(header.file_size, '\0');
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + header.offsets_offset, offsets.data(), offsets.size() * sizeof(uint64_t));
+    std::memcpy(image.data() + header.grams_offset, lists.data(), lists.size() * sizeof(GramList));
+    uint32_t* postings = reinterpret_cast<uint32_t*>(image.data() + header.postings_offset);
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        uint64_t end = i + 1 < offsets.size() ? offsets[i + 1] - 1 : covered - 1;
+        grams_of({log_ + offsets[i], end - offsets[i]}, grams);
+        for (uint32_t gram : grams) postings[cursor[gram]++] = static_cast<uint32_t>(i);
+    }
+
+    if (!write_file_atomically(path_ + ".idx", image)) return false;
+    load_index();
+    return index_ != nullptr;
+}
+
+bool HistoryStore::compact() {
+    if (fd_ < 0 || !reopen_if_replaced() || !map_log()) return false;
+    // One compaction at a time; appends never take the lock
+    if (flock(fd_, LOCK_EX | LOCK_NB) != 0) return false;
+
+    std::vector<uint64_t> offsets;
+    for (uint64_t offset = 0; offset < log_size_;) {
+        const void* newline = std::memchr(log_ + offset, '\n', log_size_ - offset);
+        if (!newline) break;
+        offsets.push_back(offset);
+        offset = static_cast<uint64_t>(static_cast<const char*>(newline) - log_) + 1;
+    }
+    // Newest cap distinct entries, each at its latest position
+    std::vector<std::string_view> kept;
+    std::unordered_set<std::string_view> seen;
+    for (size_t i = offsets.size(); i-- > 0 && kept.size() < cap_;) {
+        std::string_view entry = entry_at(offsets[i]);
+        if (seen.insert(entry).second) kept.push_back(entry);
+    }
+    std::string compacted;
+    for (size_t i = kept.size(); i-- > 0;) {
+        compacted.append(kept[i]);
+        compacted += '\n';
+    }
+    // Keep whatever other shells appended while we worked
+    struct stat st;
+    if (fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) > log_size_) {
+        size_t extra = static_cast<size_t>(st.st_size) - log_size_;
+        size_t start = compacted.size();
+        compacted.resize(start + extra);
+        ssize_t n = pread(fd_, compacted.data() + start, extra, static_cast<off_t>(log_size_));
+        compacted.resize(start + static_cast<size_t>(std::max<ssize_t>(n, 0)));
+    }
+
+    bool ok = write_file_atomically(path_, compacted);
+    flock(fd_, LOCK_UN);
+    if (!ok) return false;
+    reopen_if_replaced();
+    entries_hint_ = size();
+    return rebuild_index();
+}
+
+std::string default_history_path() {
+    if (const char* histfile = std::getenv("HISTFILE")) return histfile;
+    const char* home = std::getenv("HOME");
+    return home ? std::string(home) + "/.shell_history" : "";
+}
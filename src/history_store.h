@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A command from the persistent history, numbered from 1 (oldest kept)
+struct HistoryEntry {
+    size_t number;
+    std::string line;
+};
+
+/**
+ * Persistent history shared by every shell using the same file.
+ *
+ * The log is append-only text, one command per line (newlines and
+ * backslashes escaped). Each command is added with a single write() to an
+ * O_APPEND descriptor, so concurrent shells need no lock. Reads mmap the
+ * log instead of loading it.
+ *
+ * Search uses a trigram index kept next to the log (<file>.idx, also
+ * mmap'd). It holds the start offset of every entry and, for every trigram,
+ * the sorted list of entries containing it. A query is answered by
+ * checking only the entries in its rarest trigram's list. Entries appended
+ * since the index was built are scanned directly, and the index is rebuilt
+ * once that tail grows.
+ *
+ * When the log holds more than a quarter over the cap it is compacted,
+ * keeping the newest cap entries with earlier duplicates dropped.
+ *
+ * Readers (size, recent, search) take a lock, as they remap the log and
+ * may run on a pipeline's worker threads; writers run on the shell's main
+ * thread only.
+ */
+class HistoryStore {
+public:
+    HistoryStore() = default;
+    ~HistoryStore();
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    // Open (creating if needed) the log at path, keeping at most cap entries
+    bool open(const std::string& path, size_t cap);
+    void close();
+    bool is_open() const { return fd_ >= 0; }
+    void set_cap(size_t cap) { cap_ = cap > 0 ? cap : 1; }
+    const std::string& path() const { return path_; }
+
+    // Add a command; an immediate repeat of the last one is skipped
+    bool append(std::string_view line);
+
+    // Entries currently in the log
+    size_t size();
+
+    // The newest count entries, oldest first
+    std::vector<HistoryEntry> recent(size_t count);
+
+    // Distinct entries containing text, newest first, at most limit of them
+    std::vector<HistoryEntry> search(std::string_view text, size_t limit);
+
+    // Rebuild the trigram index over the whole log
+    bool rebuild_index();
+
+    // Rewrite the log with the newest cap distinct entries
+    bool compact();
+
+private:
+    bool reopen_if_replaced();
+    bool map_log();
+    void unmap_log();
+    void load_index();
+    void unload_index();
+    size_t indexed_entries() const;
+    uint64_t indexed_bytes() const;
+    // Start offsets of the entries after the indexed part of the log
+    std::vector<uint64_t> tail_offsets() const;
+    std::string_view entry_at(uint64_t offset) const;
+
+    std::mutex read_mutex_;
+    std::string path_;
+    size_t cap_ = 0;
+    int fd_ = -1;
+    const char* log_ = nullptr;
+    size_t log_size_ = 0;
+    const char* index_ = nullptr;
+    size_t index_size_ = 0;
+    std::string last_line_;
+    size_t entries_hint_ = 0; // Entries in the log as far as this shell knows, to decide when to compact
+};
+
+// Global persistent history, open in interactive shells
+extern HistoryStore history_store;
+
+// Default history file: $HISTFILE, else ~/.shell_history ("" without $HOME)
+std::string default_history_path();
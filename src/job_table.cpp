@@ -0,0 +1,255 @@
+#include "job_table.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include "shell_options.h"
+#include "spawn_utils.h"
+
+// Global job table instance
+JobTable job_table;
+
+// Wait for a state change of one process and record it. Returns false if
+// WNOHANG was given and nothing has happened yet.
+static bool wait_process(JobProcess& process, int options) {
+    siginfo_t info{};
+    while (true) {
+#ifdef SYS_pidfd_open
+        int rc = process.pidfd >= 0 ? waitid(P_PIDFD, process.pidfd, &info, options)
+                                    : waitid(P_PID, process.pid, &info, options);
+#else
+        int rc = waitid(P_PID, process.pid, &info, options);
+#endif
+        if (rc == 0) break;
+        if (errno == EINTR) continue;
+        // Already reaped elsewhere: nothing more will be reported for it
+        process.done = true;
+        return true;
+    }
+    if (info.si_pid == 0) return false;
+
+    switch (info.si_code) {
+        case CLD_EXITED:
+            process.done = true;
+            process.status = info.si_status;
+            break;
+        case CLD_KILLED:
+        case CLD_DUMPED:
+            process.done = true;
+            process.status = 128 + info.si_status;
+            break;
+        case CLD_STOPPED:
+            process.stopped = true;
+            break;
+        case CLD_CONTINUED:
+            process.stopped = false;
+            break;
+    }
+    return true;
+}
+
+static void update_state(Job& job) {
+    bool all_done = true;
+    bool any_stopped = false;
+    for (const auto& process : job.processes) {
+        all_done = all_done && process.done;
+        any_stopped = any_stopped || (process.stopped && !process.done);
+    }
+    job.state = all_done ? JobState::Done : any_stopped ? JobState::Stopped : JobState::Running;
+}
+
+// tcsetpgrp() from a background process group raises SIGTTOU unless it is blocked
+static void give_terminal_to(pid_t pgid) {
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGTTOU);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    tcsetpgrp(STDIN_FILENO, pgid);
+    sigprocmask(SIG_SETMASK, &old, nullptr);
+}
+
+static void continue_job(Job& job) {
+    kill(-job.pgid, SIGCONT);
+    for (auto& process : job.processes) process.stopped = false;
+    job.state = JobState::Running;
+    job.reported = JobState::Running;
+}
+
+JobTable::~JobTable() {
+    for (const auto& job : jobs_) {
+        for (const auto& process : job.processes) {
+            if (process.pidfd >= 0) close(process.pidfd);
+        }
+    }
+}
+
+Job& JobTable::add(pid_t pgid, const std::vector<pid_t>& pids, std::string command) {
+    Job job;
+    job.id = jobs_.empty() ? 1 : jobs_.back().id + 1;
+    job.pgid = pgid;
+    job.command = std::move(command);
+    for (pid_t pid : pids) {
+        job.processes.push_back({pid, open_pidfd(pid)});
+    }
+    jobs_.push_back(std::move(job));
+    return jobs_.back();
+}
+
+void JobTable::reap() {
+    for (auto& job : jobs_) {
+        if (job.state == JobState::Done) continue;
+        for (auto& process : job.processes) {
+            while (!process.done && wait_process(process, WEXITED | WSTOPPED | WCONTINUED | WNOHANG)) {
+            }
+        }
+        update_state(job);
+    }
+}
+
+int JobTable::wait(Job& job, bool stop) {
+    for (auto& process : job.processes) {
+        while (!process.done && !(stop && process.stopped)) {
+            wait_process(process, stop ? WEXITED | WSTOPPED : WEXITED);
+        }
+        if (stop && process.stopped && !process.done) break;
+    }
+    update_state(job);
+    return job.status();
+}
+
+Job* JobTable::wait_any() {
+    std::vector<pollfd> fds;
+    while (true) {
+        reap();
+        for (auto& job : jobs_) {
+            if (job.state == JobState::Done) return &job;
+        }
+
+        // Sleep until one of the running processes exits
+        fds.clear();
+        bool all_pollable = true;
+        for (const auto& job : jobs_) {
+            if (job.state != JobState::Running) continue;
+            for (const auto& process : job.processes) {
+                if (process.done) continue;
+                if (process.pidfd >= 0) {
+                    fds.push_back({process.pidfd, POLLIN, 0});
+                } else {
+                    all_pollable = false;
+                }
+            }
+        }
+        if (fds.empty() && all_pollable) return nullptr;
+        poll(fds.data(), fds.size(), all_pollable ? -1 : 100);
+    }
+}
+
+int JobTable::foreground(Job& job) {
+    std::cout << job.command << '\n';
+    std::cout.flush();
+
+    bool take_terminal = shell_options.interactive && isatty(STDIN_FILENO);
+    if (take_terminal) give_terminal_to(job.pgid);
+    if (job.state == JobState::Stopped) continue_job(job);
+    int status = wait(job, true);
+    if (take_terminal) give_terminal_to(getpgrp());
+
+    if (job.state == JobState::Stopped) {
+        std::cerr << '\n';
+        print_job(std::cerr, job);
+        job.reported = JobState::Stopped;
+        return 128 + SIGTSTP;
+    }
+    remove(job.id);
+    return status;
+}
+
+void JobTable::resume(Job& job) {
+    continue_job(job);
+    std::cout << '[' << job.id << "]+ " << job.command << " &\n";
+}
+
+Job* JobTable::find(std::string_view spec) {
+    if (jobs_.empty()) return nullptr;
+    if (spec.empty() || spec == "%%" || spec == "%+") return &jobs_.back();
+    if (spec == "%-") return jobs_.size() > 1 ? &jobs_[jobs_.size() - 2] : nullptr;
+
+    if (spec.starts_with('%')) spec.remove_prefix(1);
+    int id = 0;
+    auto [end, ec] = std::from_chars(spec.data(), spec.data() + spec.size(), id);
+    if (ec != std::errc() || end != spec.data() + spec.size()) return nullptr;
+    for (auto& job : jobs_) {
+        if (job.id == id) return &job;
+    }
+    return nullptr;
+}
+
+Job* JobTable::find_pid(pid_t pid) {
+    for (auto& job : jobs_) {
+        for (const auto& process : job.processes) {
+            if (process.pid == pid) return &job;
+        }
+    }
+    return nullptr;
+}
+
+void JobTable::remove(int id) {
+    auto it = std::find_if(jobs_.begin(), jobs_.end(), [id](const Job& job) { return job.id == id; });
+    if (it == jobs_.end()) return;
+    for (const auto& process : it->processes) {
+        if (process.pidfd >= 0) close(process.pidfd);
+    }
+    jobs_.erase(it);
+}
+
+void JobTable::print_job(std::ostream& out, const Job& job) const {
+    char mark = ' ';
+    if (&job == &jobs_.back()) {
+        mark = '+';
+    } else if (jobs_.size() > 1 && &job == &jobs_[jobs_.size() - 2]) {
+        mark = '-';
+    }
+
+    std::string state;
+    switch (job.state) {
+        case JobState::Running: state = "Running"; break;
+        case JobState::Stopped: state = "Stopped"; break;
+        case JobState::Done: state = job.status() == 0 ? "Done" : "Exit " + std::to_string(job.status()); break;
+    }
+    out << '[' << job.id << ']' << mark << "  " << std::left << std::setw(24) << state << std::right << job.command
+        << (job.state == JobState::Running ? " &" : "") << '\n';
+}
+
+void JobTable::print(std::ostream& out) {
+    reap();
+    for (auto& job : jobs_) {
+        print_job(out, job);
+        job.reported = job.state;
+    }
+    std::vector<int> done;
+    for (const auto& job : jobs_) {
+        if (job.state == JobState::Done) done.push_back(job.id);
+    }
+    for (int id : done) remove(id);
+}
+
+void JobTable::notify(std::ostream& out) {
+    if (jobs_.empty()) return;
+    reap();
+    std::vector<int> done;
+    for (auto& job : jobs_) {
+        if (job.state != job.reported && job.state != JobState::Running) {
+            print_job(out, job);
+            job.reported = job.state;
+        }
+        if (job.state == JobState::Done) done.push_back(job.id);
+    }
+    for (int id : done) remove(id);
+}
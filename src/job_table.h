@@ -0,0 +1,83 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+// One process of a job
+struct JobProcess {
+    pid_t pid;
+    int pidfd = -1;       // Becomes readable when the process exits; -1 if pidfds are unavailable
+    bool done = false;
+    bool stopped = false;
+    int status = 0;       // Exit status once done (128+n if killed by signal n)
+};
+
+enum class JobState { Running, Stopped, Done };
+
+// A background pipeline (or && / || chain), all in one process group
+struct Job {
+    int id;
+    pid_t pgid;
+    std::string command;
+    std::vector<JobProcess> processes;
+    JobState state = JobState::Running;
+    JobState reported = JobState::Running; // Last state announced to the user
+
+    // Exit status of the job: that of its last process
+    int status() const { return processes.empty() ? 0 : processes.back().status; }
+};
+
+/**
+ * Background jobs of the shell. Children are reaped through pidfds: a
+ * non-blocking sweep before each prompt, and poll() over every pidfd when
+ * waiting for whichever job finishes first.
+ */
+class JobTable {
+public:
+    ~JobTable();
+
+    // Track the processes of a newly started background job
+    Job& add(pid_t pgid, const std::vector<pid_t>& pids, std::string command);
+
+    // Collect exits and stops that have already happened, without blocking
+    void reap();
+
+    // Block until every process of the job has exited; with stop, also
+    // return as soon as one of them stops. Returns the job's exit status.
+    int wait(Job& job, bool stop = false);
+
+    // Block until some running job finishes. Returns nullptr if none is running.
+    Job* wait_any();
+
+    // Move a job to the foreground: give it the terminal (interactive only),
+    // continue it if stopped and wait for it. Returns its exit status.
+    int foreground(Job& job);
+
+    // Continue a stopped job in the background
+    void resume(Job& job);
+
+    // Look up %n, %+ / %% (current job), %- (previous job) or a bare job
+    // number; "" means the current job
+    Job* find(std::string_view spec);
+    Job* find_pid(pid_t pid);
+
+    void remove(int id);
+    bool empty() const { return jobs_.empty(); }
+
+    // `jobs` listing; finished jobs are forgotten once listed
+    void print(std::ostream& out);
+
+    // Announce jobs that finished or stopped since the last call, then
+    // forget the finished ones (run before each prompt)
+    void notify(std::ostream& out);
+
+private:
+    void print_job(std::ostream& out, const Job& job) const;
+
+    std::vector<Job> jobs_; // In job id order
+};
+
+// Global job table instance
+extern JobTable job_table;
@@ -0,0 +1,613 @@
+#include "line_parser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include "brace_expansion.h"
+#include "shell_options.h"
+#include "shell_utils.h"
+#include "trace.h"
+#include "variable_store.h"
+
+static bool is_blank(char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+}
+
+static bool is_name_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Parameters named by a single character: $?, $$, $!, $#, $@, $*
+static bool is_special_parameter(char c) {
+    return c == '?' || c == '$' || c == '!' || c == '#' || c == '@' || c == '*';
+}
+
+// Redirections other than descriptor duplication are followed by a file name
+static bool takes_target(RedirectType type) {
+    return type != RedirectType::None && type != RedirectType::StderrToStdout &&
+           type != RedirectType::StdoutToStderr;
+}
+
+// Whether a word has braces that expand. Throws std::runtime_error if they
+// would make more words than `set -o bracelimit` allows.
+static bool expands_braces(std::string_view text) {
+    BraceExpansion braces(text);
+    if (!braces.has_braces()) return false;
+    if (braces.size() > shell_options.brace_limit) {
+        throw std::runtime_error("brace expansion of `" + std::string(text) + "' makes more than " +
+                                 std::to_string(shell_options.brace_limit) + " words (set -o bracelimit)");
+    }
+    return true;
+}
+
+// Copy text into the arena so it lives as long as the AST
+static std::string_view intern(std::pmr::memory_resource& arena, std::string_view text) {
+    if (text.empty()) return {};
+    char* copy = static_cast<char*>(arena.allocate(text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
+    return {copy, text.size()};
+}
+
+Lexer::Lexer(std::string_view input, std::pmr::memory_resource& arena, LexMode mode)
+    : input_(input), mode_(mode), arena_(arena), scratch_(&arena), split_(&arena), substitutions_(&arena) {}
+
+Lexer::~Lexer() {
+    finish_process_substitutions(substitutions_);
+}
+
+void Lexer::take_process_substitutions(std::vector<ProcessSubstitution>& out) {
+    out.insert(out.end(), substitutions_.begin(), substitutions_.end());
+    substitutions_.clear();
+}
+
+std::string_view Lexer::intern(std::string_view text) {
+    return ::intern(arena_, text);
+}
+
+bool Lexer::next(Token& token) {
+    while (true) {
+        if (split_pos_ < split_.size()) {
+            std::string_view word = split_[split_pos_++];
+            token = {TokenKind::Word, {word, word.find_first_of("*?[") != std::string_view::npos}};
+            return true;
+        }
+        split_.clear();
+        split_pos_ = 0;
+
+        while (pos_ < input_.size() && is_blank(input_[pos_])) ++pos_;
+        token_start_ = pos_;
+        if (pos_ >= input_.size()) return false;
+        if (input_[pos_] == '#') {
+            pos_ = input_.size();
+            return false;
+        }
+        if ((input_[pos_] == '<' || input_[pos_] == '>') && input_.compare(pos_ + 1, 1, "(") == 0) {
+            return lex_process_substitution(token);
+        }
+        if (lex_operator(token)) return true;
+        // Words that come out empty ('' or an unset $NAME) are dropped. A word
+        // split by $(...) output is handed out from split_.
+        if (lex_word(token)) return true;
+    }
+}
+
+bool Lexer::lex_operator(Token& token) {
+    std::string_view rest = input_.substr(pos_);
+    auto emit = [&](TokenKind kind, size_t length, RedirectType type = RedirectType::None) {
+        token = {kind, {rest.substr(0, length), false}, type};
+        pos_ += length;
+        return true;
+    };
+
+    // An explicit descriptor (1> or 2>) only counts at the start of a word
+    char fd = '1';
+    size_t fd_length = 0;
+    if (rest.size() > 1 && (rest[0] == '1' || rest[0] == '2') && rest[1] == '>') {
+        fd = rest[0];
+        fd_length = 1;
+    }
+    std::string_view op = rest.substr(fd_length);
+    bool is_stderr = fd == '2';
+
+    if (op.starts_with(">&")) {
+        if (op.size() > 2 && (op[2] == '1' || op[2] == '2')) {
+            RedirectType type = op[2] == fd                  ? RedirectType::None
+                                : op[2] == '1'               ? RedirectType::StderrToStdout
+                                                             : RedirectType::StdoutToStderr;
+            return emit(TokenKind::Redirect, fd_length + 3, type);
+        }
+        // >&file is the same as &>file
+        if (fd_length == 0) return emit(TokenKind::Redirect, 2, RedirectType::Both);
+        throw std::runtime_error("syntax error near unexpected token `" + std::string(rest.substr(0, 3)) + "'");
+    }
+    if (op.starts_with(">>")) {
+        return emit(TokenKind::Redirect, fd_length + 2,
+                    is_stderr ? RedirectType::StderrAppend : RedirectType::StdoutAppend);
+    }
+    if (op.starts_with(">")) {
+        return emit(TokenKind::Redirect, fd_length + 1, is_stderr ? RedirectType::Stderr : RedirectType::Stdout);
+    }
+
+    if (rest.starts_with("&>>")) return emit(TokenKind::Redirect, 3, RedirectType::BothAppend);
+    if (rest.starts_with("&>")) return emit(TokenKind::Redirect, 2, RedirectType::Both);
+    if (rest.starts_with("&&")) return emit(TokenKind::AndIf, 2);
+    if (rest.starts_with("||")) return emit(TokenKind::OrIf, 2);
+    if (rest.starts_with("|")) return emit(TokenKind::Pipe, 1);
+    if (rest.starts_with(";")) return emit(TokenKind::Semicolon, 1);
+    if (rest.starts_with("&")) return emit(TokenKind::Ampersand, 1);
+    if (rest.starts_with("<<<") || rest.starts_with("<<-")) return emit(TokenKind::Redirect, 3, RedirectType::HereDocument);
+    if (rest.starts_with("<<")) return emit(TokenKind::Redirect, 2, RedirectType::HereDocument);
+    if (rest.starts_with("<")) return emit(TokenKind::Redirect, 1, RedirectType::Stdin);
+    return false;
+}
+
+// Run the $(...) at pos_ and append its output to the current word in
+// scratch_. Unless quoted, the output is split into fields as in other
+// shells: the first joins the text before the substitution, the last the
+// text after it, and finished words are queued in split_.
+void Lexer::lex_substitution(bool quoted) {
+    size_t start = skip_parenthesized();
+    std::string output = run_subcommand(std::string(input_.substr(start, pos_ - start)));
+    if (pos_ < input_.size()) ++pos_; // Closing parenthesis
+
+    if (quoted) {
+        scratch_ += output;
+        return;
+    }
+    constexpr std::string_view separators = " \t\n";
+    auto finish_word = [this] {
+        if (!scratch_.empty()) split_.push_back(intern(scratch_));
+        scratch_.clear();
+    };
+    std::string_view text(output);
+    size_t field_start = text.find_first_not_of(separators);
+    if (field_start != 0 && !text.empty()) finish_word(); // Leading separators end the word so far
+    while (field_start != std::string_view::npos) {
+        size_t field_end = text.find_first_of(separators, field_start);
+        scratch_ += text.substr(field_start, field_end - field_start);
+        if (field_end == std::string_view::npos) break;
+        finish_word();
+        field_start = text.find_first_not_of(separators, field_end);
+    }
+}
+
+// Start the <(...) or >(...) at pos_ and make the /dev/fd/N path that
+// replaces it the token, or in Defer mode a deferred word of its source
+bool Lexer::lex_process_substitution(Token& token) {
+    bool output = input_[pos_] == '<';
+    size_t start = skip_parenthesized();
+    if (pos_ >= input_.size()) throw std::runtime_error("syntax error: unterminated process substitution");
+    std::string_view command = input_.substr(start, pos_ - start);
+    ++pos_; // Closing parenthesis
+    if (mode_ == LexMode::Defer) {
+        token = {TokenKind::Word, {input_.substr(token_start_, pos_ - token_start_), false, false, true}};
+        return true;
+    }
+
+    ProcessSubstitution substitution = start_process_substitution(command, output);
+    std::string_view path = "/dev/null";
+    if (substitution.pid >= 0) {
+        substitutions_.push_back(substitution);
+        path = intern(process_substitution_path(substitution));
+    }
+    token = {TokenKind::Word, {path, false}};
+    return true;
+}
+
+// Move pos_ from the $(, <( or >( at it to the matching ) (or the end of the
+// input) and return where the command inside starts
+size_t Lexer::skip_parenthesized() {
+    pos_ += 2;
+    size_t start = pos_;
+    int depth = 1;
+    for (; pos_ < input_.size(); ++pos_) {
+        if (input_[pos_] == '(') {
+            ++depth;
+        } else if (input_[pos_] == ')' && --depth == 0) {
+            break;
+        }
+    }
+    return start;
+}
+
+// Whether the $ at pos_ starts a parameter rather than being a literal $
+bool Lexer::starts_variable() const {
+    return pos_ + 1 < input_.size() &&
+           (is_name_char(input_[pos_ + 1]) || input_[pos_ + 1] == '{' || is_special_parameter(input_[pos_ + 1]));
+}
+
+// Move past the $NAME, ${NAME}, $1 or $? (etc.) at pos_ and return the name,
+// or nullopt past just the $ of an unterminated ${
+std::optional<std::string_view> Lexer::lex_parameter() {
+    size_t name_start = pos_ + 1;
+    std::string_view name;
+    if (input_[name_start] == '{') {
+        size_t close = input_.find('}', name_start);
+        if (close == std::string_view::npos) {
+            ++pos_;
+            return std::nullopt;
+        }
+        name = input_.substr(name_start + 1, close - name_start - 1);
+        pos_ = close + 1;
+    } else if (is_special_parameter(input_[name_start]) || std::isdigit(static_cast<unsigned char>(input_[name_start]))) {
+        // $10 is $1 followed by 0, as in other shells
+        name = input_.substr(name_start, 1);
+        pos_ = name_start + 1;
+    } else {
+        size_t name_end = name_start;
+        while (name_end < input_.size() && is_name_char(input_[name_end])) ++name_end;
+        name = input_.substr(name_start, name_end - name_start);
+        pos_ = name_end;
+    }
+    return name;
+}
+
+// Append the value of the parameter at pos_ to the current word
+void Lexer::expand_variable() {
+    std::optional<std::string_view> name = lex_parameter();
+    if (!name) {
+        scratch_ += '$';
+    } else if (std::optional<std::string_view> value = variable_store.get(*name)) {
+        scratch_ += *value;
+    }
+}
+
+bool Lexer::lex_word(Token& token) {
+    enum class Quote { None, Single, Double } quote = Quote::None;
+    size_t start = pos_;
+    bool rewritten = false; // The word differs from the input and is built in scratch_
+    bool glob = false;
+    bool brace = false;     // Saw an unquoted {
+    size_t brace_chars = 0; // Unquoted {, } and , copied to the word
+    bool deferred = false;  // Skipped expansions that are left for later
+
+    auto rewrite = [&] {
+        if (!rewritten) {
+            scratch_.assign(input_.substr(start, pos_ - start));
+            rewritten = true;
+        }
+    };
+
+    // Expansions are skipped in Defer mode. $(...) output is not split in
+    // the value of NAME=value, which stays one word.
+    auto expand_substitution = [&](bool quoted) {
+        if (mode_ == LexMode::Defer) {
+            skip_parenthesized();
+            if (pos_ < input_.size()) ++pos_;
+            deferred = true;
+        } else {
+            lex_substitution(quoted);
+        }
+    };
+    auto expand_parameter = [&] {
+        if (mode_ == LexMode::Defer) {
+            lex_parameter();
+            deferred = true;
+        } else {
+            expand_variable();
+        }
+    };
+    size_t name_end = start;
+    while (name_end < input_.size() && is_name_char(input_[name_end])) ++name_end;
+    bool unsplit = mode_ == LexMode::ExpandOneWord ||
+                   (name_end > start && !std::isdigit(static_cast<unsigned char>(input_[start])) &&
+                    name_end < input_.size() && input_[name_end] == '=');
+
+    while (pos_ < input_.size()) {
+        char c = input_[pos_];
+        bool has_next = pos_ + 1 < input_.size();
+
+        if (quote == Quote::None) {
+            if (is_blank(c) || c == ';' || c == '&' || c == '|' || c == '<' || c == '>') {
+                break;
+            }
+            if (input_.compare(pos_, 2, "$(") == 0) {
+                rewrite();
+                size_t from = scratch_.size();
+                size_t fields = split_.size();
+                expand_substitution(unsplit);
+                // The output's *, ? and [ are unquoted too; after a split only its last field is left here
+                if (split_.size() != fields) from = 0;
+                if (!unsplit && scratch_.find_first_of("*?[", from) != std::string::npos) glob = true;
+            } else if (c == '\'' || c == '"') {
+                rewrite();
+                quote = c == '\'' ? Quote::Single : Quote::Double;
+                ++pos_;
+            } else if (c == '\\' && has_next) {
+                rewrite();
+                scratch_ += input_[pos_ + 1];
+                pos_ += 2;
+            } else if (c == '$' && starts_variable()) {
+                rewrite();
+                size_t from = scratch_.size();
+                expand_parameter();
+                if (!unsplit && scratch_.find_first_of("*?[", from) != std::string::npos) glob = true;
+            } else {
+                if (c == '*' || c == '?' || c == '[') glob = true;
+                if (c == '{') brace = true;
+                if (c == '{' || c == '}' || c == ',') ++brace_chars;
+                if (rewritten) scratch_ += c;
+                ++pos_;
+            }
+        } else if (quote == Quote::Single) {
+            if (c == '\\' && has_next && input_[pos_ + 1] == '\'') {
+                scratch_ += '\'';
+                pos_ += 2;
+            } else {
+                if (c == '\'') {
+                    quote = Quote::None;
+                } else {
+                    scratch_ += c;
+                }
+                ++pos_;
+            }
+        } else {
+            if (input_.compare(pos_, 2, "$(") == 0) {
+                expand_substitution(true);
+            } else if (c == '\\' && has_next) {
+                char next = input_[pos_ + 1];
+                if (next == '\\' || next == '"' || next == '$') {
+                    scratch_ += next;
+                    pos_ += 2;
+                } else if (next == 'n' || next == '\n') {
+                    scratch_ += '\n';
+                    pos_ += 2;
+                } else {
+                    scratch_ += '\\';
+                    ++pos_;
+                }
+            } else if (c == '$' && starts_variable()) {
+                expand_parameter();
+            } else {
+                if (c == '"') {
+                    quote = Quote::None;
+                } else {
+                    scratch_ += c;
+                }
+                ++pos_;
+            }
+        }
+    }
+
+    if (deferred) {
+        token = {TokenKind::Word, {input_.substr(start, pos_ - start), false, false, true}};
+        return true;
+    }
+    std::string_view text = rewritten ? intern(scratch_) : input_.substr(start, pos_ - start);
+    if (!split_.empty()) {
+        // $(...) output split the word: its pieces are all handed out by next()
+        if (!text.empty()) split_.push_back(text);
+        return false;
+    }
+    if (text.empty()) return false;
+    // Braces only expand when none of them came from quotes, escapes or
+    // substitutions, as those would have to stay literal
+    if (brace) {
+        size_t specials = static_cast<size_t>(std::count_if(text.begin(), text.end(), [](char c) {
+            return c == '{' || c == '}' || c == ',';
+        }));
+        brace = specials == brace_chars && expands_braces(text);
+    }
+    token = {TokenKind::Word, {text, glob, brace}};
+    return true;
+}
+
+std::string_view Lexer::expand_here_document() {
+    scratch_.clear();
+    while (pos_ < input_.size()) {
+        char c = input_[pos_];
+        if (c == '\\' && pos_ + 1 < input_.size()) {
+            char next = input_[pos_ + 1];
+            if (next == '$' || next == '`' || next == '\\') {
+                scratch_ += next;
+                pos_ += 2;
+                continue;
+            }
+            if (next == '\n') { // Line continuation
+                pos_ += 2;
+                continue;
+            }
+        }
+        if (input_.compare(pos_, 2, "$(") == 0) {
+            lex_substitution(true);
+        } else if (c == '$' && starts_variable()) {
+            expand_variable();
+        } else {
+            scratch_ += c;
+            ++pos_;
+        }
+    }
+    return intern(scratch_);
+}
+
+LineParser::LineParser(std::string_view input, std::pmr::memory_resource& arena, const LineSource* more_lines)
+    : input_(input), lexer_(input, arena, LexMode::Defer), arena_(arena), more_lines_(more_lines) {}
+
+const Token* LineParser::peek() {
+    if (!has_peek_) {
+        if (!lexer_.next(peek_)) return nullptr;
+        has_peek_ = true;
+    }
+    return &peek_;
+}
+
+void LineParser::syntax_error() {
+    const Token* token = peek();
+    std::string near = token ? std::string(token->word.text) : "newline";
+    throw std::runtime_error("syntax error near unexpected token `" + near + "'");
+}
+
+std::optional<AndOrList> LineParser::next_list() {
+    TraceSpan span("parse");
+    if (!peek()) return std::nullopt;
+
+    AndOrList list{std::pmr::vector<AndOrItem>(&arena_)};
+    parse_list(list);
+    return list;
+}
+
+void LineParser::parse_list(AndOrList& list) {
+    if (parse_time_prefix(list)) return;
+    size_t start = lexer_.token_start();
+    ListOperator op = ListOperator::None;
+    while (true) {
+        list.items.push_back({op, parse_pipeline()});
+        list.text = input_.substr(start, consumed_end_ - start);
+        const Token* token = peek();
+        if (!token) break;
+        if (token->kind == TokenKind::Semicolon || token->kind == TokenKind::Ampersand) {
+            list.background = token->kind == TokenKind::Ampersand;
+            consume();
+            break;
+        }
+        if (token->kind == TokenKind::AndIf) {
+            op = ListOperator::And;
+        } else if (token->kind == TokenKind::OrIf) {
+            op = ListOperator::Or;
+        } else {
+            syntax_error();
+        }
+        consume();
+    }
+}
+
+// Consume a leading `time` or `time -v`. Returns true if nothing follows it,
+// in which case the (empty) list is complete.
+bool LineParser::parse_time_prefix(AndOrList& list) {
+    const Token* token = peek();
+    if (token->kind != TokenKind::Word || token->word.text != "time") return false;
+    consume();
+    list.time = TimeMode::Summary;
+    token = peek();
+    if (token && token->kind == TokenKind::Word && token->word.text == "-v") {
+        list.time = TimeMode::Verbose;
+        consume();
+        token = peek();
+    }
+    if (!token) return true;
+    if (token->kind == TokenKind::Semicolon || token->kind == TokenKind::Ampersand) {
+        list.background = token->kind == TokenKind::Ampersand;
+        consume();
+        return true;
+    }
+    return false;
+}
+
+Pipeline LineParser::parse_pipeline() {
+    Pipeline pipeline{std::pmr::vector<SimpleCommand>(&arena_)};
+    pipeline.commands.push_back(parse_simple_command());
+    while (const Token* token = peek()) {
+        if (token->kind != TokenKind::Pipe) break;
+        consume();
+        pipeline.commands.push_back(parse_simple_command());
+    }
+    return pipeline;
+}
+
+SimpleCommand LineParser::parse_simple_command() {
+    SimpleCommand command{std::pmr::vector<Word>(&arena_), std::pmr::vector<Redirect>(&arena_)};
+    while (const Token* token = peek()) {
+        if (token->kind == TokenKind::Word) {
+            command.words.push_back(token->word);
+            consume();
+        } else if (token->kind == TokenKind::Redirect) {
+            RedirectType type = token->redirect;
+            std::string_view op = token->word.text;
+            consume();
+            if (type == RedirectType::HereDocument) {
+                command.redirects.push_back(parse_here_document(op));
+            } else if (takes_target(type)) {
+                token = peek();
+                if (!token || token->kind != TokenKind::Word) syntax_error();
+                Redirect::Expansion expansion = token->word.deferred ? Redirect::Expansion::Word : Redirect::Expansion::None;
+                command.redirects.push_back({type, token->word.text, expansion});
+                consume();
+            } else if (type != RedirectType::None) {
+                command.redirects.push_back({type, {}});
+            }
+        } else {
+            break;
+        }
+    }
+    if (command.words.empty() && command.redirects.empty()) syntax_error();
+    return command;
+}
+
+// The text fed to stdin by <<< word, or by << / <<- and the body lines that
+// follow up to the delimiter. A quoted delimiter leaves the body unexpanded,
+// and <<- strips leading tabs from the body and the delimiter line.
+Redirect LineParser::parse_here_document(std::string_view op) {
+    constexpr RedirectType type = RedirectType::HereDocument;
+    const Token* token = peek();
+    if (!token || token->kind != TokenKind::Word) syntax_error();
+    std::string_view word = token->word.text;
+    std::string_view source = input_.substr(lexer_.token_start(), lexer_.token_end() - lexer_.token_start());
+    bool quoted = source.find_first_of("'\"\\") != std::string_view::npos;
+    bool deferred = token->word.deferred;
+    consume();
+
+    if (op == "<<<") {
+        if (deferred) return {type, word, Redirect::Expansion::HereString};
+        return {type, intern(arena_, std::string(word) + '\n')};
+    }
+
+    bool strip_tabs = op == "<<-";
+    std::string body, line;
+    bool terminated = false;
+    while (more_lines_ && (*more_lines_)(line)) {
+        std::string_view text(line);
+        if (strip_tabs) text.remove_prefix(std::min(text.find_first_not_of('\t'), text.size()));
+        if (text == word) {
+            terminated = true;
+            break;
+        }
+        body.append(text);
+        body += '\n';
+    }
+    if (!terminated) {
+        std::cerr << "shell: warning: here-document delimited by end-of-file (wanted `" << word << "')" << std::endl;
+    }
+    if (quoted || body.find_first_of("$\\") == std::string::npos) return {type, intern(arena_, body)};
+    return {type, intern(arena_, body), Redirect::Expansion::HereDocument};
+}
+
+CommandLine parse_line(std::string_view input, std::pmr::memory_resource& arena) {
+    CommandLine line{std::pmr::vector<AndOrList>(&arena)};
+    LineParser parser(input, arena);
+    while (std::optional<AndOrList> list = parser.next_list()) {
+        line.lists.push_back(std::move(*list));
+    }
+    return line;
+}
+
+void expand_word(const Word& word, std::pmr::memory_resource& arena, std::pmr::vector<Word>& out,
+                 std::vector<ProcessSubstitution>& substitutions) {
+    Lexer lexer(word.text, arena);
+    Token token;
+    while (lexer.next(token)) out.push_back(token.word);
+    lexer.take_process_substitutions(substitutions);
+}
+
+std::string_view expand_redirect_target(const Redirect& redirect, std::pmr::memory_resource& arena,
+                                        std::vector<ProcessSubstitution>& substitutions) {
+    switch (redirect.expansion) {
+    case Redirect::Expansion::None:
+        return redirect.target;
+    case Redirect::Expansion::Word:
+    case Redirect::Expansion::HereString: {
+        // One word with nothing split off or dropped, as in other shells
+        Lexer lexer(redirect.target, arena, LexMode::ExpandOneWord);
+        Token token;
+        std::string_view text = lexer.next(token) ? token.word.text : std::string_view();
+        lexer.take_process_substitutions(substitutions);
+        if (redirect.expansion == Redirect::Expansion::Word) return text;
+        return intern(arena, std::string(text) + '\n');
+    }
+    case Redirect::Expansion::HereDocument: {
+        Lexer lexer(redirect.target, arena);
+        return lexer.expand_here_document();
+    }
+    }
+    return redirect.target;
+}
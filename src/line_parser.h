@@ -0,0 +1,188 @@
+#pragma once
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "command_parser.h"
+#include "line_reader.h"
+#include "process_substitution.h"
+
+// Command line AST. Word text is a view into the input line when the word
+// needed no rewriting, otherwise into the line's arena; both must outlive
+// the AST. Vectors allocate from the arena too, so building one costs a few
+// bumps of a pointer instead of a heap allocation per token.
+// Parameter, command and process substitutions are left in the source text
+// and done when the command is about to run, so they see the effects of the
+// commands before it and never run for a command that is skipped.
+
+// A word after quote removal, or its source text if it has expansions left
+struct Word {
+    std::string_view text;
+    bool glob = false;     // Has an unquoted *, ? or [ and is subject to pathname expansion
+    bool brace = false;    // Has unquoted braces that expand (see BraceExpansion)
+    bool deferred = false; // text is source with $ expansions or a <(...) to do (see expand_word)
+};
+
+// A redirection attached to a simple command
+struct Redirect {
+    // Expansions still to do in the target, which is source text until then
+    enum class Expansion { None, Word, HereString, HereDocument };
+
+    RedirectType type;
+    std::string_view target; // Empty for descriptor duplication (2>&1, >&2)
+    Expansion expansion = Expansion::None;
+};
+
+struct SimpleCommand {
+    std::pmr::vector<Word> words;
+    std::pmr::vector<Redirect> redirects; // In the order written
+};
+
+struct Pipeline {
+    std::pmr::vector<SimpleCommand> commands;
+};
+
+// How a pipeline is joined to the one before it in an and/or list
+enum class ListOperator { None, And, Or };
+
+struct AndOrItem {
+    ListOperator op;
+    Pipeline pipeline;
+};
+
+// Whether an and/or list was prefixed with the `time` keyword
+enum class TimeMode { None, Summary, Verbose };
+
+// Pipelines joined by && and ||
+struct AndOrList {
+    std::pmr::vector<AndOrItem> items;
+    std::string_view text{}; // Source text, without `time` and the terminating ; or &
+    bool background = false; // Ended by &
+    TimeMode time = TimeMode::None; // `time` prints a summary, `time -v` adds every stage
+};
+
+// A whole line: and/or lists separated by ';' or '&'
+struct CommandLine {
+    std::pmr::vector<AndOrList> lists;
+};
+
+enum class TokenKind { Word, Pipe, AndIf, OrIf, Semicolon, Ampersand, Redirect };
+
+struct Token {
+    TokenKind kind;
+    Word word;                                 // Word: the word; otherwise the operator as written
+    RedirectType redirect = RedirectType::None; // Redirect: what it does
+};
+
+// What a Lexer does with $NAME, ${NAME}, $1, $?, $(...), <(...) and >(...)
+enum class LexMode {
+    Expand,        // Expand them, splitting unquoted $(...) output into words
+    ExpandOneWord, // Expand them without splitting, as in a redirection target
+    Defer,         // Leave them in the source text of words marked deferred
+};
+
+/**
+ * Single-pass lexer. Splits a line into words and operators, doing quote
+ * removal, parameter expansion from the variable store and $(...)
+ * substitution as it goes (see LexMode). <(...) and >(...) start their
+ * command and become a /dev/fd/N word; the lexer finishes any not taken by
+ * its caller.
+ * Operators are only recognised outside quotes, and an unquoted # at the
+ * start of a word comments out the rest of the line. Words with braces to
+ * expand are marked and checked against `set -o bracelimit` here; their
+ * expansion is generated later, one word at a time.
+ * The input can instead be expanded whole as a here-document body.
+ */
+class Lexer {
+public:
+    Lexer(std::string_view input, std::pmr::memory_resource& arena, LexMode mode = LexMode::Expand);
+    ~Lexer();
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+
+    // Read the next token; false at end of input
+    bool next(Token& token);
+
+    // Source range of the token last read
+    size_t token_start() const { return token_start_; }
+    size_t token_end() const { return pos_; }
+
+    // Expand the whole input as a here-document body: parameters, $(...) and
+    // backslash escapes of $, ` and \ as inside double quotes, but quotes
+    // themselves are ordinary characters
+    std::string_view expand_here_document();
+
+    // Move the process substitutions started so far to out
+    void take_process_substitutions(std::vector<ProcessSubstitution>& out);
+
+private:
+    bool lex_operator(Token& token);
+    bool lex_word(Token& token);
+    void lex_substitution(bool quoted);
+    bool lex_process_substitution(Token& token);
+    size_t skip_parenthesized();
+    bool starts_variable() const;
+    std::optional<std::string_view> lex_parameter();
+    void expand_variable();
+    std::string_view intern(std::string_view text);
+
+    std::string_view input_;
+    LexMode mode_;
+    size_t pos_ = 0;
+    size_t token_start_ = 0;
+    std::pmr::memory_resource& arena_;
+    std::pmr::string scratch_;               // Word being rewritten
+    std::pmr::vector<std::string_view> split_; // Unquoted substitution output still to hand out
+    size_t split_pos_ = 0;
+    std::pmr::vector<ProcessSubstitution> substitutions_; // Started but not yet taken
+};
+
+/**
+ * Recursive-descent parser over a Lexer that defers expansions. Lists are
+ * produced one at a time so a caller can run each before the next is lexed.
+ * Here-document bodies are read from more_lines when their << is parsed;
+ * without it they are empty.
+ */
+class LineParser {
+public:
+    LineParser(std::string_view input, std::pmr::memory_resource& arena, const LineSource* more_lines = nullptr);
+
+    // Parse the next and/or list; nullopt at end of input.
+    // Throws std::runtime_error on a syntax error.
+    std::optional<AndOrList> next_list();
+
+private:
+    void parse_list(AndOrList& list);
+    bool parse_time_prefix(AndOrList& list);
+    Pipeline parse_pipeline();
+    SimpleCommand parse_simple_command();
+    Redirect parse_here_document(std::string_view op);
+    const Token* peek();
+    void consume() {
+        has_peek_ = false;
+        consumed_end_ = lexer_.token_end();
+    }
+    [[noreturn]] void syntax_error();
+
+    std::string_view input_;
+    Lexer lexer_;
+    std::pmr::memory_resource& arena_;
+    const LineSource* more_lines_;
+    Token peek_{};
+    bool has_peek_ = false;
+    size_t consumed_end_ = 0; // End of the last token consumed
+};
+
+// Parse a whole line up front. Throws std::runtime_error on a syntax error.
+CommandLine parse_line(std::string_view input, std::pmr::memory_resource& arena);
+
+// Do the expansions of a deferred word, appending the words it stands for
+// to out and the process substitutions it started to substitutions. Throws
+// std::runtime_error as the parser does for the same word.
+void expand_word(const Word& word, std::pmr::memory_resource& arena, std::pmr::vector<Word>& out,
+                 std::vector<ProcessSubstitution>& substitutions);
+
+// The target of a redirection with its deferred expansions done
+std::string_view expand_redirect_target(const Redirect& redirect, std::pmr::memory_resource& arena,
+                                        std::vector<ProcessSubstitution>& substitutions);
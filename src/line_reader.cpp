@@ -0,0 +1,68 @@
+#include "line_reader.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+BufferedLineReader::BufferedLineReader(int fd, size_t capacity, bool shared)
+    : fd_(fd), buffer_(capacity > 0 ? capacity : 1) {
+    if (shared) {
+        seekable_ = lseek(fd, 0, SEEK_CUR) >= 0;
+        byte_wise_ = !seekable_;
+    }
+}
+
+void BufferedLineReader::release() {
+    if (!seekable_ || start_ == end_) return;
+    if (lseek(fd_, -static_cast<off_t>(end_ - start_), SEEK_CUR) < 0) return;
+    end_ = start_;
+    eof_ = false;
+}
+
+bool BufferedLineReader::fill() {
+    if (start_ > 0) {
+        std::memmove(buffer_.data(), buffer_.data() + start_, end_ - start_);
+        end_ -= start_;
+        start_ = 0;
+    }
+    // A line longer than the buffer: grow it
+    if (end_ == buffer_.size()) {
+        buffer_.resize(buffer_.size() * 2);
+    }
+
+    while (true) {
+        size_t wanted = byte_wise_ ? 1 : buffer_.size() - end_;
+        ssize_t n = read(fd_, buffer_.data() + end_, wanted);
+        if (n > 0) {
+            end_ += n;
+            return true;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        eof_ = true;
+        return false;
+    }
+}
+
+bool BufferedLineReader::next_line(std::string_view& line) {
+    size_t scanned = start_;
+    while (true) {
+        const char* data = buffer_.data();
+        const void* newline = std::memchr(data + scanned, '\n', end_ - scanned);
+        if (newline) {
+            size_t pos = static_cast<const char*>(newline) - data;
+            line = std::string_view(data + start_, pos - start_);
+            start_ = pos + 1;
+            return true;
+        }
+
+        size_t searched = end_ - start_;
+        if (eof_ || !fill()) {
+            // Last line without a trailing newline
+            if (start_ == end_) return false;
+            line = std::string_view(buffer_.data() + start_, end_ - start_);
+            start_ = end_;
+            return true;
+        }
+        // fill() moved the unconsumed bytes to the front; skip the part already searched
+        scanned = start_ + searched;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Supplies the next line of input (without its '\n'); false at end of input
+using LineSource = std::function<bool(std::string& line)>;
+
+/**
+ * Reads lines from a file descriptor through a large block buffer, for
+ * non-interactive input. Each read() pulls in as much as fits, so a script
+ * costs roughly one syscall per buffer instead of one per line (or, as with
+ * readline on a pipe, one per byte).
+ *
+ * A shared fd is also the stdin of the commands the shell runs, so they must
+ * find it positioned just after the current line: seekable input is still
+ * read in blocks and rewound by release(), a pipe is read one byte at a time.
+ */
+class BufferedLineReader {
+public:
+    explicit BufferedLineReader(int fd, size_t capacity = 256 * 1024, bool shared = false);
+
+    // Next line without its '\n', valid until the next call; false at end of input
+    bool next_line(std::string_view& line);
+
+    // Give a shared fd back the input read past the current line
+    void release();
+
+private:
+    int fd_;
+    std::vector<char> buffer_;
+    size_t start_ = 0; // First unconsumed byte
+    size_t end_ = 0;   // One past the last byte read
+    bool eof_ = false;
+    bool seekable_ = false; // Shared and seekable: rewind in release()
+    bool byte_wise_ = false; // Shared pipe: never read past a newline
+
+    // Make room and read more input; false once nothing more can be read
+    bool fill();
+};
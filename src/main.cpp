@@ -1,29 +1,62 @@
+#include <algorithm>
 #include <iostream>
 #include <readline/history.h>
 #include <readline/readline.h>
 #include <string>
 #include <vector>
+#include <fcntl.h>
 #include <unistd.h>
 #include "command_parser.h"
 #include "completion.h"
+#include "history_store.h"
+#include "job_table.h"
+#include "output_buffer.h"
 #include "pipe_utils.h"
 #include "redirect_guard.h"
+#include "script_runner.h"
+#include "shell_options.h"
 #include "shell_utils.h"
+#include "state_snapshot.h"
+#include "trace.h"
+#include "variable_store.h"
 
-int main() {
+// History entries readline holds for editing and Ctrl-R; the rest stay on disk
+static constexpr size_t readline_history_size = 1000;
+
+// Here-document bodies typed after the command, at a "> " prompt
+static bool read_continuation_line(std::string& line) {
+    char* text = readline("> ");
+    if (!text) return false;
+    line = text;
+    free(text);
+    return true;
+}
+
+static void run_interactive() {
     // Configure readline to use our custom completer
     rl_attempted_completion_function = shell_completer;
-    
-    // Disable readline in non-interactive environments (like CI)
-    if (!isatty(STDIN_FILENO)) {
-        rl_outstream = stderr;
+    shell_options.interactive = true;
+
+    // Commands persist in a history file shared with other shells; readline
+    // keeps only the newest in memory for line editing
+    stifle_history(static_cast<int>(readline_history_size));
+    std::string history_path = default_history_path();
+    if (!history_path.empty() && history_store.open(history_path, shell_options.history_size)) {
+        for (const HistoryEntry& entry : history_store.recent(readline_history_size)) {
+            add_history(entry.line.c_str());
+        }
     }
 
-    std::cout << std::unitbuf;
-    std::cerr << std::unitbuf;
+    // SHELL_SNAPSHOT=file: start from the state saved there, and save it again on exit.
+    // Its history is only needed without the history file.
+    std::string snapshot_path = state_snapshot_path();
+    if (!snapshot_path.empty()) load_state_snapshot(snapshot_path, !history_store.is_open());
 
     // Main shell loop: read, parse, and execute commands
     while (true) {
+        // Report background jobs that finished or stopped since the last prompt
+        job_table.notify(std::cerr);
+
         // Show only the current folder name in the prompt
         char cwd[4096];
         std::string prompt = "$ ";
@@ -52,14 +85,64 @@ int main() {
         }
 
         add_history(trimmed_input.c_str());
+        history_store.append(trimmed_input);
 
-        // Parse and execute command sequence (handles ;, &&, ||)
-        std::vector<CommandSequence> sequences = parse_command_sequence(trimmed_input);
-        bool should_exit = execute_command_sequence(sequences);
-
-        if (should_exit) {
+        if (execute_line(trimmed_input, read_continuation_line)) {
             break;
         }
     }
-    return 0;
-}
\ No newline at end of file
+
+    if (!snapshot_path.empty() && !save_state_snapshot(snapshot_path)) {
+        std::cerr << "shell: " << snapshot_path << ": cannot write snapshot" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // SHELL_TRACE=file records spans of the shell's own work, written at exit
+    start_trace_from_env();
+
+    // Batch shells only read the snapshot; interactive ones also write it back
+    if (!isatty(STDIN_FILENO) || argc > 1) {
+        std::string snapshot_path = state_snapshot_path();
+        if (!snapshot_path.empty()) load_state_snapshot(snapshot_path, false);
+    }
+
+    // Builtin output is batched and written once per command (or when the
+    // buffer fills); stderr stays unbuffered and flushes stdout before writing
+    std::cout.rdbuf(&stdout_buffer);
+    std::cerr << std::unitbuf;
+
+    // shell -c 'commands'
+    if (argc > 1 && std::string(argv[1]) == "-c") {
+        if (argc < 3) {
+            std::cerr << "shell: -c: option requires an argument" << std::endl;
+            return 2;
+        }
+        // shell -c 'commands' [name [args...]]
+        std::vector<std::string> args(argv + std::min(argc, 4), argv + argc);
+        variable_store.set_positional(argc > 3 ? argv[3] : argv[0], std::move(args));
+        return run_command_string(argv[2]);
+    }
+
+    // shell script.sh
+    if (argc > 1) {
+        int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "shell: " << argv[1] << ": No such file or directory" << std::endl;
+            return 127;
+        }
+        variable_store.set_positional(argv[1], std::vector<std::string>(argv + 2, argv + argc));
+        int status = run_script(fd);
+        close(fd);
+        return status;
+    }
+
+    // Piped or redirected stdin: batch mode without readline or a prompt
+    if (!isatty(STDIN_FILENO)) {
+        return run_script(STDIN_FILENO);
+    }
+
+    variable_store.set_positional(argv[0], {});
+    run_interactive();
+    return last_exit_status;
+}
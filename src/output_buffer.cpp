@@ -0,0 +1,85 @@
+#include "output_buffer.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Buffer main() installs on std::cout in every mode. Never destroyed, so
+// std::cout can still flush through it while the program exits.
+FdOutputBuffer& stdout_buffer = *new FdOutputBuffer(STDOUT_FILENO);
+
+FdOutputBuffer::FdOutputBuffer(int fd, size_t capacity) : fd_(fd), buffer_(capacity) {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+FdOutputBuffer::~FdOutputBuffer() {
+    flush_buffer();
+}
+
+void FdOutputBuffer::write_all(iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd_, iov, count);
+        ++write_calls_;
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            // Nowhere to report a failing stdout; drop the data so the stream stays usable
+            return;
+        }
+        // Skip fully written iovecs and advance into a partially written one
+        while (count > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+void FdOutputBuffer::flush_buffer() {
+    size_t pending = pptr() - pbase();
+    if (pending > 0) {
+        iovec iov{pbase(), pending};
+        write_all(&iov, 1);
+    }
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+FdOutputBuffer::int_type FdOutputBuffer::overflow(int_type ch) {
+    flush_buffer();
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+    if (buffer_.empty()) {
+        char c = traits_type::to_char_type(ch);
+        iovec iov{&c, 1};
+        write_all(&iov, 1);
+    } else {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return ch;
+}
+
+std::streamsize FdOutputBuffer::xsputn(const char* s, std::streamsize n) {
+    size_t count = static_cast<size_t>(n);
+    size_t free_space = epptr() - pptr();
+    if (count <= free_space) {
+        std::memcpy(pptr(), s, count);
+        pbump(static_cast<int>(count));
+        return n;
+    }
+
+    // Too big for the buffer: send buffered bytes and the new data in one writev()
+    iovec iov[2] = {{pbase(), static_cast<size_t>(pptr() - pbase())}, {const_cast<char*>(s), count}};
+    write_all(iov[0].iov_len > 0 ? iov : iov + 1, iov[0].iov_len > 0 ? 2 : 1);
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return n;
+}
+
+int FdOutputBuffer::sync() {
+    flush_buffer();
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <streambuf>
+#include <vector>
+
+struct iovec;
+
+/**
+ * A std::streambuf that batches output for a file descriptor. Bytes are only
+ * written when the buffer fills or the stream is flushed, and a write larger
+ * than the free space goes out together with the buffered bytes in a single
+ * writev(). The descriptor is looked up at write time, so output follows
+ * whatever RedirectGuard has dup2'd onto it as long as the stream is flushed
+ * before the redirection changes.
+ */
+class FdOutputBuffer : public std::streambuf {
+public:
+    explicit FdOutputBuffer(int fd, size_t capacity = 64 * 1024);
+    ~FdOutputBuffer() override;
+
+    FdOutputBuffer(const FdOutputBuffer&) = delete;
+    FdOutputBuffer& operator=(const FdOutputBuffer&) = delete;
+
+    // Number of write()/writev() calls made so far
+    size_t write_calls() const { return write_calls_; }
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+
+private:
+    int fd_;
+    std::vector<char> buffer_;
+    size_t write_calls_ = 0;
+
+    // Write every iovec completely, retrying short writes
+    void write_all(iovec* iov, int count);
+    void flush_buffer();
+};
+
+// Buffer main() installs on std::cout in every mode (prompt, -c, script, piped)
+extern FdOutputBuffer& stdout_buffer;
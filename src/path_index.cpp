@@ -0,0 +1,100 @@
+#include "path_index.h"
+#include <cstdlib>
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dir_scanner.h"
+
+// Global PATH command index instance
+PathCommandIndex path_command_index;
+
+static bool same_time(const timespec& a, const timespec& b) {
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+bool PathCommandIndex::refresh_directory(DirListing& listing) {
+    struct stat st;
+    if (stat(listing.dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        bool changed = listing.exists;
+        listing.exists = false;
+        listing.names.clear();
+        return changed;
+    }
+
+    // Directory timestamps are coarse: an mtime that is not clearly older than
+    // the last scan could hide a later change in the same tick, so rescan it.
+    bool racy = st.st_mtim.tv_sec >= listing.scanned_at.tv_sec - 1;
+    if (listing.exists && !racy && listing.device == st.st_dev && listing.inode == st.st_ino &&
+        same_time(listing.mtime, st.st_mtim)) {
+        return false;
+    }
+
+    listing.exists = true;
+    listing.device = st.st_dev;
+    listing.inode = st.st_ino;
+    listing.mtime = st.st_mtim;
+    clock_gettime(CLOCK_REALTIME, &listing.scanned_at);
+    listing.names.clear();
+
+    DirScanner scanner(listing.dir.c_str());
+    DirEntry entry;
+    while (scanner.next(entry)) {
+        if (scanner.type_of(entry, true) == DT_REG && faccessat(scanner.fd(), entry.name.data(), X_OK, 0) == 0) {
+            listing.names.emplace_back(entry.name);
+        }
+    }
+    return true;
+}
+
+void PathCommandIndex::refresh() {
+    const char* path_env = std::getenv("PATH");
+    bool has_path = path_env != nullptr;
+    bool changed = false;
+
+    if (has_path != has_indexed_path || (has_path && indexed_path != path_env)) {
+        // Rebuild the directory list, keeping listings of directories still in $PATH
+        std::vector<DirListing> new_dirs;
+        std::string_view remaining = has_path ? path_env : "";
+        while (has_path) {
+            size_t colon = remaining.find(':');
+            std::string dir(remaining.substr(0, colon));
+            if (dir.empty()) dir = ".";
+
+            auto it = std::find_if(dirs.begin(), dirs.end(), [&](const DirListing& d) { return d.dir == dir; });
+            if (it != dirs.end()) {
+                new_dirs.push_back(std::move(*it));
+            } else {
+                new_dirs.push_back(DirListing{dir});
+            }
+
+            if (colon == std::string_view::npos) break;
+            remaining.remove_prefix(colon + 1);
+        }
+        dirs = std::move(new_dirs);
+        has_indexed_path = has_path;
+        indexed_path = has_path ? path_env : "";
+        changed = true;
+    }
+
+    for (auto& listing : dirs) {
+        if (refresh_directory(listing)) changed = true;
+    }
+    if (!changed) return;
+
+    sorted_names.clear();
+    for (const auto& listing : dirs) {
+        sorted_names.insert(sorted_names.end(), listing.names.begin(), listing.names.end());
+    }
+    std::sort(sorted_names.begin(), sorted_names.end());
+    sorted_names.erase(std::unique(sorted_names.begin(), sorted_names.end()), sorted_names.end());
+}
+
+void PathCommandIndex::add_matching(std::string_view prefix, std::set<std::string>& out) const {
+    auto it = std::lower_bound(sorted_names.begin(), sorted_names.end(), prefix,
+                               [](const std::string& name, std::string_view p) { return name < p; });
+    for (; it != sorted_names.end() && it->starts_with(prefix); ++it) {
+        out.insert(out.end(), *it);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <ctime>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sorted index of the executables found in $PATH, used for command-name
+// completion. Each PATH directory is rescanned only when its mtime changes,
+// so keeping the index fresh costs one stat() per directory.
+class PathCommandIndex {
+private:
+    struct DirListing {
+        std::string dir;
+        bool exists = false;
+        dev_t device = 0;
+        ino_t inode = 0;
+        timespec mtime{};
+        timespec scanned_at{}; // Wall-clock time of the last scan
+        std::vector<std::string> names{};
+    };
+
+    std::vector<DirListing> dirs; // In $PATH order
+    std::vector<std::string> sorted_names; // Union of all listings, sorted and unique
+    std::string indexed_path; // Value of $PATH the listings belong to
+    bool has_indexed_path = false;
+
+    // Re-read the directory if it changed since the last scan; returns true if it did
+    static bool refresh_directory(DirListing& listing);
+
+public:
+    // Bring the index up to date with $PATH and the PATH directories
+    void refresh();
+
+    // Add every indexed command that starts with prefix
+    void add_matching(std::string_view prefix, std::set<std::string>& out) const;
+
+    // Number of distinct command names in the index
+    size_t size() const { return sorted_names.size(); }
+};
+
+// Global PATH command index instance
+extern PathCommandIndex path_command_index;
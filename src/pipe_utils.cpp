@@ -1,70 +1,262 @@
 #include "pipe_utils.h"
 #include <cstdlib>
-#include <array>
-#include <sys/wait.h>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <iostream>
 #include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+#include "alias_manager.h"
 #include "command_table.h"
+#include "output_buffer.h"
+#include "process_substitution.h"
 #include "redirect_guard.h"
+#include "shell_options.h"
 #include "shell_utils.h"
+#include "spawn_utils.h"
+#include "time_report.h"
+#include "trace.h"
 
 bool (*execute_command_ptr)(const std::vector<std::string>&) = execute_command;
 
-void run_pipeline(const ParsedCommand& cmd) {
-    size_t n = cmd.pipeline.size();
-    if (n == 0) return;
-    if (n == 1) {
-        if (cmd.redirect_type != RedirectType::None) {
-            RedirectGuard guard(cmd.redirect_file, cmd.redirect_type);
-            execute_command_ptr(cmd.pipeline[0]);
-        } else {
-            execute_command_ptr(cmd.pipeline[0]);
-        }
-        return;
+// Resolve a pipeline stage that can be spawned directly. Returns "" for
+// builtins and unknown commands, which need the shell; argv is then the
+// builtin call after alias expansion (empty on an alias loop).
+static std::string resolve_external_stage(const std::vector<std::string>& tokens, std::vector<std::string>& argv) {
+    if (tokens.empty()) return "";
+    try {
+        if (!alias_manager.expand_aliases(tokens, argv)) argv = tokens;
+    } catch (const std::runtime_error&) {
+        argv.clear();
+        return "";
     }
-    std::vector<std::array<int, 2>> pipes(n - 1);
-    for (size_t i = 0; i < n - 1; ++i) {
-        if (pipe(pipes[i].data()) == -1) {
-            perror("pipe");
-            exit(1);
-        }
+    if (argv.empty() || command_table.count(argv[0])) return "";
+    return find_executable(argv[0]);
+}
+
+// A stage's own redirections, applied after its pipe plumbing
+static const std::vector<Redirection>& stage_redirections(const ParsedCommand& cmd, size_t i) {
+    static const std::vector<Redirection> none;
+    return i < cmd.redirections.size() ? cmd.redirections[i] : none;
+}
+
+// A pipe between two stages. Both ends are close-on-exec: spawned stages
+// keep only what their dup2 actions install. With set -o pipesize the
+// capacity is raised, so fast producers and consumers switch less often.
+static bool make_stage_pipe(int fds[2]) {
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        perror("pipe");
+        return false;
     }
+    // Above /proc/sys/fs/pipe-max-size an unprivileged resize fails; keep the default then
+    if (shell_options.pipe_size > 0) fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(shell_options.pipe_size));
+    return true;
+}
+
+// Whether stage i is a builtin that can run on a worker thread: one that only
+// reads shell state, with no redirections of its own to apply
+static bool stage_runs_on_thread(const ParsedCommand& cmd, size_t i, const std::vector<std::string>& argv) {
+    if (!stage_redirections(cmd, i).empty()) return false;
+    if (i == cmd.pipeline.size() - 1 && cmd.redirect_type != RedirectType::None) return false;
+    return !argv.empty() && command_table.count(argv[0]) && builtin_runs_on_thread(argv);
+}
+
+// Body of a builtin stage's worker thread. It owns input and output (-1 for
+// the shell's stdin or stdout) and closes them when done, so the next stage
+// sees end of input just as if a child had exited.
+static void run_stage_thread(std::vector<std::string> argv, int input, int output, ProcessResult& result) {
+    // A reader that went away must fail this thread's writes with EPIPE
+    // rather than kill the whole shell; the pending SIGPIPE dies with the thread
+    sigset_t block;
+    sigemptyset(&block);
+    sigaddset(&block, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &block, nullptr);
+
+    {
+        FdOutputBuffer buffer(output != -1 ? output : STDOUT_FILENO);
+        std::ostream stream(&buffer);
+        // Errors go straight to stderr, after this stage's own output
+        FdOutputBuffer error_buffer(STDERR_FILENO, 1024);
+        std::ostream errors(&error_buffer);
+        errors << std::unitbuf;
+        errors.tie(&stream);
+        builtin_streams = {input != -1 ? input : STDIN_FILENO, output != -1 ? output : STDOUT_FILENO, &stream,
+                           &errors};
+        last_exit_status = 0;
+        TraceSpan span("thread", argv[0]);
+        command_table.find(argv[0])->second(argv);
+        stream.flush();
+    }
+    result.status = last_exit_status;
+    result.end = std::chrono::steady_clock::now();
+    getrusage(RUSAGE_THREAD, &result.usage);
+    if (input != -1) close(input);
+    if (output != -1) close(output);
+}
+
+std::vector<pid_t> launch_pipeline(const ParsedCommand& cmd, bool new_group, StageThreads* threads) {
+    size_t n = cmd.pipeline.size();
     std::vector<pid_t> pids;
+    if (n == 0) return pids;
+
+    // Resolve every stage up front. Builtins only go on threads when no stage
+    // needs a forked shell: a fork would copy the pipe ends the threads hold
+    // and keep their readers from seeing end of input.
+    std::vector<std::vector<std::string>> argvs(n);
+    std::vector<std::string> exec_paths(n);
+    bool use_threads = threads != nullptr;
     for (size_t i = 0; i < n; ++i) {
-        pid_t pid = fork();
-        if (pid == 0) {
-            // stdin from previous pipe
-            if (i > 0) {
-                dup2(pipes[i - 1][0], STDIN_FILENO);
-            }
-            // stdout to next pipe
-            if (i < n - 1) {
-                dup2(pipes[i][1], STDOUT_FILENO);
+        exec_paths[i] = resolve_external_stage(cmd.pipeline[i], argvs[i]);
+        if (exec_paths[i].empty() && !stage_runs_on_thread(cmd, i, argvs[i])) use_threads = false;
+    }
+    if (threads) threads->results.assign(n, {});
+    // Buffered output goes before anything the stages write
+    std::cout.flush();
+
+    // Pipes are made one stage at a time: the shell holds at most the read end
+    // waiting for the next stage, and no child inherits other stages' pipes
+    int input = -1; // Read end of the pipe from the previous stage
+    // The first stage started leads the new group; later ones join it
+    pid_t pgroup = new_group ? 0 : -1;
+    for (size_t i = 0; i < n; ++i) {
+        int next[2] = {-1, -1}; // Pipe to the next stage
+        if (i < n - 1 && !make_stage_pipe(next)) {
+            // Stages already started see end of input and finish
+            if (input != -1) close(input);
+            pids.resize(n, -1);
+            return pids;
+        }
+        int output = next[1];
+
+        const std::vector<std::string>& argv = argvs[i];
+        const std::string& exec_path = exec_paths[i];
+        if (!exec_path.empty()) {
+            // External stage: express the pipe plumbing as spawn file actions
+            std::vector<SpawnFdAction> actions;
+            if (input != -1) {
+                actions.push_back({SpawnFdAction::Kind::Dup2, STDIN_FILENO, input});
             }
-            // close all pipes in child
-            for (auto& p : pipes) {
-                close(p[0]);
-                close(p[1]);
+            if (output != -1) {
+                actions.push_back({SpawnFdAction::Kind::Dup2, STDOUT_FILENO, output});
             }
-            // Only the last command gets redirection
-            if (i == n - 1 && cmd.redirect_type != RedirectType::None) {
-                RedirectGuard guard(cmd.redirect_file, cmd.redirect_type);
-                execute_command_ptr(cmd.pipeline[i]);
-            } else {
-                execute_command_ptr(cmd.pipeline[i]);
+            std::vector<int> here_documents;
+            add_redirect_actions(actions, stage_redirections(cmd, i), here_documents);
+            if (i == n - 1) {
+                add_redirect_actions(actions, cmd.redirect_file, cmd.redirect_type);
             }
-            exit(0);
-        } else if (pid > 0) {
+            pid_t pid = spawn_process(exec_path, argv, actions, pgroup);
+            for (int fd : here_documents) close(fd);
             pids.push_back(pid);
+            if (pid > 0 && pgroup == 0) pgroup = pid;
+        } else if (use_threads) {
+            // Builtin on a worker thread, which takes over the stage's pipe ends
+            try {
+                threads->threads.emplace_back(run_stage_thread, std::move(argvs[i]), input, output,
+                                              std::ref(threads->results[i]));
+                pids.push_back(0);
+                input = output = -1;
+            } catch (const std::system_error& e) {
+                std::cerr << "thread failed: " << e.what() << '\n';
+                pids.push_back(-1);
+            }
         } else {
-            perror("fork failed");
+            // Builtins (and errors that must honour the stage's redirections) run in a forked shell
+            pid_t pid;
+            {
+                TraceSpan span("fork", cmd.pipeline[i].empty() ? "" : cmd.pipeline[i][0]);
+                pid = fork();
+            }
+            if (pid == 0) {
+                if (pgroup >= 0) setpgid(0, pgroup);
+                // The builtin runs without exec, so close-on-exec does not apply
+                if (input != -1) {
+                    dup2(input, STDIN_FILENO);
+                    close(input);
+                }
+                if (output != -1) {
+                    dup2(output, STDOUT_FILENO);
+                    close(next[0]);
+                    close(next[1]);
+                }
+                RedirectGuard stage_guard(stage_redirections(cmd, i));
+                if (i == n - 1 && cmd.redirect_type != RedirectType::None) {
+                    RedirectGuard guard(cmd.redirect_file, cmd.redirect_type);
+                    execute_command_ptr(cmd.pipeline[i]);
+                } else {
+                    execute_command_ptr(cmd.pipeline[i]);
+                }
+                exit(last_exit_status);
+            } else if (pid > 0) {
+                if (pgroup >= 0) setpgid(pid, pgroup);
+                pids.push_back(pid);
+                if (pgroup == 0) pgroup = pid;
+            } else {
+                perror("fork failed");
+                pids.push_back(-1);
+            }
+        }
+
+        // The stages have their copies; the shell keeps only the next stage's input
+        if (input != -1) close(input);
+        if (output != -1) close(output);
+        input = next[0];
+    }
+    return pids;
+}
+
+void run_pipeline(const ParsedCommand& cmd) {
+    size_t n = cmd.pipeline.size();
+    if (n == 0) return;
+    if (n == 1) {
+        {
+            RedirectGuard stage_guard(stage_redirections(cmd, 0));
+            RedirectGuard guard(cmd.redirect_file, cmd.redirect_type);
+            execute_command_ptr(cmd.pipeline[0]);
         }
+        finish_process_substitutions(cmd.substitutions);
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    StageThreads threads;
+    std::vector<pid_t> pids = launch_pipeline(cmd, false, &threads);
+    // Every child stage has its copy of the substitutions' pipes now. Worker
+    // threads open /dev/fd/N in the shell itself, so they must finish first.
+    if (!cmd.substitutions.empty()) {
+        for (std::thread& thread : threads.threads) thread.join();
     }
-    // Parent: close all pipe fds
-    for (auto& p : pipes) {
-        close(p[0]);
-        close(p[1]);
+    close_process_substitutions(cmd.substitutions);
+    if (pids.empty()) {
+        finish_process_substitutions(cmd.substitutions);
+        last_exit_status = 1;
+        return;
     }
+    std::vector<pid_t> started;
     for (pid_t pid : pids) {
-        waitpid(pid, nullptr, 0);
+        if (pid > 0) started.push_back(pid);
+    }
+    // The substitutions run alongside the stages and are reaped with them
+    size_t child_count = started.size();
+    for (const ProcessSubstitution& substitution : cmd.substitutions) {
+        if (substitution.pid > 0 && substitution.owner == getpid()) started.push_back(substitution.pid);
+    }
+    std::vector<ProcessResult> reaped = wait_for_processes(started);
+    for (std::thread& thread : threads.threads) {
+        if (thread.joinable()) thread.join();
+    }
+
+    // Results by stage: threads filled in their own, children were reaped in order
+    std::vector<ProcessResult>& results = threads.results;
+    for (size_t i = 0, k = 0; i < n && k < child_count; ++i) {
+        if (pids[i] > 0) results[i] = reaped[k++];
+    }
+
+    // The pipeline's status is that of its last stage
+    last_exit_status = pids.back() >= 0 ? results.back().status : 127;
+    if (time_stages) {
+        for (size_t i = 0; i < n; ++i) {
+            if (pids[i] < 0) continue;
+            record_stage(cmd.pipeline[i], pids[i] == 0, start, results[i].end, results[i].usage);
+        }
     }
 }
@@ -1,6 +1,25 @@
 
 #pragma once
+#include <sys/types.h>
+#include <thread>
+#include <vector>
 #include "command_parser.h"
+#include "spawn_utils.h"
 
 extern bool (*execute_command_ptr)(const std::vector<std::string>&);
+
+// Builtin stages of a pipeline running on worker threads of the shell
+struct StageThreads {
+    std::vector<std::thread> threads;
+    std::vector<ProcessResult> results; // One per stage, filled in by a stage's thread as it finishes
+};
+
+// Run a pipeline in the foreground and wait for it; sets last_exit_status
 void run_pipeline(const ParsedCommand& cmd);
+
+// Start every stage of a pipeline without waiting and return their pids, one
+// per stage (-1 for a stage that could not be started). With new_group the
+// stages share a new process group led by the first started. With threads,
+// builtin stages that only read shell state run on worker threads added to
+// it, with pid 0, instead of in forked shells; the caller joins them.
+std::vector<pid_t> launch_pipeline(const ParsedCommand& cmd, bool new_group, StageThreads* threads = nullptr);
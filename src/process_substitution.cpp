@@ -0,0 +1,68 @@
+#include "process_substitution.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include "shell_options.h"
+#include "shell_utils.h"
+#include "spawn_utils.h"
+
+// Shell ends still open, which a later substitution's child must not hold on to
+static std::vector<int> open_ends;
+
+ProcessSubstitution start_process_substitution(std::string_view command, bool output) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        return {};
+    }
+    int child_end = output ? fds[1] : fds[0];
+    int shell_end = output ? fds[0] : fds[1];
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(child_end, output ? STDOUT_FILENO : STDIN_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        for (int fd : open_ends) close(fd);
+        open_ends.clear();
+        shell_options.interactive = false;
+        execute_line(command);
+        exit(last_exit_status);
+    }
+    close(child_end);
+    if (pid < 0) {
+        perror("fork failed");
+        close(shell_end);
+        return {};
+    }
+    open_ends.push_back(shell_end);
+    return {pid, shell_end, getpid()};
+}
+
+std::string process_substitution_path(const ProcessSubstitution& substitution) {
+    return "/dev/fd/" + std::to_string(substitution.fd);
+}
+
+void close_process_substitutions(std::span<const ProcessSubstitution> substitutions) {
+    for (const ProcessSubstitution& substitution : substitutions) {
+        if (substitution.fd < 0) continue;
+        auto it = std::find(open_ends.begin(), open_ends.end(), substitution.fd);
+        if (it == open_ends.end()) continue; // Already closed
+        open_ends.erase(it);
+        close(substitution.fd);
+    }
+}
+
+void finish_process_substitutions(std::span<const ProcessSubstitution> substitutions) {
+    close_process_substitutions(substitutions);
+    // A forked subshell inherits its parent's substitutions but cannot wait for them
+    std::vector<pid_t> pids;
+    pid_t self = getpid();
+    for (const ProcessSubstitution& substitution : substitutions) {
+        if (substitution.pid > 0 && substitution.owner == self) pids.push_back(substitution.pid);
+    }
+    if (!pids.empty()) wait_for_processes(pids);
+}
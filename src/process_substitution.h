@@ -0,0 +1,32 @@
+#pragma once
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+/**
+ * A command started for <(...) or >(...). It runs concurrently with the
+ * command that uses it, connected by a pipe: the shell keeps the other end
+ * open, without close-on-exec, so the consumer inherits it and can open it
+ * as /dev/fd/N.
+ */
+struct ProcessSubstitution {
+    pid_t pid = -1;
+    int fd = -1;      // The shell's end of the pipe
+    pid_t owner = -1; // Shell process that started it, and the only one that can reap it
+};
+
+// Start command in a forked shell. With output the command's stdout feeds
+// the pipe (<(...)); otherwise its stdin reads from it (>(...)). Returns a
+// pid of -1 if it could not be started (an error has been printed).
+ProcessSubstitution start_process_substitution(std::string_view command, bool output);
+
+// The /dev/fd/N word that stands for the substitution
+std::string process_substitution_path(const ProcessSubstitution& substitution);
+
+// Close the shell's ends, which lets producers that are still writing see
+// SIGPIPE and readers see end of input. Consumers must have been started.
+void close_process_substitutions(std::span<const ProcessSubstitution> substitutions);
+
+// Close the shell's ends and reap the substitutions this process started
+void finish_process_substitutions(std::span<const ProcessSubstitution> substitutions);
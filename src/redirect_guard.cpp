@@ -1,56 +1,164 @@
 #include "redirect_guard.h"
+#include <cerrno>
 #include <cstdio>
 #include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
 #include <unistd.h>
 #include "command_parser.h" // For RedirectType enum
 
-RedirectGuard::RedirectGuard(const std::string& file, RedirectType type) : type_(type) {
-    if (file.empty() || type == RedirectType::None) return;
+int redirect_open_flags(RedirectType type) {
+    if (type == RedirectType::Stdin) return O_RDONLY;
 
     int flags = O_WRONLY | O_CREAT;
     if (type == RedirectType::StdoutAppend || type == RedirectType::BothAppend || type == RedirectType::StderrAppend) {
         flags |= O_APPEND;
-    } else if (type != RedirectType::Stdin) {
+    } else {
         flags |= O_TRUNC;
     }
+    return flags;
+}
 
-    if (type == RedirectType::Stdin) {
-        out_fd_ = open(file.c_str(), O_RDONLY);
-        if (out_fd_ < 0) {
-            perror("open for input redirection");
-            return;
+static bool write_all(int fd, std::string_view text) {
+    while (!text.empty()) {
+        ssize_t n = write(fd, text.data(), text.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
         }
-        saved_stdin_ = dup(STDIN_FILENO);
-        dup2(out_fd_, STDIN_FILENO);
-    } else {
-        out_fd_ = open(file.c_str(), flags, 0666);
-        if (out_fd_ < 0) {
-            perror("open for redirection");
-            return;
+        text.remove_prefix(n);
+    }
+    return true;
+}
+
+int open_here_document(std::string_view text) {
+    // The whole text is written before anyone reads, so a pipe only works
+    // when it cannot fill up
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == 0) {
+        int capacity = fcntl(fds[1], F_GETPIPE_SZ);
+        if (capacity > 0 && text.size() <= static_cast<size_t>(capacity)) {
+            bool written = write_all(fds[1], text);
+            close(fds[1]);
+            if (written) return fds[0];
+            close(fds[0]);
+            return -1;
         }
-        if (type == RedirectType::Stdout || type == RedirectType::StdoutAppend || type == RedirectType::Both ||
-            type == RedirectType::BothAppend) {
-            saved_stdout_ = dup(STDOUT_FILENO);
-            dup2(out_fd_, STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    int fd = memfd_create("here-document", MFD_CLOEXEC);
+    // Kernels without memfd: an unnamed temporary file
+    if (fd < 0) fd = open("/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+    if (!write_all(fd, text) || lseek(fd, 0, SEEK_SET) != 0) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+    return fd;
+}
+
+RedirectGuard::RedirectGuard(const std::string& file, RedirectType type) {
+    if (file.empty() || type == RedirectType::None) return;
+
+    // Buffered output written before the redirection belongs to the old target
+    std::cout.flush();
+    apply(file, type);
+}
+
+RedirectGuard::RedirectGuard(const std::vector<Redirection>& redirections) {
+    if (redirections.empty()) return;
+
+    std::cout.flush();
+    for (const auto& redirection : redirections) {
+        if (!apply(redirection.target, redirection.type)) break;
+    }
+}
+
+// Keep a close-on-exec copy of a standard stream the first time it is replaced
+void RedirectGuard::save(int fd) {
+    int& saved = fd == STDIN_FILENO ? saved_stdin_ : fd == STDOUT_FILENO ? saved_stdout_ : saved_stderr_;
+    if (saved == -1) saved = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+}
+
+bool RedirectGuard::apply(const std::string& file, RedirectType type) {
+    switch (type) {
+        case RedirectType::None:
+            return true;
+        case RedirectType::StderrToStdout:
+            save(STDERR_FILENO);
+            dup2(STDOUT_FILENO, STDERR_FILENO);
+            return true;
+        case RedirectType::StdoutToStderr:
+            save(STDOUT_FILENO);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+            return true;
+        case RedirectType::HereDocument: {
+            int fd = open_here_document(file);
+            if (fd < 0) {
+                perror("here-document");
+                return false;
+            }
+            save(STDIN_FILENO);
+            dup2(fd, STDIN_FILENO);
+            close(fd);
+            return true;
         }
-        if (type == RedirectType::Stderr || type == RedirectType::Both || type == RedirectType::BothAppend ||
-            type == RedirectType::StderrAppend) {
-            saved_stderr_ = dup(STDERR_FILENO);
-            dup2(out_fd_, STDERR_FILENO);
+        default:
+            break;
+    }
+
+    int flags = redirect_open_flags(type);
+    if (type == RedirectType::Stdin) {
+        int fd = open(file.c_str(), flags);
+        if (fd < 0) {
+            perror("open for input redirection");
+            return false;
         }
+        save(STDIN_FILENO);
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+        return true;
+    }
+
+    int fd = open(file.c_str(), flags, 0666);
+    if (fd < 0) {
+        perror("open for redirection");
+        return false;
+    }
+    if (type == RedirectType::Stdout || type == RedirectType::StdoutAppend || type == RedirectType::Both ||
+        type == RedirectType::BothAppend) {
+        save(STDOUT_FILENO);
+        dup2(fd, STDOUT_FILENO);
     }
+    if (type == RedirectType::Stderr || type == RedirectType::Both || type == RedirectType::BothAppend ||
+        type == RedirectType::StderrAppend) {
+        save(STDERR_FILENO);
+        dup2(fd, STDERR_FILENO);
+    }
+    close(fd);
+    return true;
 }
 
 RedirectGuard::~RedirectGuard() {
-    if (out_fd_ >= 0) {
-        fflush(stdout);
-        fflush(stderr);
-        if (saved_stdout_ != -1) dup2(saved_stdout_, STDOUT_FILENO);
-        if (saved_stderr_ != -1) dup2(saved_stderr_, STDERR_FILENO);
-        if (saved_stdin_ != -1) dup2(saved_stdin_, STDIN_FILENO);
-        close(out_fd_);
-        if (saved_stdout_ != -1) close(saved_stdout_);
-        if (saved_stderr_ != -1) close(saved_stderr_);
-        if (saved_stdin_ != -1) close(saved_stdin_);
+    if (saved_stdout_ == -1 && saved_stderr_ == -1 && saved_stdin_ == -1) return;
+
+    std::cout.flush();
+    fflush(stdout);
+    fflush(stderr);
+    if (saved_stdout_ != -1) {
+        dup2(saved_stdout_, STDOUT_FILENO);
+        close(saved_stdout_);
+    }
+    if (saved_stderr_ != -1) {
+        dup2(saved_stderr_, STDERR_FILENO);
+        close(saved_stderr_);
+    }
+    if (saved_stdin_ != -1) {
+        dup2(saved_stdin_, STDIN_FILENO);
+        close(saved_stdin_);
     }
 }
@@ -1,18 +1,32 @@
-
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
 
 enum class RedirectType;
+struct Redirection;
+
+// open() flags used for the target file of a redirection
+int redirect_open_flags(RedirectType type);
+
+// A close-on-exec descriptor that reads back text, for a here-document.
+// Text that fits in a pipe's buffer goes through a pipe; larger text goes
+// to an anonymous memory file (memfd), so nothing touches the disk.
+// Returns -1 (errno set) on failure.
+int open_here_document(std::string_view text);
 
 class RedirectGuard {
   public:
     RedirectGuard(const std::string& file, RedirectType type);
+    // Apply several redirections left to right, as in `cmd > out 2>&1`
+    explicit RedirectGuard(const std::vector<Redirection>& redirections);
     ~RedirectGuard();
 
   private:
+    bool apply(const std::string& file, RedirectType type);
+    void save(int fd);
+
     int saved_stdout_ = -1;
     int saved_stderr_ = -1;
     int saved_stdin_ = -1;
-    int out_fd_ = -1;
-    RedirectType type_;
 };
@@ -0,0 +1,53 @@
+#include "script_runner.h"
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include "job_table.h"
+#include "line_reader.h"
+#include "shell_utils.h"
+
+int run_script(int fd) {
+    // Commands run from the script read the rest of stdin themselves
+    BufferedLineReader reader(fd, 256 * 1024, fd == STDIN_FILENO);
+    std::string_view line;
+    // Here-document bodies are the lines that follow
+    LineSource more_lines = [&reader](std::string& next) {
+        std::string_view view;
+        if (!reader.next_line(view)) return false;
+        next.assign(view);
+        reader.release();
+        return true;
+    };
+    std::string own_copy;
+    while (reader.next_line(line)) {
+        // Reading a body refills the buffer the line points into
+        if (line.find("<<") != std::string_view::npos) {
+            own_copy.assign(line);
+            line = own_copy;
+        }
+        reader.release();
+        if (execute_line(line, more_lines)) break;
+        // Collect finished background jobs so they do not linger as zombies
+        if (!job_table.empty()) job_table.reap();
+    }
+    return last_exit_status;
+}
+
+int run_command_string(const std::string& commands) {
+    std::string_view remaining(commands);
+    auto take_line = [&remaining] {
+        size_t newline = remaining.find('\n');
+        std::string_view line = remaining.substr(0, newline);
+        remaining.remove_prefix(newline == std::string_view::npos ? remaining.size() : newline + 1);
+        return line;
+    };
+    LineSource more_lines = [&](std::string& next) {
+        if (remaining.empty()) return false;
+        next.assign(take_line());
+        return true;
+    };
+    while (!remaining.empty()) {
+        if (execute_line(take_line(), more_lines)) break;
+    }
+    return last_exit_status;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+// Execute each line read from fd until end of input or `exit` (script files
+// and piped stdin). No prompt, no readline and no history. Returns the exit
+// status of the last command run, which the shell exits with.
+int run_script(int fd);
+
+// Execute the lines of a `-c` command string until the end or `exit`;
+// returns the exit status of the last command run
+int run_command_string(const std::string& commands);
@@ -0,0 +1,155 @@
+#include "shell_options.h"
+#include "history_store.h"
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+// Global shell options instance
+ShellOptions shell_options;
+
+namespace {
+    // A byte count with an optional K, M or G suffix (powers of 1024)
+    bool parse_size(const std::string& value, size_t& size) {
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), size);
+        if (ec != std::errc()) return false;
+        std::string_view suffix(end, value.data() + value.size());
+        int shift = suffix.empty() ? 0 : suffix == "K" || suffix == "k" ? 10 : suffix == "M" || suffix == "m" ? 20
+                  : suffix == "G" || suffix == "g" ? 30 : -1;
+        if (shift < 0 || size > (SIZE_MAX >> shift)) return false;
+        size <<= shift;
+        return true;
+    }
+
+    std::string format_size(size_t size) {
+        if (size >= (1u << 20) && size % (1u << 20) == 0) return std::to_string(size >> 20) + "M";
+        if (size >= (1u << 10) && size % (1u << 10) == 0) return std::to_string(size >> 10) + "K";
+        return std::to_string(size);
+    }
+
+    struct OptionSpec {
+        const char* name;
+        std::function<std::string()> get;
+        std::function<bool(const std::string&)> set; // Returns false for an invalid value
+    };
+
+    const std::vector<OptionSpec>& option_specs() {
+        static const std::vector<OptionSpec> specs = {
+            {
+                "spawn",
+                [] { return shell_options.spawn_backend == SpawnBackend::Fork ? "fork" : "posix_spawn"; },
+                [](const std::string& value) {
+                    if (value == "fork") {
+                        shell_options.spawn_backend = SpawnBackend::Fork;
+                    } else if (value == "posix_spawn") {
+                        shell_options.spawn_backend = SpawnBackend::PosixSpawn;
+                    } else {
+                        return false;
+                    }
+                    return true;
+                }
+            },
+            {
+                "globthreads",
+                [] { return std::to_string(shell_options.glob_threads); },
+                [](const std::string& value) {
+                    unsigned threads = 0;
+                    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), threads);
+                    if (ec != std::errc() || end != value.data() + value.size() || threads > 256) return false;
+                    shell_options.glob_threads = threads;
+                    return true;
+                }
+            },
+            {
+                "histsize",
+                [] { return std::to_string(shell_options.history_size); },
+                [](const std::string& value) {
+                    size_t size = 0;
+                    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), size);
+                    if (ec != std::errc() || end != value.data() + value.size() || size == 0) return false;
+                    shell_options.history_size = size;
+                    history_store.set_cap(size);
+                    return true;
+                }
+            },
+            {
+                "pipesize",
+                [] { return shell_options.pipe_size == 0 ? std::string("default") : format_size(shell_options.pipe_size); },
+                [](const std::string& value) {
+                    size_t size = 0;
+                    if (value == "default") {
+                        size = 0;
+                    } else if (!parse_size(value, size) || size > INT_MAX) {
+                        return false;
+                    }
+                    shell_options.pipe_size = size;
+                    return true;
+                }
+            },
+            {
+                "bracelimit",
+                [] { return std::to_string(shell_options.brace_limit); },
+                [](const std::string& value) {
+                    size_t limit = 0;
+                    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), limit);
+                    if (ec != std::errc() || end != value.data() + value.size() || limit == 0) return false;
+                    shell_options.brace_limit = limit;
+                    return true;
+                }
+            },
+            {
+                "autobatch",
+                [] { return shell_options.autobatch ? "on" : "off"; },
+                [](const std::string& value) {
+                    if (value != "on" && value != "off") return false;
+                    shell_options.autobatch = value == "on";
+                    return true;
+                }
+            },
+            {
+                "dircache",
+                [] { return format_size(shell_options.dir_cache_size); },
+                [](const std::string& value) {
+                    size_t size = 0;
+                    if (!parse_size(value, size)) return false;
+                    shell_options.dir_cache_size = size;
+                    dir_cache.set_capacity(size);
+                    return true;
+                }
+            },
+        };
+        return specs;
+    }
+} // namespace
+
+bool set_shell_option(const std::string& assignment) {
+    size_t eq_pos = assignment.find('=');
+    std::string name = assignment.substr(0, eq_pos);
+    if (eq_pos == std::string::npos) {
+        std::cerr << "set: " << name << ": expected name=value\n";
+        return false;
+    }
+    std::string value = assignment.substr(eq_pos + 1);
+
+    for (const auto& spec : option_specs()) {
+        if (name == spec.name) {
+            if (!spec.set(value)) {
+                std::cerr << "set: " << name << ": invalid value '" << value << "'\n";
+                return false;
+            }
+            return true;
+        }
+    }
+    std::cerr << "set: " << name << ": invalid option name\n";
+    return false;
+}
+
+void print_shell_options(std::ostream& out) {
+    for (const auto& spec : option_specs()) {
+        out << std::left << std::setw(16) << spec.name << spec.get() << '\n';
+    }
+}
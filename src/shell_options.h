@@ -0,0 +1,26 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include "dir_cache.h"
+#include "spawn_utils.h"
+
+// Shell tunables, changed at runtime with `set -o name=value`
+struct ShellOptions {
+    SpawnBackend spawn_backend = SpawnBackend::PosixSpawn;
+    unsigned glob_threads = 0; // Threads for recursive globs and sorting large match sets; 0 = one per hardware thread
+    size_t history_size = 100000; // Entries kept in the persistent history file
+    size_t pipe_size = 0;      // Capacity of pipeline pipes in bytes (F_SETPIPE_SZ); 0 = kernel default
+    size_t dir_cache_size = DirCache::default_capacity; // Bytes of directory listings kept for glob and completion
+    size_t brace_limit = 1000000; // Most words one brace expansion may produce
+    bool autobatch = false;    // Split an external command whose glob or brace expanded arguments exceed ARG_MAX into several runs
+    bool interactive = false;  // Reading commands from a terminal (set at startup, not by `set -o`)
+};
+
+// Global shell options instance
+extern ShellOptions shell_options;
+
+// Apply a "name=value" assignment; prints an error and returns false if invalid
+bool set_shell_option(const std::string& assignment);
+
+// Print every option and its current value, one per line
+void print_shell_options(std::ostream& out);
@@ -1,34 +1,147 @@
 #include "shell_utils.h"
+#include <cerrno>
+#include <chrono>
 #include <filesystem>
 #include <iostream>
-#include <sstream>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <stdexcept>
-#include <sys/wait.h>
+#include <string_view>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
 #include <vector>
+#include "command_hash.h"
 #include "command_table.h"
 #include "command_parser.h"
+#include "process_substitution.h"
 #include "redirect_guard.h"
 #include "pipe_utils.h"
 #include "glob_utils.h"
 #include "alias_manager.h"
+#include "brace_expansion.h"
+#include "spawn_utils.h"
+#include "job_table.h"
+#include "line_parser.h"
+#include "shell_options.h"
+#include "time_report.h"
+#include "trace.h"
+#include "variable_store.h"
 #include <cstdio>
 
-static std::string run_subcommand(const std::string& cmd) {
+// Whether a command of a $(...) can run in the shell itself: an external, or
+// a builtin that only reads shell state (see builtin_runs_on_thread)
+static bool runs_in_process(const SimpleCommand& command) {
+    if (command.words.empty()) return true;
+    const Word& name = command.words[0];
+    if (name.deferred || name.glob || name.brace) return false;
+    size_t eq_pos = name.text.find('=');
+    if (eq_pos != std::string_view::npos && VariableStore::is_valid_name(name.text.substr(0, eq_pos))) return false;
+    std::string command_name(name.text);
+    if (alias_manager.has_alias(command_name)) return false;
+    if (!command_table.count(command_name)) return true;
+    std::vector<std::string> args;
+    for (const Word& word : command.words) {
+        if (word.deferred || word.brace) return false; // The builtin's arguments are not known yet
+        args.emplace_back(word.text);
+    }
+    return builtin_runs_on_thread(args);
+}
+
+// Whether a $(...) cannot change the shell: only such commands, and no
+// assignments or background jobs. A here-document would have its missing
+// body reported twice, so those go to a subshell as well.
+static bool runs_in_process(const std::string& cmd) {
+    if (cmd.find("<<") != std::string::npos) return false;
+    std::pmr::monotonic_buffer_resource arena;
+    LineParser parser(cmd, arena);
+    try {
+        while (std::optional<AndOrList> list = parser.next_list()) {
+            if (list->background) return false;
+            for (const AndOrItem& item : list->items) {
+                for (const SimpleCommand& command : item.pipeline.commands) {
+                    if (!runs_in_process(command)) return false;
+                }
+            }
+        }
+    } catch (const std::runtime_error&) {
+        return false; // The subshell reports it
+    }
+    return true;
+}
+
+// Read a pipe until every writer has closed it
+static void read_all(int fd, std::string& output) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n > 0) {
+            output.append(buf, n);
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+}
+
+// Commands that only read shell state run in process, with the capture pipe
+// as stdout: builtins write to it directly and externals are spawned with it.
+// A reader thread drains the pipe in large chunks so nothing blocks on a
+// full pipe. Anything else (cd, export, alias, exit, a background job...)
+// runs in a forked copy of the shell, so its effects stay there.
+std::string run_subcommand(const std::string& cmd) {
     std::string output;
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) return output;
-    char buf[256];
-    while (fgets(buf, sizeof(buf), pipe)) {
-        output += buf;
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        perror("pipe");
+        return output;
+    }
+    std::cout.flush();
+
+    if (runs_in_process(cmd)) {
+        int saved_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        std::thread reader([&output, read_fd = fds[0]] { read_all(read_fd, output); });
+
+        execute_line(cmd);
+
+        // Restoring stdout drops the shell's write end; the reader sees EOF once
+        // every child holding the pipe has exited too
+        std::cout.flush();
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        reader.join();
+    } else {
+        pid_t pid = fork();
+        if (pid == 0) {
+            dup2(fds[1], STDOUT_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+            shell_options.interactive = false;
+            execute_line(cmd);
+            exit(last_exit_status);
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            perror("fork failed");
+            last_exit_status = 1;
+        } else {
+            read_all(fds[0], output);
+            last_exit_status = wait_for_process(pid);
+        }
     }
-    pclose(pipe);
+    close(fds[0]);
+
     while (!output.empty() && (output.back() == '\n' || output.back() == '\r')) {
         output.pop_back();
     }
     return output;
 }
 
+thread_local int last_exit_status = 0;
+
 std::string trim_whitespace(const std::string& str) {
     const std::string whitespace = " \t\n\r\f\v";
     const auto strBegin = str.find_first_not_of(whitespace);
@@ -38,139 +151,66 @@ std::string trim_whitespace(const std::string& str) {
     return str.substr(strBegin, strRange);
 }
 
-std::vector<std::string> tokenize_input(const std::string& input) {
+// Call emit with each word a lexed word stands for and whether it came from
+// brace expansion. Brace words are generated one at a time, so a large
+// expansion is never held in full outside argv; empty ones are dropped.
+template <typename Emit>
+static void expand_braces(const Word& word, Emit&& emit) {
+    if (!word.brace) {
+        emit(word.text, false);
+        return;
+    }
+    BraceExpansion braces(word.text);
+    std::string text;
+    while (braces.next(text)) {
+        if (!text.empty()) emit(std::string_view(text), true);
+    }
+}
+
+std::vector<std::string> tokenize_input(const std::string& input, std::vector<ProcessSubstitution>* substitutions) {
+    std::pmr::monotonic_buffer_resource arena;
+    Lexer lexer(input, arena);
     std::vector<std::string> tokens;
-    std::string token;
+    Token token;
+    while (lexer.next(token)) {
+        expand_braces(token.word, [&](std::string_view text, bool) { tokens.emplace_back(text); });
+    }
+    if (substitutions) lexer.take_process_substitutions(*substitutions);
+    return tokens;
+}
 
-    enum class State { Normal, Single, Double } state = State::Normal;
-    bool token_from_single_quotes = false;
-    
-    for (size_t i = 0; i < input.size(); ++i) {
-        char c = input[i];
-
-        switch (state) {
-            case State::Normal:
-                if (c == '$' && i + 1 < input.size() && input[i+1] == '(') {
-                    if (!token.empty()) {
-                        if (!token_from_single_quotes && token[0] == '$' && token.size() > 1) {
-                            const char* val = std::getenv(token.c_str() + 1);
-                            token = val ? val : "";
-                        }
-                        tokens.push_back(token);
-                        token.clear();
-                        token_from_single_quotes = false;
-                    }
-                    i += 2;
-                    int depth = 1;
-                    std::string subcmd;
-                    for (; i < input.size() && depth > 0; ++i) {
-                        if (input[i] == '(') depth++;
-                        else if (input[i] == ')') depth--;
-                        if (depth > 0) subcmd += input[i];
-                    }
-                    std::string result = run_subcommand(subcmd);
-                    std::istringstream iss(result);
-                    std::string word;
-                    while (iss >> word) tokens.push_back(word);
-                    --i;
-                } else if (std::isspace(static_cast<unsigned char>(c))) {
-                    if (!token.empty()) {
-                        if (!token_from_single_quotes && token[0] == '$' && token.size() > 1) {
-                            const char* val = std::getenv(token.c_str() + 1);
-                            token = val ? val : "";
-                        }
-                        tokens.push_back(token);
-                        token.clear();
-                        token_from_single_quotes = false;
-                    }
-                } else if (c == '\'') {
-                    state = State::Single;
-                    token_from_single_quotes = true;
-                } else if (c == '"') {
-                    state = State::Double;
-                } else if (c == '\\' && i + 1 < input.size()) {
-                    token += input[i + 1];
-                    ++i;
-                } else {
-                    token += c;
-                }
-                break;
-
-            case State::Single:
-                if (c == '\\' && i + 1 < input.size() && input[i + 1] == '\'') {
-                    token += '\'';
-                    ++i;
-                } else if (c == '\'') {
-                    state = State::Normal;
-                } else {
-                    token += c;
-                }
-                break;
-
-            case State::Double:
-                if (c == '$' && i + 1 < input.size() && input[i+1] == '(') {
-                    i += 2;
-                    int depth = 1;
-                    std::string subcmd;
-                    for (; i < input.size() && depth > 0; ++i) {
-                        if (input[i] == '(') depth++;
-                        else if (input[i] == ')') depth--;
-                        if (depth > 0) subcmd += input[i];
-                    }
-                    std::string result = run_subcommand(subcmd);
-                    token += result;
-                    --i;
-                } else if (c == '\\' && i + 1 < input.size()) {
-                    char next = input[i + 1];
-                    if (next == '\\' || next == '"' || next == '$') {
-                        token += next;
-                        ++i;
-                    } else if (next == 'n') {
-                        token += '\n';
-                        ++i;
-                    } else if (next == '\n') {
-                        token += '\n';
-                        ++i;
-                    } else {
-                        token += '\\';
-                    }
-                } else if (c == '"') {
-                    state = State::Normal;
-                } else if (c == '$' && i + 1 < input.size()) {
-                    // Handle variable expansion in double quotes
-                    ++i;
-                    std::string var_name;
-                    while (i < input.size() && (std::isalnum(static_cast<unsigned char>(input[i])) || input[i] == '_')) {
-                        var_name += input[i];
-                        ++i;
-                    }
-                    --i; // Back up one since the loop will increment
-                    
-                    if (!var_name.empty()) {
-                        const char* val = std::getenv(var_name.c_str());
-                        token += val ? val : "";
-                    } else {
-                        token += '$';
-                    }
-                } else {
-                    token += c;
-                }
-                break;
-        }
+// Walk $PATH for an executable regular file, with one stat() per directory
+static std::string search_path(const std::string& cmd_name) {
+    namespace fs = std::filesystem;
+    const char* path_env_p = std::getenv("PATH");
+    if (!path_env_p) {
+        return "";
     }
+    std::string_view path_env(path_env_p);
+    std::string full_path;
+    while (true) {
+        size_t colon = path_env.find(':');
+        std::string_view dir = path_env.substr(0, colon);
+        if (dir.empty()) dir = ".";
 
-    if (!token.empty()) {
-        if (!token_from_single_quotes && token[0] == '$' && token.size() > 1) {
-            const char* val = std::getenv(token.c_str() + 1);
-            token = val ? val : "";
+        full_path.assign(dir);
+        full_path += '/';
+        full_path += cmd_name;
+        struct stat st;
+        if (stat(full_path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(full_path.c_str(), X_OK) == 0) {
+            std::error_code ec;
+            fs::path canonical = fs::canonical(full_path, ec);
+            if (!ec) return canonical.string();
         }
-        tokens.push_back(token);
-    }
 
-    return tokens;
+        if (colon == std::string_view::npos) break;
+        path_env.remove_prefix(colon + 1);
+    }
+    return "";
 }
 
-std::string find_executable(const std::string& cmd_name) {
+std::string find_executable(const std::string& cmd_name, bool count_hit) {
+    TraceSpan span("find_executable", cmd_name);
     namespace fs = std::filesystem;
     if (cmd_name.find('/') != std::string::npos) {
         fs::path cmd_path(cmd_name);
@@ -183,90 +223,141 @@ std::string find_executable(const std::string& cmd_name) {
         }
         return "";
     }
-    const char* path_env_p = std::getenv("PATH");
-    if (!path_env_p) {
-        return "";
+
+    std::string cached = command_hash.lookup(cmd_name, count_hit);
+    if (!cached.empty()) {
+        return cached;
     }
-    std::string path_env_str = path_env_p;
-    std::istringstream path_stream(path_env_str);
-    std::string dir_str;
-    while (std::getline(path_stream, dir_str, ':')) {
-        if (dir_str.empty()) dir_str = ".";
-        try {
-            fs::path dir_path(dir_str);
-            if (!fs::exists(dir_path) || !fs::is_directory(dir_path)) continue;
-            fs::path full_path = dir_path / cmd_name;
-            if (fs::exists(full_path) && fs::is_regular_file(full_path) && (access(full_path.c_str(), X_OK) == 0)) {
-                return fs::canonical(full_path).string();
-            }
-        } catch (const fs::filesystem_error&) {
-            continue;
-        }
+    std::string found = search_path(cmd_name);
+    if (!found.empty()) {
+        command_hash.remember(cmd_name, found, count_hit ? 1 : 0);
     }
-    return "";
+    return found;
 }
 
 void run_external_command(const std::vector<std::string>& tokens) {
     if (tokens.empty()) {
         std::cerr << "Error: No command provided for external execution." << std::endl;
+        last_exit_status = 1;
         return;
     }
-    std::vector<std::string> expanded_tokens;
-    for (const auto& t : tokens) {
-        if (t.rfind("$(", 0) == 0 && t.size() > 2 && t.back() == ')') {
-            std::string subcmd = t.substr(2, t.size() - 3);
-            std::string result = run_subcommand(subcmd);
-            std::istringstream iss(result);
-            std::string word;
-            while (iss >> word) expanded_tokens.push_back(word);
-        } else {
-            expanded_tokens.push_back(t);
-        }
-    }
-    const std::string exec_path_str = find_executable(expanded_tokens[0]);
+    const std::string exec_path_str = find_executable(tokens[0]);
     if (exec_path_str.empty()) {
         std::cerr << tokens[0] << ": command not found" << std::endl;
+        last_exit_status = 127;
         return;
     }
-    pid_t pid = fork();
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = spawn_process(exec_path_str, tokens, {});
     if (pid == -1) {
-        perror("fork failed");
+        last_exit_status = 126;
         return;
     }
-    if (pid == 0) {
-        std::vector<char*> argv_c;
-        argv_c.reserve(expanded_tokens.size() + 1);
-        for (const auto& token : expanded_tokens) {
-            argv_c.push_back(const_cast<char*>(token.c_str()));
-        }
-        argv_c.push_back(nullptr);
-        execv(exec_path_str.c_str(), argv_c.data());
-        perror(("execv failed for " + tokens[0]).c_str());
-        std::exit(EXIT_FAILURE);
-    } else {
-        int status;
-        if (waitpid(pid, &status, 0) == -1) {
-            perror("waitpid failed");
+    rusage usage{};
+    last_exit_status = wait_for_process(pid, &usage);
+    record_stage(tokens, false, start, std::chrono::steady_clock::now(), usage);
+}
+
+// Run a builtin under `time`. It runs in the shell, so its usage is the
+// difference between getrusage(RUSAGE_SELF) before and after.
+static bool execute_timed_builtin(const CommandHandler& builtin, const std::vector<std::string>& tokens) {
+    rusage before{};
+    rusage after{};
+    getrusage(RUSAGE_SELF, &before);
+    auto start = std::chrono::steady_clock::now();
+    bool result = builtin(tokens);
+    std::cout.flush();
+    std::cerr.flush();
+    auto end = std::chrono::steady_clock::now();
+    getrusage(RUSAGE_SELF, &after);
+    record_stage(tokens, true, start, end, rusage_delta(before, after));
+    return result;
+}
+
+// Number of leading NAME=value words
+static size_t count_assignments(const std::vector<std::string>& tokens) {
+    size_t count = 0;
+    while (count < tokens.size()) {
+        size_t eq_pos = tokens[count].find('=');
+        if (eq_pos == std::string::npos || !VariableStore::is_valid_name(std::string_view(tokens[count]).substr(0, eq_pos))) {
+            break;
         }
-        // Store exit status for logical operations (could be enhanced later)
+        ++count;
     }
+    return count;
 }
 
+// NAME=value words before a command: exported for that command only
+class ScopedAssignments {
+public:
+    ScopedAssignments(const std::vector<std::string>& tokens, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            std::string_view word(tokens[i]);
+            size_t eq_pos = word.find('=');
+            std::string_view name = word.substr(0, eq_pos);
+            std::optional<std::string_view> old = variable_store.get(name);
+            saved.push_back({std::string(name), old ? std::optional<std::string>(*old) : std::nullopt,
+                             variable_store.is_exported(name)});
+            variable_store.set_exported(name, word.substr(eq_pos + 1));
+        }
+    }
+    ~ScopedAssignments() {
+        for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+            if (!it->value) {
+                variable_store.unset(it->name);
+                continue;
+            }
+            if (!it->exported) variable_store.unset(it->name);
+            variable_store.set(it->name, *it->value);
+        }
+    }
+
+private:
+    struct Saved {
+        std::string name;
+        std::optional<std::string> value;
+        bool exported;
+    };
+    std::vector<Saved> saved;
+};
+
 bool execute_command(const std::vector<std::string>& tokens) {
     if (tokens.empty()) return false;
+
+    // NAME=value on its own sets a shell variable; before a command it is
+    // only in that command's environment
+    if (size_t assignments = count_assignments(tokens)) {
+        if (assignments == tokens.size()) {
+            for (const std::string& word : tokens) {
+                size_t eq_pos = word.find('=');
+                variable_store.set(std::string_view(word).substr(0, eq_pos), std::string_view(word).substr(eq_pos + 1));
+            }
+            last_exit_status = 0;
+            return false;
+        }
+        ScopedAssignments scope(tokens, assignments);
+        return execute_command(std::vector<std::string>(tokens.begin() + static_cast<std::ptrdiff_t>(assignments), tokens.end()));
+    }
     
-    std::vector<std::string> expanded_tokens;
+    // Most commands are not aliases and are used as they are
+    std::vector<std::string> alias_expansion;
     try {
-        expanded_tokens = alias_manager.expand_aliases(tokens);
+        if (alias_manager.expand_aliases(tokens, alias_expansion) && alias_expansion.empty()) return false;
     } catch (const std::runtime_error& e) {
         // Handle alias recursion
         std::cerr << e.what() << std::endl;
+        last_exit_status = 1;
         return false;
     }
+    const std::vector<std::string>& expanded_tokens = alias_expansion.empty() ? tokens : alias_expansion;
     
     const std::string& command_name = expanded_tokens[0];
     auto it = command_table.find(command_name);
     if (it != command_table.end()) {
+        // Builtins that fail set their own status; exit keeps the one it exits with
+        if (command_name != "exit") last_exit_status = 0;
+        TraceSpan span("builtin", command_name);
+        if (time_stages) return execute_timed_builtin(it->second, expanded_tokens);
         bool result = it->second(expanded_tokens);
         // Ensure output is flushed after built-in commands
         std::cout.flush();
@@ -281,119 +372,269 @@ bool execute_command(const std::vector<std::string>& tokens) {
     }
 }
 
-std::vector<CommandSequence> parse_command_sequence(const std::string& input) {
-    std::vector<CommandSequence> sequences;
-    std::string current_command;
-    std::string current_operator = "";
-    
-    for (size_t i = 0; i < input.size(); ++i) {
-        char c = input[i];
-        
-        if (c == ';') {
-            if (!current_command.empty()) {
-                CommandSequence seq;
-                seq.tokens = tokenize_input(current_command);
-                // Apply glob expansion after tokenization
-                seq.tokens = expand_glob_patterns(seq.tokens);
-                seq.operator_type = current_operator;
-                sequences.push_back(seq);
-                current_command.clear();
-                current_operator = ";";
-            }
-        } else if (c == '&' && i + 1 < input.size() && input[i + 1] == '&') {
-            if (!current_command.empty()) {
-                CommandSequence seq;
-                seq.tokens = tokenize_input(current_command);
-                // Apply glob expansion after tokenization
-                seq.tokens = expand_glob_patterns(seq.tokens);
-                seq.operator_type = current_operator;
-                sequences.push_back(seq);
-                current_command.clear();
-                current_operator = "&&";
+// Copy a simple command out of the arena as argv, doing deferred expansions
+// and expanding braces and glob words. Matches are appended to argv as they
+// are found, with no copy in between.
+static void collect_stage(const SimpleCommand& command, std::pmr::memory_resource& arena, GlobPatternCache& glob_cache,
+                          std::vector<std::string>& argv, std::vector<Redirection>& redirections,
+                          ExpandedRange& expanded, std::vector<ProcessSubstitution>& substitutions) {
+    argv.reserve(command.words.size());
+    auto add_word = [&](const Word& word) {
+        expand_braces(word, [&](std::string_view text, bool from_braces) {
+            size_t first = argv.size();
+            bool matched = false;
+            if (word.glob) {
+                std::string pattern(text);
+                matched = contains_glob_pattern(pattern) && expand_single_pattern_into(pattern, glob_cache, argv) > 0;
+                // No matches found, keep the literal pattern
+                if (!matched) argv.push_back(std::move(pattern));
+            } else {
+                argv.emplace_back(text);
             }
-            ++i; // Skip the second &
-        } else if (c == '|' && i + 1 < input.size() && input[i + 1] == '|') {
-            if (!current_command.empty()) {
-                CommandSequence seq;
-                seq.tokens = tokenize_input(current_command);
-                // Apply glob expansion after tokenization
-                seq.tokens = expand_glob_patterns(seq.tokens);
-                seq.operator_type = current_operator;
-                sequences.push_back(seq);
-                current_command.clear();
-                current_operator = "||";
+            if (matched || from_braces) {
+                if (expanded.begin == expanded.end) expanded.begin = first;
+                expanded.end = argv.size();
             }
-            ++i; // Skip the second |
-        } else {
-            current_command += c;
+        });
+    };
+    std::pmr::vector<Word> words(&arena);
+    for (const Word& word : command.words) {
+        if (!word.deferred) {
+            add_word(word);
+            continue;
         }
+        words.clear();
+        expand_word(word, arena, words, substitutions);
+        for (const Word& expanded_word : words) add_word(expanded_word);
     }
-    
-    // Add the last command
-    if (!current_command.empty()) {
-        CommandSequence seq;
-        seq.tokens = tokenize_input(current_command);
-        // Apply glob expansion after tokenization
-        seq.tokens = expand_glob_patterns(seq.tokens);
-        seq.operator_type = current_operator;
-        sequences.push_back(seq);
+    redirections.reserve(command.redirects.size());
+    for (const Redirect& redirect : command.redirects) {
+        redirections.push_back({redirect.type, std::string(expand_redirect_target(redirect, arena, substitutions))});
     }
-    
-    return sequences;
+
+    // Aliases are expanded here too, so the <(...) of a body start with the
+    // pipeline's own and stay open until it has run. An alias loop is left
+    // for execute_command to report.
+    std::vector<std::string> alias_expansion;
+    try {
+        if (!alias_manager.expand_aliases(argv, alias_expansion, &substitutions)) return;
+    } catch (const std::runtime_error&) {
+        return;
+    }
+    // The alias name became the body's words: move the expanded range with the words after it
+    size_t shift = alias_expansion.size() - argv.size(); // Modular, so a shorter result works too
+    if (expanded.begin != expanded.end) {
+        if (expanded.begin > 0) expanded.begin += shift;
+        expanded.end += shift;
+    }
+    argv = std::move(alias_expansion);
+}
+
+// Expansions happen here, as the pipeline is about to run, and start its
+// <(...) and >(...) commands. Throws std::runtime_error if one fails.
+static ParsedCommand build_command(const Pipeline& pipeline, GlobPatternCache& glob_cache) {
+    size_t n = pipeline.commands.size();
+    ParsedCommand cmd;
+    cmd.pipeline.resize(n);
+    cmd.redirections.resize(n);
+    cmd.expanded.resize(n);
+    std::pmr::monotonic_buffer_resource arena;
+    try {
+        for (size_t i = 0; i < n; ++i) {
+            collect_stage(pipeline.commands[i], arena, glob_cache, cmd.pipeline[i], cmd.redirections[i],
+                          cmd.expanded[i], cmd.substitutions);
+        }
+    } catch (const std::runtime_error&) {
+        // Substitutions already started will never be used
+        finish_process_substitutions(cmd.substitutions);
+        throw;
+    }
+    return cmd;
+}
+
+// Whether a simple command is an external one whose expanded arguments
+// make its argv too long for a single execve()
+static bool needs_batches(const std::vector<std::string>& argv, ExpandedRange expanded) {
+    if (expanded.begin == expanded.end || count_assignments(argv) > 0) return false;
+    if (command_table.count(argv[0]) || alias_manager.has_alias(argv[0])) return false;
+    size_t bytes = 0;
+    for (const std::string& arg : argv) bytes += exec_argument_cost(arg);
+    return bytes > exec_argument_budget();
 }
 
-bool execute_command_sequence(const std::vector<CommandSequence>& sequences) {
-    bool last_command_success = true;
+// Run an external command as several, like xargs: each run gets the words
+// before and after the expanded arguments and as many of those as fit in
+// ARG_MAX. This keeps every execve() under the limit, not memory: the whole
+// expansion is already in argv, and arguments are moved from it into each
+// run's argv. The status is the last non-zero one, or 0 if every run succeeded.
+static void run_in_batches(std::vector<std::string>& argv, ExpandedRange expanded) {
+    size_t budget = exec_argument_budget();
+    size_t fixed = 0;
+    for (size_t i = 0; i < argv.size(); ++i) {
+        if (i < expanded.begin || i >= expanded.end) fixed += exec_argument_cost(argv[i]);
+    }
+
+    int status = 0;
+    std::vector<std::string> batch;
+    size_t next = expanded.begin;
+    while (next < expanded.end) {
+        batch.assign(argv.begin(), argv.begin() + static_cast<std::ptrdiff_t>(expanded.begin));
+        size_t used = fixed;
+        // At least one argument per run, even if it does not fit on its own
+        do {
+            used += exec_argument_cost(argv[next]);
+            batch.push_back(std::move(argv[next++]));
+        } while (next < expanded.end && used + exec_argument_cost(argv[next]) <= budget);
+        batch.insert(batch.end(), argv.begin() + static_cast<std::ptrdiff_t>(expanded.end), argv.end());
+
+        run_external_command(batch);
+        if (last_exit_status != 0) status = last_exit_status;
+    }
+    last_exit_status = status;
+}
+
+// build_command, reporting a failed expansion as an error of the pipeline
+static std::optional<ParsedCommand> expand_pipeline(const Pipeline& pipeline, GlobPatternCache& glob_cache) {
+    try {
+        return build_command(pipeline, glob_cache);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "shell: " << e.what() << std::endl;
+        last_exit_status = 1;
+        return std::nullopt;
+    }
+}
+
+// Run one pipeline in the foreground; returns true if the shell should exit
+static bool execute_pipeline(const Pipeline& pipeline, GlobPatternCache& glob_cache) {
+    std::optional<ParsedCommand> expanded = expand_pipeline(pipeline, glob_cache);
+    if (!expanded) return false;
+    ParsedCommand& cmd = *expanded;
+    if (cmd.pipeline.size() > 1) {
+        run_pipeline(cmd);
+        return false;
+    }
+
     bool should_exit = false;
-    
-    for (const auto& seq : sequences) {
-        bool should_execute = true;
-        
-        if (seq.operator_type == "&&" && !last_command_success) {
-            should_execute = false;
-        } else if (seq.operator_type == "||" && last_command_success) {
-            should_execute = false;
+    {
+        RedirectGuard guard(cmd.redirections[0]);
+        if (shell_options.autobatch && needs_batches(cmd.pipeline[0], cmd.expanded[0])) {
+            run_in_batches(cmd.pipeline[0], cmd.expanded[0]);
+        } else {
+            should_exit = execute_command(cmd.pipeline[0]);
         }
-        
-        if (should_execute && !seq.tokens.empty()) {
-            ParsedCommand cmd = parse_redirection(seq.tokens);
-            
-            if (cmd.pipeline.size() > 1) {
-                run_pipeline(cmd);
-                last_command_success = true; // Assume success for now
-            } else {
-                const auto& command = cmd.pipeline.empty() ? std::vector<std::string>{} : cmd.pipeline[0];
-                
-                if (cmd.redirect_type != RedirectType::None) {
-                    RedirectGuard guard(cmd.redirect_file, cmd.redirect_type);
-                    should_exit = execute_command(command);
-                } else {
-                    should_exit = execute_command(command);
-                }
-                
-                // Determine command success based on command type
-                if (!command.empty()) {
-                    if (command[0] == "false") {
-                        last_command_success = false;
-                    } else if (command[0] == "true") {
-                        last_command_success = true;
-                    } else if (command[0] == "exit") {
-                        last_command_success = true; // exit is considered successful
-                    } else {
-                        // For other built-ins and external commands, success is the default
-                        // unless they explicitly fail
-                        last_command_success = true;
-                    }
-                } else {
-                    last_command_success = true;
-                }
-                
-                if (should_exit) {
-                    break;
-                }
-            }
+    }
+    finish_process_substitutions(cmd.substitutions);
+    return should_exit;
+}
+
+// Run the pipelines of an and/or list, skipping those whose && or || condition fails
+static bool execute_and_or_items(const AndOrList& list, GlobPatternCache& glob_cache) {
+    for (size_t i = 0; i < list.items.size(); ++i) {
+        const AndOrItem& item = list.items[i];
+        if ((item.op == ListOperator::And && last_exit_status != 0) ||
+            (item.op == ListOperator::Or && last_exit_status == 0)) {
+            continue;
         }
+        if (execute_pipeline(item.pipeline, glob_cache)) return true;
     }
-    
+    return false;
+}
+
+// Run an and/or list prefixed with `time` and report on stderr how long it took
+static bool execute_timed_items(const AndOrList& list, GlobPatternCache& glob_cache) {
+    std::vector<StageUsage> stages;
+    std::vector<StageUsage>* outer = time_stages;
+    time_stages = &stages;
+    auto start = std::chrono::steady_clock::now();
+    bool should_exit = execute_and_or_items(list, glob_cache);
+    double real_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    time_stages = outer;
+
+    std::cout.flush();
+    print_time_report(std::cerr, real_seconds, stages, list.time == TimeMode::Verbose);
+    if (outer) outer->insert(outer->end(), stages.begin(), stages.end());
     return should_exit;
 }
+
+static bool execute_list_items(const AndOrList& list, GlobPatternCache& glob_cache) {
+    if (list.time != TimeMode::None) return execute_timed_items(list, glob_cache);
+    return execute_and_or_items(list, glob_cache);
+}
+
+// Start an and/or list ended by & as a job in its own process group
+static void launch_background(const AndOrList& list, GlobPatternCache& glob_cache) {
+    std::vector<pid_t> pids;
+    size_t substitution_count = 0;
+    if (list.items.size() == 1 && list.time == TimeMode::None) {
+        std::optional<ParsedCommand> cmd = expand_pipeline(list.items[0].pipeline, glob_cache);
+        if (cmd) {
+            // Process substitutions are the shell's children: they join the job,
+            // ahead of the stages so its status is still that of the last stage
+            for (const ProcessSubstitution& substitution : cmd->substitutions) {
+                if (substitution.pid > 0) pids.push_back(substitution.pid);
+            }
+            substitution_count = pids.size();
+            for (pid_t pid : launch_pipeline(*cmd, true)) {
+                if (pid > 0) pids.push_back(pid);
+            }
+            close_process_substitutions(cmd->substitutions);
+        }
+    } else {
+        // A whole && / || chain (or a timed one) runs in a forked copy of the shell
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            setpgid(0, 0);
+            shell_options.interactive = false;
+            execute_list_items(list, glob_cache);
+            exit(last_exit_status);
+        } else if (pid > 0) {
+            setpgid(pid, pid);
+            pids.push_back(pid);
+        } else {
+            perror("fork failed");
+        }
+    }
+    if (pids.size() == substitution_count) {
+        // Nothing started: the substitutions have no one to talk to
+        for (size_t i = 0; i < substitution_count; ++i) wait_for_process(pids[i]);
+        last_exit_status = 1;
+        return;
+    }
+
+    Job& job = job_table.add(pids[substitution_count], pids, std::string(list.text));
+    variable_store.set_last_background_pid(pids.back());
+    if (shell_options.interactive) {
+        std::cerr << '[' << job.id << "] " << pids.back() << std::endl;
+    }
+    last_exit_status = 0;
+}
+
+static bool execute_and_or_list(const AndOrList& list, GlobPatternCache& glob_cache) {
+    if (list.background) {
+        launch_background(list, glob_cache);
+        return false;
+    }
+    return execute_list_items(list, glob_cache);
+}
+
+bool execute_line(std::string_view line, const LineSource& more_lines) {
+    TraceSpan span("execute_line", line);
+    // Typical lines fit in the initial buffer and never touch the heap
+    std::byte initial_buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(initial_buffer, sizeof(initial_buffer));
+    LineParser parser(line, arena, more_lines ? &more_lines : nullptr);
+    GlobPatternCache glob_cache;
+
+    while (true) {
+        std::optional<AndOrList> list;
+        try {
+            list = parser.next_list();
+        } catch (const std::runtime_error& e) {
+            std::cerr << "shell: " << e.what() << std::endl;
+            return false;
+        }
+        if (!list) return false;
+        if (execute_and_or_list(*list, glob_cache)) return true;
+    }
+}
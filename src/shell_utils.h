@@ -1,20 +1,33 @@
 #pragma once
 #include <fcntl.h>
 #include <string>
+#include <string_view>
 #include <unistd.h>
 #include <vector>
+#include "line_reader.h"
+#include "process_substitution.h"
+
+// Exit status of the last foreground command (0 = success). Per thread, so a
+// builtin pipeline stage on a worker thread sets only its own.
+extern thread_local int last_exit_status;
 
 std::string trim_whitespace(const std::string& str);
-std::string find_executable(const std::string& cmd_name);
+// Path of the executable a command name runs, or "". Counts a hit in the
+// command hash unless count_hit is false, as for type, which and hash.
+std::string find_executable(const std::string& cmd_name, bool count_hit = true);
 void run_external_command(const std::vector<std::string>& tokens);
 bool execute_command(const std::vector<std::string>& tokens);
-std::vector<std::string> tokenize_input(const std::string& input);
+// Split input into words as the lexer does, expanding braces. <(...) and
+// >(...) commands started are moved to substitutions, or finished before
+// returning without it.
+std::vector<std::string> tokenize_input(const std::string& input,
+                                        std::vector<ProcessSubstitution>* substitutions = nullptr);
+
 
-// New functions for advanced parsing
-struct CommandSequence {
-    std::vector<std::string> tokens;
-    std::string operator_type;  // "", ";", "&&", "||"
-};
+// Run a command line with stdout captured; trailing newlines are dropped
+std::string run_subcommand(const std::string& cmd);
 
-std::vector<CommandSequence> parse_command_sequence(const std::string& input);
-bool execute_command_sequence(const std::vector<CommandSequence>& sequence);
\ No newline at end of file
+// Parse and run one line of input (handles ;, &&, ||, pipes and
+// redirections). Here-document bodies are read from more_lines.
+// Returns true if the shell should exit.
+bool execute_line(std::string_view line, const LineSource& more_lines = {});
@@ -0,0 +1,269 @@
+#include "spawn_utils.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "command_parser.h"
+#include "redirect_guard.h"
+#include "shell_options.h"
+#include "trace.h"
+#include "variable_store.h"
+
+static std::vector<char*> make_argv(const std::vector<std::string>& argv) {
+    std::vector<char*> argv_c;
+    argv_c.reserve(argv.size() + 1);
+    for (const auto& arg : argv) {
+        argv_c.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv_c.push_back(nullptr);
+    return argv_c;
+}
+
+static pid_t spawn_with_posix_spawn(const std::string& path, const std::vector<std::string>& argv,
+                                    const std::vector<SpawnFdAction>& actions, pid_t pgroup) {
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    // Files are opened here rather than by the spawn, so one that cannot be
+    // opened is reported by name instead of as a failed exec
+    std::vector<int> opened;
+    auto close_opened = [&] {
+        for (int fd : opened) close(fd);
+    };
+    for (const auto& action : actions) {
+        switch (action.kind) {
+            case SpawnFdAction::Kind::Dup2:
+                posix_spawn_file_actions_adddup2(&file_actions, action.source_fd, action.fd);
+                break;
+            case SpawnFdAction::Kind::Close:
+                posix_spawn_file_actions_addclose(&file_actions, action.fd);
+                break;
+            case SpawnFdAction::Kind::Open: {
+                int fd = open(action.path.c_str(), action.flags | O_CLOEXEC, 0666);
+                if (fd < 0) {
+                    std::cerr << "shell: " << action.path << ": " << std::strerror(errno) << std::endl;
+                    close_opened();
+                    posix_spawn_file_actions_destroy(&file_actions);
+                    return -1;
+                }
+                opened.push_back(fd);
+                posix_spawn_file_actions_adddup2(&file_actions, fd, action.fd);
+                break;
+            }
+        }
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    if (pgroup >= 0) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, pgroup);
+    }
+
+    std::vector<char*> argv_c = make_argv(argv);
+    pid_t pid = -1;
+    int err = posix_spawn(&pid, path.c_str(), &file_actions, &attr, argv_c.data(), variable_store.envp());
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&file_actions);
+    close_opened();
+
+    if (err != 0) {
+        std::cerr << "shell: " << path << ": " << std::strerror(err) << std::endl;
+        return -1;
+    }
+    return pid;
+}
+
+static pid_t spawn_with_fork(const std::string& path, const std::vector<std::string>& argv,
+                             const std::vector<SpawnFdAction>& actions, pid_t pgroup) {
+    // Build argv and envp before forking so the child only execs
+    std::vector<char*> argv_c = make_argv(argv);
+    char* const* envp = variable_store.envp();
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork failed");
+        return -1;
+    }
+    if (pid == 0) {
+        if (pgroup >= 0) setpgid(0, pgroup);
+        for (const auto& action : actions) {
+            switch (action.kind) {
+                case SpawnFdAction::Kind::Dup2:
+                    dup2(action.source_fd, action.fd);
+                    break;
+                case SpawnFdAction::Kind::Close:
+                    close(action.fd);
+                    break;
+                case SpawnFdAction::Kind::Open: {
+                    int fd = open(action.path.c_str(), action.flags, 0666);
+                    if (fd < 0) {
+                        perror(("shell: " + action.path).c_str());
+                        _exit(EXIT_FAILURE);
+                    }
+                    if (fd != action.fd) {
+                        dup2(fd, action.fd);
+                        close(fd);
+                    }
+                    break;
+                }
+            }
+        }
+        execve(path.c_str(), argv_c.data(), envp);
+        perror(("shell: " + path).c_str());
+        _exit(EXIT_FAILURE);
+    }
+    // Also set the group from the parent so it is in place before we use it
+    if (pgroup >= 0) setpgid(pid, pgroup);
+    return pid;
+}
+
+size_t exec_argument_budget() {
+    long arg_max = sysconf(_SC_ARG_MAX);
+    size_t budget = arg_max > 0 ? static_cast<size_t>(arg_max) : 128 * 1024;
+    size_t environment = sizeof(char*); // The envp terminator
+    for (char* const* var = variable_store.envp(); *var; ++var) environment += std::strlen(*var) + 1 + sizeof(char*);
+    size_t reserved = environment + sizeof(char*) + 4096; // argv's terminator, and slack
+    return budget > reserved ? budget - reserved : 0;
+}
+
+pid_t spawn_process(SpawnBackend backend, const std::string& path, const std::vector<std::string>& argv,
+                    const std::vector<SpawnFdAction>& actions, pid_t pgroup) {
+    // Output the shell buffered so far must come before the child's
+    std::cout.flush();
+    TraceSpan span(backend == SpawnBackend::Fork ? "fork_exec" : "posix_spawn", argv.empty() ? "" : argv[0]);
+    if (backend == SpawnBackend::Fork) {
+        return spawn_with_fork(path, argv, actions, pgroup);
+    }
+    return spawn_with_posix_spawn(path, argv, actions, pgroup);
+}
+
+pid_t spawn_process(const std::string& path, const std::vector<std::string>& argv,
+                    const std::vector<SpawnFdAction>& actions, pid_t pgroup) {
+    return spawn_process(shell_options.spawn_backend, path, argv, actions, pgroup);
+}
+
+int wait_for_process(pid_t pid, rusage* usage) {
+    TraceSpan span("waitpid");
+    int status = 0;
+    while (wait4(pid, &status, 0, usage) == -1) {
+        if (errno != EINTR) {
+            perror("waitpid failed");
+            return 1;
+        }
+    }
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
+
+std::vector<ProcessResult> wait_for_processes(const std::vector<pid_t>& pids) {
+    TraceSpan span("wait_pipeline");
+    std::vector<ProcessResult> results(pids.size());
+    auto reap = [&](size_t i) {
+        results[i].status = wait_for_process(pids[i], &results[i].usage);
+        results[i].end = std::chrono::steady_clock::now();
+    };
+
+    std::vector<pollfd> fds;
+    std::vector<size_t> waiting; // Index into pids of each entry in fds
+    for (size_t i = 0; i < pids.size(); ++i) {
+        int fd = open_pidfd(pids[i]);
+        if (fd >= 0) {
+            fds.push_back({fd, POLLIN, 0});
+            waiting.push_back(i);
+        } else {
+            reap(i);
+        }
+    }
+    while (!fds.empty()) {
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) continue;
+            // Fall back to waiting in order
+            for (size_t k = 0; k < fds.size(); ++k) {
+                reap(waiting[k]);
+                close(fds[k].fd);
+            }
+            break;
+        }
+        for (size_t k = 0; k < fds.size();) {
+            if (fds[k].revents == 0) {
+                ++k;
+                continue;
+            }
+            reap(waiting[k]);
+            close(fds[k].fd);
+            fds.erase(fds.begin() + k);
+            waiting.erase(waiting.begin() + k);
+        }
+    }
+    return results;
+}
+
+int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+void add_redirect_actions(std::vector<SpawnFdAction>& actions, const std::string& file, RedirectType type) {
+    if (type == RedirectType::StderrToStdout) {
+        actions.push_back({SpawnFdAction::Kind::Dup2, STDERR_FILENO, STDOUT_FILENO, "", 0});
+        return;
+    }
+    if (type == RedirectType::StdoutToStderr) {
+        actions.push_back({SpawnFdAction::Kind::Dup2, STDOUT_FILENO, STDERR_FILENO, "", 0});
+        return;
+    }
+    if (file.empty() || type == RedirectType::None) return;
+
+    int flags = redirect_open_flags(type);
+    switch (type) {
+        case RedirectType::Stdin:
+            actions.push_back({SpawnFdAction::Kind::Open, STDIN_FILENO, -1, file, flags});
+            break;
+        case RedirectType::Stdout:
+        case RedirectType::StdoutAppend:
+            actions.push_back({SpawnFdAction::Kind::Open, STDOUT_FILENO, -1, file, flags});
+            break;
+        case RedirectType::Stderr:
+        case RedirectType::StderrAppend:
+            actions.push_back({SpawnFdAction::Kind::Open, STDERR_FILENO, -1, file, flags});
+            break;
+        case RedirectType::Both:
+        case RedirectType::BothAppend:
+            actions.push_back({SpawnFdAction::Kind::Open, STDOUT_FILENO, -1, file, flags});
+            actions.push_back({SpawnFdAction::Kind::Dup2, STDERR_FILENO, STDOUT_FILENO, "", 0});
+            break;
+        case RedirectType::None:
+        case RedirectType::StderrToStdout:
+        case RedirectType::StdoutToStderr:
+        case RedirectType::HereDocument: // Needs a descriptor; see below
+            break;
+    }
+}
+
+void add_redirect_actions(std::vector<SpawnFdAction>& actions, const std::vector<Redirection>& redirections,
+                          std::vector<int>& opened) {
+    for (const auto& redirection : redirections) {
+        if (redirection.type != RedirectType::HereDocument) {
+            add_redirect_actions(actions, redirection.target, redirection.type);
+            continue;
+        }
+        int fd = open_here_document(redirection.target);
+        if (fd < 0) {
+            perror("here-document");
+            continue;
+        }
+        opened.push_back(fd);
+        actions.push_back({SpawnFdAction::Kind::Dup2, STDIN_FILENO, fd, "", 0});
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <vector>
+
+enum class RedirectType;
+struct Redirection;
+
+// How external commands are started
+enum class SpawnBackend {
+    PosixSpawn, // posix_spawn(): vfork-style, no page-table copy of the shell
+    Fork        // fork() + execv()
+};
+
+// A file descriptor operation applied in the child before exec
+struct SpawnFdAction {
+    enum class Kind { Dup2, Close, Open };
+
+    Kind kind;
+    int fd;             // Descriptor being set up (or closed)
+    int source_fd = -1; // Dup2: descriptor copied onto fd
+    std::string path{}; // Open: file opened onto fd
+    int flags = 0;      // Open: open() flags
+};
+
+/**
+ * Start an executable with the given argv, applying the fd actions in the
+ * child first. Uses the backend selected in shell_options.
+ *
+ * @param pgroup -1 keeps the shell's process group, 0 puts the child in a
+ *               new group it leads, anything else joins that group
+ * @return The child's pid, or -1 if it could not be started (an error has
+ *         been printed)
+ */
+pid_t spawn_process(const std::string& path, const std::vector<std::string>& argv,
+                    const std::vector<SpawnFdAction>& actions, pid_t pgroup = -1);
+
+// Same as spawn_process(), with an explicit backend
+pid_t spawn_process(SpawnBackend backend, const std::string& path, const std::vector<std::string>& argv,
+                    const std::vector<SpawnFdAction>& actions, pid_t pgroup = -1);
+
+// Wait for a child to exit; returns its exit status (128+n if killed by signal n).
+// If usage is given it receives the child's resource usage.
+int wait_for_process(pid_t pid, rusage* usage = nullptr);
+
+// How a child ended, as collected by wait_for_processes()
+struct ProcessResult {
+    int status = 0;
+    rusage usage{};
+    std::chrono::steady_clock::time_point end; // When it was reaped
+};
+
+// Wait for several children, reaping each as soon as it exits so the end
+// times are accurate whatever order they finish in. Results are in the
+// order of pids.
+std::vector<ProcessResult> wait_for_processes(const std::vector<pid_t>& pids);
+
+// Bytes an argument takes of execve()'s ARG_MAX: the string, its NUL and its pointer
+inline size_t exec_argument_cost(const std::string& arg) {
+    return arg.size() + 1 + sizeof(char*);
+}
+
+// Bytes left for an argument list in one execve(): ARG_MAX less the
+// environment children get and a page of slack
+size_t exec_argument_budget();
+
+// A descriptor that becomes readable when the process exits, or -1 if
+// pidfds are not supported
+int open_pidfd(pid_t pid);
+
+// Append the actions that apply a RedirectType to the child's stdin/stdout/stderr
+void add_redirect_actions(std::vector<SpawnFdAction>& actions, const std::string& file, RedirectType type);
+// Here-documents are opened here, in the parent; their descriptors are added
+// to opened for the caller to close once the child has been spawned
+void add_redirect_actions(std::vector<SpawnFdAction>& actions, const std::vector<Redirection>& redirections,
+                          std::vector<int>& opened);
@@ -0,0 +1,275 @@
+#include "state_snapshot.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <readline/history.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "alias_manager.h"
+#include "command_hash.h"
+
+namespace {
+
+    constexpr char snapshot_magic[8] = {'S', 'H', 'S', 'N', 'A', 'P', '\0', '\1'};
+    constexpr uint32_t snapshot_version = 1;
+
+    struct SectionHeader {
+        uint64_t records_offset;
+        uint64_t count;
+        uint64_t table_offset;
+        uint64_t table_slots; // Power of two; each slot holds record number + 1, or 0
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t file_size;
+        uint64_t path_offset; // hashed_path()
+        uint64_t path_length;
+        SectionHeader sections[StateSnapshot::section_count];
+    };
+
+    struct Record {
+        uint64_t key_offset;
+        uint64_t value_offset;
+        uint32_t key_length;
+        uint32_t value_length;
+        uint64_t number;
+    };
+
+    // FNV-1a: stable across runs, unlike std::hash
+    uint64_t hash_key(std::string_view key) {
+        uint64_t hash = 1469598103934665603ull;
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    const Header& header_of(const char* data) {
+        return *reinterpret_cast<const Header*>(data);
+    }
+
+    // Serialized form of one section while a snapshot is being written
+    struct SectionData {
+        std::vector<Record> records;
+        std::vector<uint32_t> table;
+    };
+
+} // namespace
+
+std::shared_ptr<const StateSnapshot> StateSnapshot::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+    size_t length = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return nullptr;
+
+    const char* data = static_cast<const char*>(map);
+    std::shared_ptr<const StateSnapshot> snapshot(new StateSnapshot(data, length));
+
+    // Check the header and that every record and table lies inside the file;
+    // strings are checked as they are read
+    const Header& header = header_of(data);
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0 ||
+        header.version != snapshot_version || header.header_size != sizeof(Header) || header.file_size != length) {
+        return nullptr;
+    }
+    for (const SectionHeader& section : header.sections) {
+        bool fits = section.count <= length / sizeof(Record) &&
+                    section.records_offset <= length - section.count * sizeof(Record) &&
+                    section.table_slots <= length / sizeof(uint32_t) &&
+                    section.table_offset <= length - section.table_slots * sizeof(uint32_t) &&
+                    (section.table_slots & (section.table_slots - 1)) == 0 &&
+                    section.records_offset % alignof(Record) == 0 && section.table_offset % alignof(uint32_t) == 0;
+        if (!fits) return nullptr;
+    }
+    return snapshot;
+}
+
+StateSnapshot::~StateSnapshot() {
+    munmap(const_cast<char*>(data_), length_);
+}
+
+std::string_view StateSnapshot::string_at(uint64_t offset, uint64_t length) const {
+    if (offset > length_ || length > length_ - offset) return {};
+    return {data_ + offset, length};
+}
+
+size_t StateSnapshot::size(Section section) const {
+    return header_of(data_).sections[static_cast<size_t>(section)].count;
+}
+
+StateSnapshot::Entry StateSnapshot::at(Section section, size_t index) const {
+    const SectionHeader& header = header_of(data_).sections[static_cast<size_t>(section)];
+    const Record& record = reinterpret_cast<const Record*>(data_ + header.records_offset)[index];
+    return {string_at(record.key_offset, record.key_length), string_at(record.value_offset, record.value_length),
+            record.number};
+}
+
+std::optional<StateSnapshot::Entry> StateSnapshot::find(Section section, std::string_view key) const {
+    const SectionHeader& header = header_of(data_).sections[static_cast<size_t>(section)];
+    if (header.table_slots == 0) return std::nullopt;
+    const uint32_t* table = reinterpret_cast<const uint32_t*>(data_ + header.table_offset);
+    uint64_t mask = header.table_slots - 1;
+    for (uint64_t slot = hash_key(key) & mask, probes = 0; probes < header.table_slots;
+         slot = (slot + 1) & mask, ++probes) {
+        uint32_t number = table[slot];
+        if (number == 0 || number > header.count) return std::nullopt;
+        Entry entry = at(section, number - 1);
+        if (entry.key == key) return entry;
+    }
+    return std::nullopt;
+}
+
+std::string_view StateSnapshot::hashed_path() const {
+    const Header& header = header_of(data_);
+    return string_at(header.path_offset, header.path_length);
+}
+
+bool write_snapshot(const std::string& path, const AliasManager& aliases, const CommandHash& commands,
+                    const std::vector<std::string>& history) {
+    std::string strings;
+    auto add_string = [&](std::string_view text) {
+        uint64_t offset = strings.size();
+        strings.append(text);
+        return offset;
+    };
+
+    SectionData sections[StateSnapshot::section_count];
+    auto add_record = [&](StateSnapshot::Section section, std::string_view key, std::string_view value,
+                          uint64_t number) {
+        sections[static_cast<size_t>(section)].records.push_back(
+            {add_string(key), add_string(value), static_cast<uint32_t>(key.size()),
+             static_cast<uint32_t>(value.size()), number});
+    };
+    for (const auto& [name, body] : aliases.get_all_aliases()) {
+        add_record(StateSnapshot::Section::Aliases, name, body, 0);
+    }
+    for (const auto& [name, entry] : commands.get_all_entries()) {
+        add_record(StateSnapshot::Section::Commands, name, entry.path, entry.hits);
+    }
+    for (const std::string& line : history) {
+        add_record(StateSnapshot::Section::History, {}, line, 0);
+    }
+
+    // Keyed sections get a table at most half full
+    for (size_t s = 0; s < StateSnapshot::section_count; ++s) {
+        if (static_cast<StateSnapshot::Section>(s) == StateSnapshot::Section::History) continue;
+        SectionData& section = sections[s];
+        size_t slots = 1;
+        while (slots < section.records.size() * 2) slots <<= 1;
+        section.table.assign(section.records.empty() ? 0 : slots, 0);
+        for (size_t i = 0; i < section.records.size(); ++i) {
+            const Record& record = section.records[i];
+            std::string_view key(strings.data() + record.key_offset, record.key_length);
+            size_t slot = hash_key(key) & (slots - 1);
+            while (section.table[slot] != 0) slot = (slot + 1) & (slots - 1);
+            section.table[slot] = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+    std::string path_value;
+    if (const char* path_env = std::getenv("PATH")) path_value = path_env;
+
+    // Lay out: header, records and tables of each section, then the strings
+    Header header{};
+    std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = snapshot_version;
+    header.header_size = sizeof(Header);
+    uint64_t offset = sizeof(Header);
+    for (size_t s = 0; s < StateSnapshot::section_count; ++s) {
+        SectionHeader& section = header.sections[s];
+        section.records_offset = offset;
+        section.count = sections[s].records.size();
+        offset += section.count * sizeof(Record);
+        section.table_offset = offset;
+        section.table_slots = sections[s].table.size();
+        offset += section.table_slots * sizeof(uint32_t);
+        offset = (offset + alignof(Record) - 1) & ~(alignof(Record) - 1);
+    }
+    uint64_t strings_offset = offset;
+    for (SectionData& section : sections) {
+        for (Record& record : section.records) {
+            record.key_offset += strings_offset;
+            record.value_offset += strings_offset;
+        }
+    }
+    header.path_offset = strings_offset + add_string(path_value);
+    header.path_length = path_value.size();
+    header.file_size = strings_offset + strings.size();
+
+    std::string image(header.file_size, '\0');
+    std::memcpy(image.data(), &header, sizeof(header));
+    for (size_t s = 0; s < StateSnapshot::section_count; ++s) {
+        const SectionHeader& section = header.sections[s];
+        std::memcpy(image.data() + section.records_offset, sections[s].records.data(),
+                    section.count * sizeof(Record));
+        std::memcpy(image.data() + section.table_offset, sections[s].table.data(),
+                    section.table_slots * sizeof(uint32_t));
+    }
+    std::memcpy(image.data() + strings_offset, strings.data(), strings.size());
+
+    // Readers see either the old snapshot or the complete new one
+    std::string temp_path = path + ".tmp." + std::to_string(getpid());
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    size_t written = 0;
+    while (written < image.size()) {
+        ssize_t n = write(fd, image.data() + written, image.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    bool ok = written == image.size() && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool save_state_snapshot(const std::string& path) {
+    std::vector<std::string> history;
+    if (HIST_ENTRY** entries = history_list()) {
+        for (int i = 0; i < history_length; ++i) {
+            if (entries[i]) history.emplace_back(entries[i]->line);
+        }
+    }
+    return write_snapshot(path, alias_manager, command_hash, history);
+}
+
+bool load_state_snapshot(const std::string& path, bool restore_history) {
+    std::shared_ptr<const StateSnapshot> snapshot = StateSnapshot::open(path);
+    if (!snapshot) return false;
+    alias_manager.attach_snapshot(snapshot);
+    command_hash.attach_snapshot(snapshot);
+    if (restore_history) {
+        std::string line;
+        for (size_t i = 0; i < snapshot->size(StateSnapshot::Section::History); ++i) {
+            line.assign(snapshot->at(StateSnapshot::Section::History, i).value);
+            add_history(line.c_str());
+        }
+    }
+    return true;
+}
+
+std::string state_snapshot_path() {
+    const char* path = std::getenv("SHELL_SNAPSHOT");
+    return path ? path : "";
+}
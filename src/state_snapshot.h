@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class AliasManager;
+class CommandHash;
+
+/**
+ * Read-only view of a binary snapshot of shell state: aliases, remembered
+ * command locations and history. The file is mmap'd and nothing is copied
+ * when it is opened; each section has an on-disk hash table, so a single
+ * entry can be found (and materialized by its owner) without reading the
+ * rest.
+ *
+ * Layout: a header with one descriptor per section, then per section an
+ * array of fixed-size records and a table of record numbers, then the
+ * strings. All integers are native-endian; a snapshot is only meant to be
+ * read on the machine that wrote it.
+ */
+class StateSnapshot {
+public:
+    enum class Section : uint32_t { Aliases, Commands, History };
+    static constexpr size_t section_count = 3;
+
+    // Aliases: name and body. Commands: name, path and hits. History: the line as value.
+    struct Entry {
+        std::string_view key;
+        std::string_view value;
+        uint64_t number = 0;
+    };
+
+    // Map a snapshot; nullptr if it is missing, truncated or not a snapshot
+    static std::shared_ptr<const StateSnapshot> open(const std::string& path);
+
+    ~StateSnapshot();
+    StateSnapshot(const StateSnapshot&) = delete;
+    StateSnapshot& operator=(const StateSnapshot&) = delete;
+
+    size_t size(Section section) const;
+    Entry at(Section section, size_t index) const;
+    std::optional<Entry> find(Section section, std::string_view key) const;
+
+    // $PATH the command locations were resolved against
+    std::string_view hashed_path() const;
+
+private:
+    StateSnapshot(const char* data, size_t length) : data_(data), length_(length) {}
+    std::string_view string_at(uint64_t offset, uint64_t length) const;
+
+    const char* data_;
+    size_t length_;
+};
+
+// Write a snapshot atomically (a temporary file renamed over path). Aliases
+// and command locations held in an attached snapshot are included.
+bool write_snapshot(const std::string& path, const AliasManager& aliases, const CommandHash& commands,
+                    const std::vector<std::string>& history);
+
+// Write the global aliases, command hash and readline history
+bool save_state_snapshot(const std::string& path);
+
+// Attach a snapshot to the global alias manager and command hash; with
+// restore_history its history is added to readline's. False if there is no
+// usable snapshot at path.
+bool load_state_snapshot(const std::string& path, bool restore_history);
+
+// File named by $SHELL_SNAPSHOT, or "" if snapshots are off
+std::string state_snapshot_path();
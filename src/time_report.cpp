@@ -0,0 +1,83 @@
+#include "time_report.h"
+#include <iomanip>
+
+std::vector<StageUsage>* time_stages = nullptr;
+
+static double seconds(const timeval& tv) {
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+
+static timeval timeval_minus(const timeval& a, const timeval& b) {
+    timeval result;
+    result.tv_sec = a.tv_sec - b.tv_sec;
+    result.tv_usec = a.tv_usec - b.tv_usec;
+    if (result.tv_usec < 0) {
+        --result.tv_sec;
+        result.tv_usec += 1000000;
+    }
+    return result;
+}
+
+void record_stage(const std::vector<std::string>& argv, bool builtin, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end, const rusage& usage) {
+    if (!time_stages) return;
+    std::string command;
+    for (const auto& arg : argv) {
+        if (!command.empty()) command += ' ';
+        command += arg;
+    }
+    time_stages->push_back({std::move(command), builtin, std::chrono::duration<double>(end - start).count(),
+                            seconds(usage.ru_utime), seconds(usage.ru_stime), usage.ru_maxrss});
+}
+
+rusage rusage_delta(const rusage& before, const rusage& after) {
+    rusage delta = after;
+    delta.ru_utime = timeval_minus(after.ru_utime, before.ru_utime);
+    delta.ru_stime = timeval_minus(after.ru_stime, before.ru_stime);
+    return delta;
+}
+
+// 0m0.012s
+static void print_duration(std::ostream& out, double secs) {
+    long minutes = static_cast<long>(secs / 60);
+    out << minutes << 'm' << std::fixed << std::setprecision(3) << secs - minutes * 60.0 << 's';
+}
+
+void print_time_report(std::ostream& out, double real_seconds, const std::vector<StageUsage>& stages, bool verbose) {
+    double user = 0;
+    double sys = 0;
+    bool any_builtin = false;
+    for (const auto& stage : stages) {
+        user += stage.user_seconds;
+        sys += stage.sys_seconds;
+        any_builtin = any_builtin || stage.builtin;
+    }
+
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << '\n';
+    if (verbose && !stages.empty()) {
+        out << std::left << std::setw(7) << "stage" << std::setw(20) << "command" << std::right << std::setw(10)
+            << "real" << std::setw(10) << "user" << std::setw(10) << "sys" << std::setw(14) << "max rss" << '\n';
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const StageUsage& stage = stages[i];
+            std::string name = stage.command.size() > 18 ? stage.command.substr(0, 15) + "..." : stage.command;
+            if (stage.builtin) name += '*';
+            out << std::left << std::setw(7) << i + 1 << std::setw(20) << name << std::right << std::fixed
+                << std::setprecision(3) << std::setw(9) << stage.real_seconds << 's' << std::setw(9)
+                << stage.user_seconds << 's' << std::setw(9) << stage.sys_seconds << 's' << std::setw(10)
+                << stage.max_rss_kb << " KiB\n";
+        }
+        if (any_builtin) out << "* builtin run in the shell; max rss is the shell's\n";
+        out << '\n';
+    }
+    out << "real\t";
+    print_duration(out, real_seconds);
+    out << "\nuser\t";
+    print_duration(out, user);
+    out << "\nsys\t";
+    print_duration(out, sys);
+    out << '\n';
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+// Resource usage of one pipeline stage run under `time`
+struct StageUsage {
+    std::string command;
+    bool builtin;        // Ran inside the shell: times are getrusage(RUSAGE_SELF) deltas
+    double real_seconds; // From launch until the stage was reaped (or returned)
+    double user_seconds;
+    double sys_seconds;
+    long max_rss_kb;     // Peak resident set size; the shell's own for builtins
+};
+
+// Stages recorded while a `time`d list runs; nullptr when nothing is timed
+extern std::vector<StageUsage>* time_stages;
+
+// Add a stage running argv to time_stages, if a list is being timed
+void record_stage(const std::vector<std::string>& argv, bool builtin, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end, const rusage& usage);
+
+// CPU time spent between two getrusage() snapshots; max RSS is taken from after
+rusage rusage_delta(const rusage& before, const rusage& after);
+
+// Print real/user/sys totals like bash's `time`; verbose adds a line per stage
+void print_time_report(std::ostream& out, double real_seconds, const std::vector<StageUsage>& stages, bool verbose);
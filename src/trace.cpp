@@ -0,0 +1,123 @@
+#include "trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Global tracer instance
+Tracer tracer;
+
+static int64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t current_tid() {
+    thread_local uint32_t tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+void Tracer::enable(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    events_ = std::make_unique<TraceEvent[]>(size);
+    mask_ = size - 1;
+    next_.store(0, std::memory_order_relaxed);
+    epoch_ns_ = monotonic_ns();
+    enabled_.store(true, std::memory_order_release);
+}
+
+void Tracer::disable() {
+    enabled_.store(false, std::memory_order_release);
+}
+
+uint64_t Tracer::now() const {
+    return static_cast<uint64_t>(monotonic_ns() - epoch_ns_);
+}
+
+void Tracer::record(const char* name, uint64_t start_ns, std::string_view detail) {
+    if (!events_) return;
+    uint64_t end_ns = now();
+    TraceEvent& event = events_[next_.fetch_add(1, std::memory_order_relaxed) & mask_];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = end_ns - start_ns;
+    event.tid = current_tid();
+    size_t length = std::min(detail.size(), sizeof(event.detail) - 1);
+    std::memcpy(event.detail, detail.data(), length);
+    event.detail[length] = '\0';
+}
+
+size_t Tracer::size() const {
+    if (!events_) return 0;
+    return std::min<uint64_t>(next_.load(std::memory_order_relaxed), mask_ + 1);
+}
+
+static void write_json_string(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* p = text; *p; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            out << '\\' << *p;
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << *p;
+        }
+    }
+    out << '"';
+}
+
+void Tracer::write_json(std::ostream& out) const {
+    uint64_t total = next_.load(std::memory_order_relaxed);
+    uint64_t count = size();
+    pid_t pid = getpid();
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (uint64_t i = total - count; i < total; ++i) {
+        const TraceEvent& event = events_[i & mask_];
+        char times[64];
+        // Chrome trace timestamps are microseconds
+        std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", event.start_ns / 1000.0,
+                      event.duration_ns / 1000.0);
+        out << (i == total - count ? "\n" : ",\n") << "{\"name\":";
+        write_json_string(out, event.name);
+        out << ",\"ph\":\"X\"," << times << ",\"pid\":" << pid << ",\"tid\":" << event.tid;
+        if (event.detail[0]) {
+            out << ",\"args\":{\"detail\":";
+            write_json_string(out, event.detail);
+            out << '}';
+        }
+        out << '}';
+    }
+    out << "\n]}\n";
+}
+
+static std::string trace_path;
+static pid_t trace_owner = 0; // Forked children of the shell must not overwrite the trace
+
+void dump_trace() {
+    if (trace_path.empty() || getpid() != trace_owner) return;
+    std::ofstream out(trace_path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "shell: cannot write trace to " << trace_path << std::endl;
+        return;
+    }
+    tracer.write_json(out);
+}
+
+void start_trace_from_env() {
+    const char* path = std::getenv("SHELL_TRACE");
+    if (!path || !*path) return;
+    trace_path = path;
+    trace_owner = getpid();
+    tracer.enable();
+    std::atexit(dump_trace);
+}
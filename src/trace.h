@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+// One completed span: a phase of the shell's own work
+struct TraceEvent {
+    const char* name;  // A string literal
+    uint64_t start_ns; // Since the tracer was enabled
+    uint64_t duration_ns;
+    uint32_t tid;
+    char detail[40];   // What the span was about (a command name, a pattern), truncated
+};
+
+/**
+ * In-memory tracer for the shell's phases (parsing, alias and glob
+ * expansion, PATH lookup, spawning, waiting). Spans go into a fixed-size
+ * ring buffer that keeps the most recent events, and are written out as
+ * Chrome trace-event JSON for chrome://tracing or Perfetto.
+ *
+ * Off by default: a disabled TraceSpan costs one relaxed atomic load.
+ */
+class Tracer {
+public:
+    static constexpr size_t default_capacity = 1 << 16;
+
+    // Start recording into a ring of capacity events (rounded up to a power of two)
+    void enable(size_t capacity = default_capacity);
+    void disable();
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since enable()
+    uint64_t now() const;
+
+    void record(const char* name, uint64_t start_ns, std::string_view detail);
+
+    // Number of events held (at most the capacity)
+    size_t size() const;
+
+    // Write the held events, oldest first, as a Chrome trace JSON object
+    void write_json(std::ostream& out) const;
+
+private:
+    std::atomic<bool> enabled_{false};
+    std::unique_ptr<TraceEvent[]> events_;
+    size_t mask_ = 0;
+    std::atomic<uint64_t> next_{0}; // Total events recorded; the slot is next_ & mask_
+    int64_t epoch_ns_ = 0;          // CLOCK_MONOTONIC at enable()
+};
+
+// Global tracer instance
+extern Tracer tracer;
+
+// RAII span: records the time from construction to destruction under name
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, std::string_view detail = {}) {
+        if (tracer.enabled()) {
+            name_ = name;
+            detail_ = detail;
+            start_ = tracer.now();
+        }
+    }
+    ~TraceSpan() {
+        if (name_) tracer.record(name_, start_, detail_);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_ = nullptr;
+    std::string_view detail_;
+    uint64_t start_ = 0;
+};
+
+// Enable tracing if SHELL_TRACE names an output file; the trace is written
+// there when the shell exits
+void start_trace_from_env();
+
+// Write the trace to the SHELL_TRACE file now (done automatically at exit)
+void dump_trace();
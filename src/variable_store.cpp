@@ -0,0 +1,196 @@
+#include "variable_store.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+#include <utility>
+#include "shell_utils.h"
+
+extern char** environ;
+
+// Global variable store instance
+VariableStore variable_store;
+
+static size_t hash_name(std::string_view name) {
+    return std::hash<std::string_view>{}(name);
+}
+
+VariableStore::VariableStore() : slots_(64), shell_pid_(getpid()) {
+    for (char** entry = environ; entry && *entry; ++entry) {
+        std::string_view text(*entry);
+        size_t eq_pos = text.find('=');
+        if (eq_pos == std::string_view::npos) continue;
+        std::string_view name = text.substr(0, eq_pos);
+        Slot& slot = insert(name, hash_name(name));
+        slot.value.assign(text.substr(eq_pos + 1));
+        slot.exported = true;
+    }
+}
+
+bool VariableStore::is_valid_name(std::string_view name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) return false;
+    for (char c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+    }
+    return true;
+}
+
+const VariableStore::Slot* VariableStore::find(std::string_view name, size_t hash) const {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots_[i];
+        if (slot.state == Slot::State::Empty) return nullptr;
+        if (slot.state == Slot::State::Used && slot.hash == hash && slot.name == name) return &slot;
+    }
+}
+
+VariableStore::Slot* VariableStore::find(std::string_view name, size_t hash) {
+    return const_cast<Slot*>(std::as_const(*this).find(name, hash));
+}
+
+VariableStore::Slot& VariableStore::insert(std::string_view name, size_t hash) {
+    if (Slot* existing = find(name, hash)) return *existing;
+    // Keep at most three quarters of the slots in use or deleted
+    if ((filled_ + 1) * 4 > slots_.size() * 3) grow();
+    size_t mask = slots_.size() - 1;
+    size_t i = hash & mask;
+    while (slots_[i].state == Slot::State::Used) i = (i + 1) & mask;
+    Slot& slot = slots_[i];
+    if (slot.state == Slot::State::Empty) ++filled_;
+    ++live_;
+    slot.state = Slot::State::Used;
+    slot.exported = false;
+    slot.hash = hash;
+    slot.name.assign(name);
+    slot.value.clear();
+    return slot;
+}
+
+void VariableStore::grow() {
+    // Double only if the table is really fuller; otherwise just drop the deleted slots
+    size_t capacity = live_ * 2 >= slots_.size() ? slots_.size() * 2 : slots_.size();
+    std::vector<Slot> old(capacity);
+    old.swap(slots_);
+    filled_ = live_;
+    size_t mask = slots_.size() - 1;
+    for (Slot& slot : old) {
+        if (slot.state != Slot::State::Used) continue;
+        size_t i = slot.hash & mask;
+        while (slots_[i].state == Slot::State::Used) i = (i + 1) & mask;
+        slots_[i] = std::move(slot);
+    }
+}
+
+void VariableStore::mirror(const Slot& slot) {
+    if (!slot.exported) return;
+    setenv(slot.name.c_str(), slot.value.c_str(), 1);
+    envp_dirty_ = true;
+}
+
+std::optional<std::string_view> VariableStore::get(std::string_view name) {
+    if (name.empty()) return std::nullopt;
+    if (!is_valid_name(name)) return get_special(name);
+    if (const Slot* slot = find(name, hash_name(name))) return std::string_view(slot->value);
+
+    // Set with setenv() by something other than the shell
+    std::string key(name);
+    const char* value = std::getenv(key.c_str());
+    if (!value) return std::nullopt;
+    Slot& slot = insert(name, hash_name(name));
+    slot.value = value;
+    slot.exported = true;
+    envp_dirty_ = true;
+    return std::string_view(slot.value);
+}
+
+std::optional<std::string_view> VariableStore::get_special(std::string_view name) {
+    auto join_args = [&] {
+        special_.clear();
+        for (size_t i = 0; i < args_.size(); ++i) {
+            if (i > 0) special_ += ' ';
+            special_ += args_[i];
+        }
+        return std::string_view(special_);
+    };
+    if (name == "?") return std::string_view(special_ = std::to_string(last_exit_status));
+    if (name == "$") return std::string_view(special_ = std::to_string(shell_pid_));
+    if (name == "#") return std::string_view(special_ = std::to_string(args_.size()));
+    if (name == "!") {
+        if (last_background_pid_ == 0) return std::nullopt;
+        return std::string_view(special_ = std::to_string(last_background_pid_));
+    }
+    if (name == "@" || name == "*") return join_args();
+
+    size_t index = 0;
+    for (char c : name) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) return std::nullopt;
+        index = index * 10 + static_cast<size_t>(c - '0');
+        if (index > args_.size()) return std::nullopt;
+    }
+    if (index == 0) return std::string_view(arg0_);
+    return std::string_view(args_[index - 1]);
+}
+
+void VariableStore::set(std::string_view name, std::string_view value) {
+    Slot& slot = insert(name, hash_name(name));
+    slot.value.assign(value);
+    mirror(slot);
+}
+
+void VariableStore::set_exported(std::string_view name, std::string_view value) {
+    Slot& slot = insert(name, hash_name(name));
+    slot.value.assign(value);
+    slot.exported = true;
+    mirror(slot);
+}
+
+void VariableStore::export_variable(std::string_view name) {
+    Slot& slot = insert(name, hash_name(name));
+    if (slot.exported) return;
+    slot.exported = true;
+    mirror(slot);
+}
+
+bool VariableStore::unset(std::string_view name) {
+    Slot* slot = find(name, hash_name(name));
+    if (!slot) return false;
+    if (slot->exported) {
+        unsetenv(slot->name.c_str());
+        envp_dirty_ = true;
+    }
+    slot->state = Slot::State::Deleted;
+    slot->name.clear();
+    slot->value.clear();
+    --live_;
+    return true;
+}
+
+bool VariableStore::is_exported(std::string_view name) const {
+    const Slot* slot = find(name, hash_name(name));
+    return slot && slot->exported;
+}
+
+char* const* VariableStore::envp() {
+    if (envp_dirty_) {
+        env_strings_.clear();
+        for (const Slot& slot : slots_) {
+            if (slot.state != Slot::State::Used || !slot.exported) continue;
+            std::string entry;
+            entry.reserve(slot.name.size() + 1 + slot.value.size());
+            entry.append(slot.name).append(1, '=').append(slot.value);
+            env_strings_.push_back(std::move(entry));
+        }
+        env_pointers_.clear();
+        for (std::string& entry : env_strings_) env_pointers_.push_back(entry.data());
+        env_pointers_.push_back(nullptr);
+        envp_dirty_ = false;
+        ++envp_builds_;
+    }
+    return env_pointers_.data();
+}
+
+void VariableStore::set_positional(std::string arg0, std::vector<std::string> args) {
+    arg0_ = std::move(arg0);
+    args_ = std::move(args);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * Shell variables: an open-addressing hash table (linear probing, power of
+ * two capacity) of name -> value with an exported flag, plus the positional
+ * parameters ($0, $1.., $#, $@, $*) and special ones ($?, $$, $!).
+ *
+ * The process environment is imported at startup. Exported variables are
+ * mirrored back into it, so getenv() in the rest of the shell and its
+ * libraries stays correct. Children get envp(), which is only rebuilt
+ * after an exported variable has changed.
+ */
+class VariableStore {
+public:
+    VariableStore(); // Imports environ
+
+    // Value of a variable or special/positional parameter; nullopt if unset.
+    // Special parameter values are valid until the next call.
+    std::optional<std::string_view> get(std::string_view name);
+
+    // Set a variable; it stays exported if it already was
+    void set(std::string_view name, std::string_view value);
+
+    // Set a variable and export it
+    void set_exported(std::string_view name, std::string_view value);
+
+    // Export an existing variable (an unset one is created empty)
+    void export_variable(std::string_view name);
+
+    // Remove a variable; false if it was not set
+    bool unset(std::string_view name);
+
+    bool is_exported(std::string_view name) const;
+
+    // NAME=value strings of the exported variables, null-terminated, for execve()
+    char* const* envp();
+
+    // Times envp() has been rebuilt
+    size_t envp_builds() const { return envp_builds_; }
+
+    void set_positional(std::string arg0, std::vector<std::string> args);
+    void set_last_background_pid(pid_t pid) { last_background_pid_ = pid; }
+
+    // A name that can be assigned: [A-Za-z_][A-Za-z0-9_]*
+    static bool is_valid_name(std::string_view name);
+
+private:
+    struct Slot {
+        enum class State : uint8_t { Empty, Used, Deleted };
+        State state = State::Empty;
+        bool exported = false;
+        size_t hash = 0;
+        std::string name;
+        std::string value;
+    };
+
+    // Slot holding name, or nullptr
+    Slot* find(std::string_view name, size_t hash);
+    const Slot* find(std::string_view name, size_t hash) const;
+    Slot& insert(std::string_view name, size_t hash);
+    void grow();
+    void mirror(const Slot& slot);
+    std::optional<std::string_view> get_special(std::string_view name);
+
+    std::vector<Slot> slots_;
+    size_t live_ = 0;   // Used slots
+    size_t filled_ = 0; // Used and deleted slots (deleted ones still lengthen probes)
+
+    bool envp_dirty_ = true;
+    std::vector<std::string> env_strings_;
+    std::vector<char*> env_pointers_;
+    size_t envp_builds_ = 0;
+
+    std::string arg0_ = "shell";
+    std::vector<std::string> args_;
+    pid_t shell_pid_;
+    pid_t last_background_pid_ = 0;
+    std::string special_; // Formatted value of the last special parameter read
+};
+
+// Global variable store instance
+extern VariableStore variable_store;
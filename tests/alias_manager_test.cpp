@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include "alias_manager.h"
+#include "shell_utils.h"
+#include "variable_store.h"
 #include <fstream>
+#include <iostream>
 #include <cstdio>
 
 class AliasManagerTest : public ::testing::Test {
@@ -132,3 +135,59 @@ TEST_F(AliasManagerTest, EmptyAliasName) {
     EXPECT_FALSE(manager.has_alias(""));
     EXPECT_EQ(manager.get_all_aliases().size(), 0);
 }
+
+TEST_F(AliasManagerTest, ExpandsChainsAndSeesRedefinitions) {
+    using V = std::vector<std::string>;
+    manager.set_alias("lsx", "ls --all");
+    manager.set_alias("ll", "lsx -l");
+    EXPECT_EQ(manager.expand_aliases(V{"ll", "src"}), (V{"ls", "--all", "-l", "src"}));
+
+    // The memoized chain is dropped when any alias changes
+    manager.set_alias("lsx", "ls -1");
+    EXPECT_EQ(manager.expand_aliases(V{"ll"}), (V{"ls", "-1", "-l"}));
+    manager.remove_alias("lsx");
+    EXPECT_EQ(manager.expand_aliases(V{"ll"}), (V{"lsx", "-l"}));
+}
+
+TEST_F(AliasManagerTest, NonAliasIsLeftUntouched) {
+    std::vector<std::string> expanded = {"unchanged"};
+    EXPECT_FALSE(manager.expand_aliases({"ls", "-l"}, expanded));
+    EXPECT_EQ(expanded, std::vector<std::string>{"unchanged"});
+}
+
+TEST_F(AliasManagerTest, DetectsAliasLoops) {
+    manager.set_alias("a", "b x");
+    manager.set_alias("b", "a y");
+    EXPECT_THROW(manager.expand_aliases({"a"}), std::runtime_error);
+    EXPECT_THROW(manager.expand_aliases({"a"}), std::runtime_error);
+}
+
+TEST_F(AliasManagerTest, BodiesWithVariablesExpandAtUse) {
+    variable_store.set("ALIAS_TEST_DIR", "/tmp");
+    manager.set_alias("goto", "cd $ALIAS_TEST_DIR");
+    EXPECT_EQ(manager.expand_aliases({"goto"}), (std::vector<std::string>{"cd", "/tmp"}));
+    variable_store.set("ALIAS_TEST_DIR", "/var");
+    EXPECT_EQ(manager.expand_aliases({"goto"}), (std::vector<std::string>{"cd", "/var"}));
+    variable_store.unset("ALIAS_TEST_DIR");
+}
+
+TEST_F(AliasManagerTest, DynamicBodiesCanForkSubshells) {
+    // The $(...) forks; the child would wait forever on a lock held while tokenizing
+    testing::internal::CaptureStdout();
+    execute_line("alias alias_test_root=\"echo \\$(cd /; pwd)\"; alias_test_root");
+    std::cout.flush();
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "/\n");
+    alias_manager.remove_alias("alias_test_root");
+}
+
+TEST_F(AliasManagerTest, ProcessSubstitutionsStartWhenTheAliasRuns) {
+    testing::internal::CaptureStdout();
+    // Defining it starts nothing, so nothing can wait on the alias lock
+    execute_line("alias alias_test_diff='diff <(echo a) <(echo a)'");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+    testing::internal::CaptureStdout();
+    execute_line("alias_test_diff && echo same; alias_test_diff | cat && echo same");
+    std::cout.flush();
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "same\nsame\n");
+    alias_manager.remove_alias("alias_test_diff");
+}
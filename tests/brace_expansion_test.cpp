@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include "brace_expansion.h"
+
+namespace {
+
+    std::vector<std::string> expand(const std::string& word) {
+        BraceExpansion braces(word);
+        std::vector<std::string> words;
+        std::string text;
+        while (braces.next(text)) words.push_back(text);
+        EXPECT_EQ(words.size(), braces.size());
+        return words;
+    }
+
+} // namespace
+
+using V = std::vector<std::string>;
+
+TEST(BraceExpansionTest, ExpandsListsRightmostFirst) {
+    EXPECT_EQ(expand("{a,b,c}"), (V{"a", "b", "c"}));
+    EXPECT_EQ(expand("pre{a,b}post"), (V{"preapost", "prebpost"}));
+    EXPECT_EQ(expand("{a,b}{1,2}"), (V{"a1", "a2", "b1", "b2"}));
+    EXPECT_EQ(expand("file{,.bak}"), (V{"file", "file.bak"}));
+}
+
+TEST(BraceExpansionTest, ExpandsNestedLists) {
+    EXPECT_EQ(expand("{a,b{1,2}}c"), (V{"ac", "b1c", "b2c"}));
+    EXPECT_EQ(expand("{x,{y,z}{1..2}}"), (V{"x", "y1", "y2", "z1", "z2"}));
+}
+
+TEST(BraceExpansionTest, ExpandsNumericRanges) {
+    EXPECT_EQ(expand("{1..5}"), (V{"1", "2", "3", "4", "5"}));
+    EXPECT_EQ(expand("{3..1}"), (V{"3", "2", "1"}));
+    EXPECT_EQ(expand("{1..10..3}"), (V{"1", "4", "7", "10"}));
+    EXPECT_EQ(expand("{10..1..-4}"), (V{"10", "6", "2"}));
+    EXPECT_EQ(expand("{-2..1}"), (V{"-2", "-1", "0", "1"}));
+    EXPECT_EQ(expand("{0..2}"), (V{"0", "1", "2"}));
+}
+
+TEST(BraceExpansionTest, PadsRangesWithLeadingZeros) {
+    EXPECT_EQ(expand("f{08..11}"), (V{"f08", "f09", "f10", "f11"}));
+    EXPECT_EQ(expand("{1..003..2}"), (V{"001", "003"}));
+    EXPECT_EQ(expand("{-01..1}"), (V{"-01", "000", "001"}));
+}
+
+TEST(BraceExpansionTest, ExpandsLetterRanges) {
+    EXPECT_EQ(expand("{a..e}"), (V{"a", "b", "c", "d", "e"}));
+    EXPECT_EQ(expand("{z..t..3}"), (V{"z", "w", "t"}));
+}
+
+TEST(BraceExpansionTest, LeavesOtherBracesLiteral) {
+    EXPECT_EQ(expand("{}"), (V{"{}"}));
+    EXPECT_EQ(expand("{a}"), (V{"{a}"}));
+    EXPECT_EQ(expand("{a,b"), (V{"{a,b"}));
+    EXPECT_EQ(expand("{1..b}"), (V{"{1..b}"}));
+    EXPECT_EQ(expand("{{a,b}"), (V{"{a", "{b"}));
+    EXPECT_EQ(expand("{a,{b},c}"), (V{"a", "{b}", "c"}));
+    EXPECT_EQ(expand("{x{1,2}}"), (V{"{x1}", "{x2}"}));
+    EXPECT_FALSE(BraceExpansion("a{b}c").has_braces());
+    EXPECT_TRUE(BraceExpansion("a{b,}c").has_braces());
+}
+
+TEST(BraceExpansionTest, CountsWithoutGenerating) {
+    BraceExpansion large("{1..1000}{1..1000}{1..1000}");
+    EXPECT_EQ(large.size(), 1000000000u);
+    std::string text;
+    ASSERT_TRUE(large.next(text));
+    EXPECT_EQ(text, "111");
+    ASSERT_TRUE(large.next(text));
+    EXPECT_EQ(text, "112");
+
+    EXPECT_EQ(BraceExpansion("{1..9223372036854775807}{1..9}").size(), std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(BraceExpansion("{-9223372036854775808..9223372036854775807..4611686018427387904}").size(), 4u);
+}
+
+TEST(BraceExpansionTest, DeepNestingStaysLiteral) {
+    std::string word = std::string(1000, '{') + "a,b" + std::string(1000, '}');
+    EXPECT_FALSE(BraceExpansion(word).has_braces());
+    EXPECT_EQ(expand(word), (V{word}));
+}
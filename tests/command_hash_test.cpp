@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "command_hash.h"
+#include "shell_utils.h"
+
+namespace fs = std::filesystem;
+
+class CommandHashTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        const char* path = std::getenv("PATH");
+        original_path = path ? path : "";
+        test_dir = fs::temp_directory_path() / "command_hash_test";
+        fs::create_directory(test_dir);
+        command_hash.clear();
+    }
+
+    void TearDown() override {
+        setenv("PATH", original_path.c_str(), 1);
+        command_hash.clear();
+        fs::remove_all(test_dir);
+    }
+
+    std::string create_executable(const std::string& name) {
+        fs::path file = test_dir / name;
+        std::ofstream(file) << "#!/bin/sh\n";
+        chmod(file.c_str(), 0755);
+        return fs::canonical(file).string();
+    }
+
+    std::string original_path;
+    fs::path test_dir;
+};
+
+TEST_F(CommandHashTest, FindExecutableRemembersLocation) {
+    std::string expected = create_executable("hashed_cmd");
+    setenv("PATH", test_dir.c_str(), 1);
+
+    EXPECT_EQ(find_executable("hashed_cmd"), expected);
+    EXPECT_EQ(find_executable("hashed_cmd"), expected);
+
+    const auto& entries = command_hash.get_all_entries();
+    ASSERT_EQ(entries.count("hashed_cmd"), 1);
+    EXPECT_EQ(entries.at("hashed_cmd").path, expected);
+    EXPECT_EQ(entries.at("hashed_cmd").hits, 2);
+}
+
+TEST_F(CommandHashTest, PathChangeInvalidatesTable) {
+    create_executable("hashed_cmd");
+    setenv("PATH", test_dir.c_str(), 1);
+    EXPECT_FALSE(find_executable("hashed_cmd").empty());
+
+    setenv("PATH", "/nonexistent_dir", 1);
+    EXPECT_TRUE(find_executable("hashed_cmd").empty());
+    EXPECT_TRUE(command_hash.get_all_entries().empty());
+}
+
+TEST_F(CommandHashTest, RemovedExecutableIsForgotten) {
+    std::string path = create_executable("hashed_cmd");
+    setenv("PATH", test_dir.c_str(), 1);
+    EXPECT_EQ(find_executable("hashed_cmd"), path);
+
+    fs::remove(path);
+    EXPECT_TRUE(command_hash.lookup("hashed_cmd").empty());
+    EXPECT_EQ(command_hash.get_all_entries().count("hashed_cmd"), 0);
+}
+
+TEST_F(CommandHashTest, HashBuiltinAddsListsAndClears) {
+    std::string path = create_executable("hashed_cmd");
+    setenv("PATH", "/nonexistent_dir", 1);
+
+    execute_command({"hash", "-p", path, "alias_cmd"});
+    EXPECT_EQ(find_executable("alias_cmd"), path);
+
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    execute_command({"hash"});
+    std::cout.rdbuf(old);
+    EXPECT_NE(buffer.str().find("hits\tcommand"), std::string::npos);
+    EXPECT_NE(buffer.str().find("   1\t" + path), std::string::npos);
+
+    execute_command({"hash", "-r"});
+    EXPECT_TRUE(command_hash.get_all_entries().empty());
+}
+
+TEST_F(CommandHashTest, TypeWhichAndHashCountNoHits) {
+    std::string path = create_executable("hashed_cmd");
+    setenv("PATH", test_dir.c_str(), 1);
+
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    execute_command({"hash", "hashed_cmd"});
+    execute_command({"type", "hashed_cmd"});
+    execute_command({"which", "hashed_cmd"});
+    std::cout.rdbuf(old);
+    EXPECT_EQ(command_hash.get_all_entries().at("hashed_cmd").hits, 0);
+
+    EXPECT_EQ(find_executable("hashed_cmd"), path);
+    EXPECT_EQ(command_hash.get_all_entries().at("hashed_cmd").hits, 1);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "completion.h"
+#include "dir_cache.h"
+#include "glob_utils.h"
+#include "shell_utils.h"
+
+namespace fs = std::filesystem;
+
+class DirCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir = fs::temp_directory_path() / "dir_cache_test";
+        fs::remove_all(test_dir);
+        fs::create_directory(test_dir);
+    }
+
+    void TearDown() override { fs::remove_all(test_dir); }
+
+    // Make a directory with files, dated an hour back so its mtime can be trusted
+    std::string make_dir(const std::string& name, const std::vector<std::string>& files) {
+        fs::path dir = test_dir / name;
+        fs::create_directory(dir);
+        for (const auto& file : files) std::ofstream(dir / file);
+        age(dir);
+        return dir.string();
+    }
+
+    static void age(const fs::path& dir) {
+        timespec times[2] = {{time(nullptr) - 3600, 0}, {time(nullptr) - 3600, 0}};
+        ASSERT_EQ(utimensat(AT_FDCWD, dir.c_str(), times, 0), 0);
+    }
+
+    static std::set<std::string> names(const DirListing& listing) {
+        std::set<std::string> result;
+        for (size_t i = 0; i < listing.size(); ++i) result.emplace(listing[i].name);
+        return result;
+    }
+
+    fs::path test_dir;
+};
+
+TEST_F(DirCacheTest, ReusesListingUntilDirectoryChanges) {
+    DirCache cache;
+    std::string dir = make_dir("a", {"one", "two"});
+    auto first = cache.get(dir);
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(names(*first), std::set<std::string>({"one", "two"}));
+    EXPECT_EQ(cache.get(dir), first);
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(cache.misses(), 1u);
+
+    // A new entry moves the mtime; a just-modified directory is always reread
+    std::ofstream(fs::path(dir) / "three");
+    auto second = cache.get(dir);
+    EXPECT_NE(second, first);
+    EXPECT_EQ(names(*second), std::set<std::string>({"one", "two", "three"}));
+    EXPECT_NE(cache.get(dir), second);
+    EXPECT_EQ(cache.misses(), 3u);
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST_F(DirCacheTest, ReplacedDirectoryIsNotConfusedWithTheOld) {
+    DirCache cache;
+    std::string dir = make_dir("a", {"old"});
+    cache.get(dir);
+    fs::rename(dir, test_dir / "moved");
+    make_dir("a", {"new"});
+    EXPECT_EQ(names(*cache.get(dir)), std::set<std::string>({"new"}));
+}
+
+TEST_F(DirCacheTest, EvictsLeastRecentlyUsedByBytes) {
+    std::string a = make_dir("a", {"x"});
+    std::string b = make_dir("b", {"y"});
+    std::string c = make_dir("c", {"z"});
+    DirCache probe;
+    probe.get(a);
+    size_t one = probe.bytes();
+
+    DirCache cache(one * 2 + one / 2);
+    cache.get(a);
+    cache.get(b);
+    cache.get(a); // b is now the oldest
+    cache.get(c);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_LE(cache.bytes(), cache.capacity());
+    size_t misses = cache.misses();
+    cache.get(a);
+    cache.get(c);
+    EXPECT_EQ(cache.misses(), misses);
+    cache.get(b);
+    EXPECT_EQ(cache.misses(), misses + 1);
+
+    // Too big to cache: still returned
+    cache.set_capacity(one / 2);
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_NE(cache.get(a), nullptr);
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.get("/nonexistent/dir_cache_test"), nullptr);
+}
+
+TEST_F(DirCacheTest, GlobAndCompletionShareListings) {
+    std::string dir = make_dir("src", {"a.h", "b.h", "a.cpp", "sub"});
+    fs::remove(fs::path(dir) / "sub");
+    fs::create_directory(fs::path(dir) / "sub");
+    fs::create_symlink("sub", fs::path(dir) / "link");
+    age(dir);
+    dir_cache.clear();
+    size_t hits = dir_cache.hits();
+    size_t misses = dir_cache.misses();
+
+    std::vector<std::string> expanded = expand_glob_patterns({"cp", dir + "/*.h", dir + "/*.cpp", "dest/"});
+    EXPECT_EQ(expanded, std::vector<std::string>({"cp", dir + "/a.h", dir + "/b.h", dir + "/a.cpp", "dest/"}));
+    std::set<std::string> completions;
+    add_file_completions(dir + "/", completions);
+    EXPECT_EQ(completions, std::set<std::string>({dir + "/a.h", dir + "/b.h", dir + "/a.cpp", dir + "/sub/",
+                                                  dir + "/link/"}));
+    EXPECT_EQ(dir_cache.misses() - misses, 1u);
+    EXPECT_EQ(dir_cache.hits() - hits, 2u);
+
+    std::string stats = run_subcommand("dircache");
+    EXPECT_NE(stats.find("listings  1\n"), std::string::npos);
+    execute_line("dircache -r");
+    EXPECT_EQ(dir_cache.size(), 0u);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <dirent.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "dir_scanner.h"
+
+namespace fs = std::filesystem;
+
+class DirScannerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir = fs::temp_directory_path() / "dir_scanner_test";
+        fs::remove_all(test_dir);
+        fs::create_directory(test_dir);
+    }
+
+    void TearDown() override { fs::remove_all(test_dir); }
+
+    // Every name the scanner reports, sorted
+    std::vector<std::string> scan() {
+        DirScanner scanner(test_dir.c_str());
+        EXPECT_TRUE(scanner.is_open());
+        std::vector<std::string> names;
+        DirEntry entry;
+        while (scanner.next(entry)) names.emplace_back(entry.name);
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    fs::path test_dir;
+};
+
+TEST_F(DirScannerTest, ReportsNamesAndTypes) {
+    std::ofstream(test_dir / "file.txt");
+    fs::create_directory(test_dir / "sub");
+    fs::create_symlink("sub", test_dir / "link");
+    fs::create_symlink("missing", test_dir / "dangling");
+
+    DirScanner scanner(test_dir.c_str());
+    std::vector<std::pair<std::string, unsigned char>> found;
+    DirEntry entry;
+    while (scanner.next(entry)) {
+        EXPECT_EQ(entry.name.data()[entry.name.size()], '\0');
+        found.emplace_back(entry.name, scanner.type_of(entry, true));
+        if (entry.name == "link") {
+            EXPECT_EQ(scanner.type_of(entry, false), DT_LNK);
+        }
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<std::pair<std::string, unsigned char>> expected = {
+        {"dangling", DT_UNKNOWN}, {"file.txt", DT_REG}, {"link", DT_DIR}, {"sub", DT_DIR}};
+    EXPECT_EQ(found, expected);
+}
+
+TEST_F(DirScannerTest, ReadsDirectoriesLargerThanOneBuffer) {
+    // Long names so the listing spans several getdents64() calls
+    std::vector<std::string> expected;
+    std::string padding(200, 'x');
+    for (int i = 0; i < 3000; ++i) {
+        expected.push_back(std::to_string(i) + padding);
+        std::ofstream(test_dir / expected.back());
+    }
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(scan(), expected);
+}
+
+TEST_F(DirScannerTest, NestedScannersKeepTheirOwnEntries) {
+    std::ofstream(test_dir / "a");
+    fs::create_directory(test_dir / "inner");
+    std::ofstream(test_dir / "inner" / "b");
+
+    DirScanner outer(test_dir.c_str());
+    std::vector<std::string> names;
+    DirEntry entry;
+    while (outer.next(entry)) {
+        names.emplace_back(entry.name);
+        if (entry.name == "inner") {
+            DirScanner inner((test_dir / "inner").c_str());
+            DirEntry inner_entry;
+            while (inner.next(inner_entry)) names.push_back("inner/" + std::string(inner_entry.name));
+        }
+    }
+    std::sort(names.begin(), names.end());
+    EXPECT_EQ(names, std::vector<std::string>({"a", "inner", "inner/b"}));
+}
+
+TEST_F(DirScannerTest, MissingDirectoryIsEmpty) {
+    DirScanner scanner((test_dir / "missing").c_str());
+    EXPECT_FALSE(scanner.is_open());
+    DirEntry entry;
+    EXPECT_FALSE(scanner.next(entry));
+    EXPECT_TRUE(DirScanner(test_dir.c_str()).is_open());
+    EXPECT_TRUE(scan().empty());
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "fd_copy.h"
+#include "shell_utils.h"
+
+namespace {
+
+    const std::string text = "line one\nline two\n";
+
+    int make_file(const char* path, const std::string& content, int flags = O_RDWR | O_CREAT | O_TRUNC) {
+        int fd = open(path, flags, 0644);
+        EXPECT_EQ(write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+        lseek(fd, 0, SEEK_SET);
+        return fd;
+    }
+
+    std::string read_all(int fd) {
+        std::string content;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) content.append(buf, n);
+        return content;
+    }
+
+    // A pipe already holding content, its write end closed
+    int filled_pipe(const std::string& content) {
+        int fds[2];
+        EXPECT_EQ(pipe(fds), 0);
+        EXPECT_EQ(write(fds[1], content.data(), content.size()), static_cast<ssize_t>(content.size()));
+        close(fds[1]);
+        return fds[0];
+    }
+
+} // namespace
+
+TEST(FdCopyTest, FileToFileStaysInTheFileSystem) {
+    int in = make_file("fd_copy_test_in.txt", text);
+    int out = make_file("fd_copy_test_out.txt", "");
+    CopyMethod method;
+    ASSERT_TRUE(copy_fd(in, out, &method));
+    EXPECT_NE(method, CopyMethod::ReadWrite);
+    lseek(out, 0, SEEK_SET);
+    EXPECT_EQ(read_all(out), text);
+    close(in);
+    close(out);
+    unlink("fd_copy_test_in.txt");
+    unlink("fd_copy_test_out.txt");
+}
+
+TEST(FdCopyTest, FileToPipeUsesSendfile) {
+    int in = make_file("fd_copy_test_in.txt", text);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    CopyMethod method;
+    ASSERT_TRUE(copy_fd(in, fds[1], &method));
+    EXPECT_EQ(method, CopyMethod::Sendfile);
+    close(fds[1]);
+    EXPECT_EQ(read_all(fds[0]), text);
+    close(fds[0]);
+    close(in);
+    unlink("fd_copy_test_in.txt");
+}
+
+TEST(FdCopyTest, PipeToAppendFileFallsBackToReadWrite) {
+    int out = make_file("fd_copy_test_out.txt", "first\n", O_WRONLY | O_CREAT | O_TRUNC | O_APPEND);
+    int in = filled_pipe(text);
+    CopyMethod method;
+    ASSERT_TRUE(copy_fd(in, out, &method));
+    EXPECT_EQ(method, CopyMethod::ReadWrite); // splice(2) refuses O_APPEND files
+    close(in);
+    close(out);
+
+    int check = open("fd_copy_test_out.txt", O_RDONLY);
+    EXPECT_EQ(read_all(check), "first\n" + text);
+    close(check);
+    unlink("fd_copy_test_out.txt");
+}
+
+TEST(FdCopyTest, ProcFilesAreRead) {
+    int in = open("/proc/self/stat", O_RDONLY);
+    int out = make_file("fd_copy_test_out.txt", "");
+    CopyMethod method;
+    ASSERT_TRUE(copy_fd(in, out, &method));
+    EXPECT_EQ(method, CopyMethod::ReadWrite);
+    EXPECT_GT(lseek(out, 0, SEEK_END), 0);
+    close(in);
+    close(out);
+    unlink("fd_copy_test_out.txt");
+}
+
+TEST(FdCopyTest, TeeSplicesEveryOutput) {
+    int file = make_file("fd_copy_test_out.txt", "");
+    int append = make_file("fd_copy_test_append.txt", "", O_RDWR | O_CREAT | O_TRUNC | O_APPEND);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    int in = filled_pipe(text);
+
+    CopyMethod method;
+    ASSERT_TRUE(tee_fd(in, {file, fds[1]}, &method));
+    EXPECT_EQ(method, CopyMethod::Splice);
+    close(fds[1]);
+    EXPECT_EQ(read_all(fds[0]), text);
+    lseek(file, 0, SEEK_SET);
+    EXPECT_EQ(read_all(file), text);
+    close(in);
+
+    // An O_APPEND output still gets its copy, through a buffer
+    in = filled_pipe(text);
+    ASSERT_TRUE(tee_fd(in, {append, file}, &method));
+    EXPECT_EQ(method, CopyMethod::ReadWrite);
+    lseek(append, 0, SEEK_SET);
+    EXPECT_EQ(read_all(append), text);
+    close(in);
+    close(fds[0]);
+    close(file);
+    close(append);
+    unlink("fd_copy_test_out.txt");
+    unlink("fd_copy_test_append.txt");
+}
+
+TEST(FdCopyTest, CatAndTeeBuiltins) {
+    const char* filename = "fd_copy_test_in.txt";
+    close(make_file(filename, text));
+    EXPECT_EQ(run_subcommand(std::string("cat ") + filename + " - " + filename + " <<< middle"),
+              text + "middle\n" + text.substr(0, text.size() - 1));
+    EXPECT_EQ(run_subcommand(std::string("echo tail | tee -a ") + filename + " | cat"), "tail");
+    EXPECT_EQ(run_subcommand(std::string("cat ") + filename + " | tail -n 1"), "tail");
+    // Options the builtin does not handle run the real cat
+    EXPECT_EQ(run_subcommand(std::string("cat -n ") + filename + " | head -n 1"), "     1\tline one");
+    unlink(filename);
+}
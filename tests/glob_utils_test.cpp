@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include "glob_utils.h"
+#include "shell_options.h"
 
 namespace fs = std::filesystem;
 
@@ -209,3 +211,112 @@ TEST_F(GlobUtilsTest, ComplexPatterns) {
     EXPECT_EQ(matches[1], "file2.txt");
     EXPECT_EQ(matches[2], "file22.txt");
 }
+
+TEST_F(GlobUtilsTest, MatchesCharacterClasses) {
+    EXPECT_TRUE(matches_pattern("file1.txt", "file[12].txt"));
+    EXPECT_FALSE(matches_pattern("file3.txt", "file[12].txt"));
+    EXPECT_TRUE(matches_pattern("file7.txt", "file[0-9].txt"));
+    EXPECT_FALSE(matches_pattern("filex.txt", "file[0-9].txt"));
+    EXPECT_TRUE(matches_pattern("filex.txt", "file[!0-9].txt"));
+    EXPECT_FALSE(matches_pattern("file1.txt", "file[!0-9].txt"));
+    EXPECT_TRUE(matches_pattern("file]", "file[]]"));
+    EXPECT_TRUE(matches_pattern("test.h", "*.[ch]"));
+    EXPECT_FALSE(matches_pattern("test.cpp", "*.[ch]"));
+    // An unterminated class is a literal '['
+    EXPECT_TRUE(matches_pattern("a[b", "a[b"));
+    EXPECT_FALSE(matches_pattern("ab", "a[b"));
+}
+
+TEST_F(GlobUtilsTest, MatchesMultipleStars) {
+    EXPECT_TRUE(matches_pattern("abcabcabd", "*abc*abd"));
+    EXPECT_TRUE(matches_pattern("main.test.cpp", "*.*.cpp"));
+    EXPECT_FALSE(matches_pattern("main.cpp", "*.*.cpp"));
+    EXPECT_TRUE(matches_pattern("aaa", "a**a"));
+    EXPECT_FALSE(matches_pattern("a", "a*a"));
+    EXPECT_TRUE(matches_pattern("", "*"));
+    EXPECT_FALSE(matches_pattern("", "?"));
+    EXPECT_TRUE(matches_pattern("x1y2z", "x?y*[0-9]z"));
+
+    // A long name against a star-heavy pattern stays cheap
+    std::string name(10000, 'a');
+    EXPECT_FALSE(matches_pattern(name, "*a*a*a*a*a*b"));
+    EXPECT_TRUE(matches_pattern(name + "b", "*a*a*a*a*a*b"));
+}
+
+TEST_F(GlobUtilsTest, ExpandCharacterClassPattern) {
+    EXPECT_TRUE(contains_glob_pattern("file[12].txt"));
+    EXPECT_FALSE(contains_glob_pattern("file[.txt"));
+
+    auto matches = expand_single_pattern("file[!2].txt");
+    ASSERT_EQ(matches.size(), 1);
+    EXPECT_EQ(matches[0], "file1.txt");
+}
+
+TEST_F(GlobUtilsTest, GlobstarMatchesAllDepths) {
+    fs::create_directories(test_dir / "subdir/deep/deeper");
+    fs::create_directories(test_dir / ".hidden_dir");
+    create_test_file("subdir/deep/a.cpp");
+    create_test_file("subdir/deep/deeper/b.cpp");
+    create_test_file(".hidden_dir/c.cpp");
+
+    auto matches = expand_single_pattern("**/*.cpp");
+    EXPECT_EQ(matches, (std::vector<std::string>{"main.cpp", "subdir/deep/a.cpp", "subdir/deep/deeper/b.cpp",
+                                                 "subdir/sub2.cpp", "test.cpp"}));
+
+    matches = expand_single_pattern("subdir/**/*.cpp");
+    EXPECT_EQ(matches, (std::vector<std::string>{"subdir/deep/a.cpp", "subdir/deep/deeper/b.cpp", "subdir/sub2.cpp"}));
+
+    matches = expand_single_pattern("subdir/**/deeper/*.cpp");
+    EXPECT_EQ(matches, (std::vector<std::string>{"subdir/deep/deeper/b.cpp"}));
+
+    matches = expand_single_pattern((test_dir / "subdir/*/a.cpp").string());
+    EXPECT_EQ(matches, (std::vector<std::string>{(test_dir / "subdir/deep/a.cpp").string()}));
+}
+
+TEST_F(GlobUtilsTest, GlobstarSameResultForAnyThreadCount) {
+    for (int d = 0; d < 8; ++d) {
+        std::string dir = "tree/d" + std::to_string(d);
+        fs::create_directories(test_dir / dir / "sub");
+        for (int f = 0; f < 10; ++f) {
+            create_test_file(dir + "/f" + std::to_string(f) + ".txt");
+            create_test_file(dir + "/sub/g" + std::to_string(f) + ".txt");
+        }
+    }
+
+    for (const char* pattern : {"tree/**/*.txt", "tree/**"}) {
+        set_shell_option("globthreads=1");
+        auto single = expand_single_pattern(pattern);
+        set_shell_option("globthreads=4");
+        auto multi = expand_single_pattern(pattern);
+        set_shell_option("globthreads=0");
+
+        EXPECT_TRUE(std::is_sorted(single.begin(), single.end()));
+        EXPECT_EQ(single, multi) << pattern;
+    }
+    EXPECT_EQ(expand_single_pattern("tree/**/*.txt").size(), 160);
+    EXPECT_EQ(expand_single_pattern("tree/**").size(), 160 + 16); // Files plus the d*/ and d*/sub directories
+}
+
+TEST_F(GlobUtilsTest, ExpandIntoAppendsSortedMatches) {
+    std::vector<std::string> argv = {"ls", "-l"};
+    GlobPatternCache cache;
+    EXPECT_EQ(expand_single_pattern_into("*.cpp", cache, argv), 2);
+    EXPECT_EQ(expand_single_pattern_into("*.none", cache, argv), 0);
+    EXPECT_EQ(expand_single_pattern_into("file?.txt", cache, argv), 2);
+    EXPECT_EQ(argv, (std::vector<std::string>{"ls", "-l", "main.cpp", "test.cpp", "file1.txt", "file2.txt"}));
+}
+
+TEST_F(GlobUtilsTest, SortMatchesSplitsLargeRanges) {
+    // Enough names to be sorted in runs on several threads and merged
+    std::vector<std::string> names;
+    for (unsigned i = 0; i < 200000; ++i) {
+        names.push_back("f" + std::to_string((i * 2654435761u) % 1000003));
+    }
+    std::vector<std::string> expected = names;
+    std::sort(expected.begin(), expected.end());
+
+    set_shell_option("globthreads=4");
+    sort_matches(names.begin(), names.end());
+    set_shell_option("globthreads=0");
+    EXPECT_EQ(names, expected);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "history_store.h"
+
+namespace fs = std::filesystem;
+
+class HistoryStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override { path = (fs::temp_directory_path() / "history_store_test").string(); }
+    void TearDown() override {
+        store.close();
+        fs::remove(path);
+        fs::remove(path + ".idx");
+    }
+
+    static std::vector<std::string> lines(const std::vector<HistoryEntry>& entries) {
+        std::vector<std::string> result;
+        for (const auto& entry : entries) result.push_back(entry.line);
+        return result;
+    }
+
+    std::string path;
+    HistoryStore store;
+};
+
+TEST_F(HistoryStoreTest, AppendsAndReadsBackAcrossReopens) {
+    using V = std::vector<std::string>;
+    ASSERT_TRUE(store.open(path, 100));
+    store.append("echo one");
+    store.append("echo one"); // Immediate repeat
+    store.append("printf 'a\\nb'\nsecond line");
+    store.append("echo three");
+    store.close();
+
+    ASSERT_TRUE(store.open(path, 100));
+    EXPECT_EQ(store.size(), 3u);
+    auto recent = store.recent(2);
+    EXPECT_EQ(lines(recent), (V{"printf 'a\\nb'\nsecond line", "echo three"}));
+    EXPECT_EQ(recent[0].number, 2u);
+}
+
+TEST_F(HistoryStoreTest, SearchesIndexedAndNewEntriesNewestFirst) {
+    using V = std::vector<std::string>;
+    ASSERT_TRUE(store.open(path, 1000));
+    store.append("git status");
+    store.append("make test");
+    store.append("git log --oneline");
+    store.append("git status");
+    ASSERT_TRUE(store.rebuild_index());
+    store.append("git commit -m wip");
+    store.append("ls");
+
+    EXPECT_EQ(lines(store.search("git", 10)), (V{"git commit -m wip", "git status", "git log --oneline"}));
+    EXPECT_EQ(lines(store.search("git", 2)), (V{"git commit -m wip", "git status"}));
+    EXPECT_EQ(lines(store.search("tes", 10)), V{"make test"});
+    EXPECT_EQ(lines(store.search("ls", 10)), V{"ls"});
+    EXPECT_TRUE(store.search("svn", 10).empty());
+}
+
+TEST_F(HistoryStoreTest, ConcurrentShellsShareTheFile) {
+    using V = std::vector<std::string>;
+    HistoryStore other;
+    ASSERT_TRUE(store.open(path, 100));
+    ASSERT_TRUE(other.open(path, 100));
+    store.append("from first");
+    other.append("from second");
+    store.append("first again");
+    EXPECT_EQ(lines(other.recent(10)), (V{"from first", "from second", "first again"}));
+}
+
+TEST_F(HistoryStoreTest, CompactsToTheCapKeepingLatestDuplicates) {
+    using V = std::vector<std::string>;
+    HistoryStore other;
+    ASSERT_TRUE(store.open(path, 4));
+    ASSERT_TRUE(other.open(path, 4));
+    for (const char* line : {"a", "b", "a", "c", "d"}) store.append(line);
+    EXPECT_EQ(store.size(), 5u); // Compaction waits for a quarter over the cap
+    store.append("e");
+    EXPECT_EQ(lines(store.recent(10)), (V{"a", "c", "d", "e"}));
+
+    // A shell still holding the replaced file appends to the new one
+    other.append("f");
+    EXPECT_EQ(lines(store.recent(10)), (V{"a", "c", "d", "e", "f"}));
+    EXPECT_EQ(lines(store.search("f", 5)), V{"f"});
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "job_table.h"
+#include "shell_utils.h"
+#include "spawn_utils.h"
+
+namespace {
+
+    pid_t start_sh(const std::string& script, pid_t pgroup = 0) {
+        return spawn_process("/bin/sh", {"sh", "-c", script}, {}, pgroup);
+    }
+
+} // namespace
+
+class JobTableTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        while (Job* job = jobs.find("")) {
+            jobs.wait(*job);
+            jobs.remove(job->id);
+        }
+    }
+
+    JobTable jobs;
+};
+
+TEST_F(JobTableTest, TracksProcessGroupAndStatus) {
+    pid_t pid = start_sh("exit 3");
+    ASSERT_GT(pid, 0);
+    Job& job = jobs.add(pid, {pid}, "sh -c 'exit 3'");
+    EXPECT_EQ(job.id, 1);
+    EXPECT_EQ(getpgid(pid), pid);
+
+    EXPECT_EQ(jobs.wait(job), 3);
+    EXPECT_EQ(job.state, JobState::Done);
+}
+
+TEST_F(JobTableTest, WaitAnyReturnsFirstJobToFinish) {
+    pid_t slow = start_sh("sleep 2");
+    pid_t fast = start_sh("exit 5");
+    jobs.add(slow, {slow}, "sleep 2");
+    jobs.add(fast, {fast}, "exit 5");
+
+    Job* job = jobs.wait_any();
+    ASSERT_NE(job, nullptr);
+    EXPECT_EQ(job->id, 2);
+    EXPECT_EQ(job->status(), 5);
+    jobs.remove(job->id);
+
+    ASSERT_NE(jobs.find("%1"), nullptr);
+    kill(-slow, SIGTERM);
+    job = jobs.wait_any();
+    ASSERT_NE(job, nullptr);
+    EXPECT_EQ(job->status(), 128 + SIGTERM);
+    jobs.remove(job->id);
+    EXPECT_EQ(jobs.wait_any(), nullptr);
+}
+
+TEST_F(JobTableTest, PipelineJobSharesOneGroup) {
+    pid_t first = start_sh("sleep 0.1");
+    pid_t second = start_sh("exit 0", first);
+    Job& job = jobs.add(first, {first, second}, "sleep 0.1 | true");
+    EXPECT_EQ(getpgid(second), first);
+    EXPECT_EQ(jobs.wait(job), 0);
+}
+
+TEST_F(JobTableTest, NotifiesFinishedJobsOnce) {
+    pid_t pid = start_sh("exit 0");
+    Job& job = jobs.add(pid, {pid}, "true");
+    jobs.wait(job);
+
+    std::ostringstream first, second;
+    jobs.notify(first);
+    jobs.notify(second);
+    EXPECT_EQ(first.str(), "[1]+  Done                    true\n");
+    EXPECT_TRUE(second.str().empty());
+    EXPECT_TRUE(jobs.empty());
+}
+
+TEST_F(JobTableTest, ListsRunningJobsWithCurrentAndPrevious) {
+    pid_t a = start_sh("sleep 1");
+    pid_t b = start_sh("sleep 1");
+    jobs.add(a, {a}, "sleep 1");
+    jobs.add(b, {b}, "sleep 1");
+
+    std::ostringstream out;
+    jobs.print(out);
+    EXPECT_EQ(out.str(), "[1]-  Running                 sleep 1 &\n[2]+  Running                 sleep 1 &\n");
+    EXPECT_EQ(jobs.find("%-")->id, 1);
+    EXPECT_EQ(jobs.find("%%")->id, 2);
+    EXPECT_EQ(jobs.find("2")->id, 2);
+    EXPECT_EQ(jobs.find("%7"), nullptr);
+    EXPECT_EQ(jobs.find_pid(a)->id, 1);
+    kill(-a, SIGTERM);
+    kill(-b, SIGTERM);
+}
+
+TEST(BackgroundJobTest, AmpersandStartsJobAndWaitCollectsIt) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    execute_line("sh -c 'exit 4' & echo started");
+    EXPECT_FALSE(job_table.empty());
+    execute_line("wait -n || echo \"failed\"; wait");
+    std::cout.rdbuf(old);
+    EXPECT_EQ(buffer.str(), "started\nfailed\n");
+    EXPECT_TRUE(job_table.empty());
+}
+
+TEST(BackgroundJobTest, WaitSkipsStoppedJobs) {
+    execute_line("sleep 5 &");
+    Job* job = job_table.find("");
+    ASSERT_NE(job, nullptr);
+    pid_t pgid = job->pgid;
+    kill(-pgid, SIGSTOP);
+    while (job_table.find("")->state != JobState::Stopped) job_table.reap();
+
+    execute_line("wait");
+    EXPECT_EQ(last_exit_status, 0);
+    ASSERT_NE(job_table.find(""), nullptr);
+
+    kill(-pgid, SIGKILL);
+    kill(-pgid, SIGCONT);
+    job_table.wait(*job_table.find(""));
+    job_table.remove(job_table.find("")->id);
+    EXPECT_TRUE(job_table.empty());
+}
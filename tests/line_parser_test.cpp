@@ -0,0 +1,337 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "line_parser.h"
+#include "shell_utils.h"
+#include "variable_store.h"
+
+namespace {
+
+    std::vector<std::string> words_of(const SimpleCommand& command) {
+        std::vector<std::string> words;
+        for (const Word& word : command.words) words.emplace_back(word.text);
+        return words;
+    }
+
+    // The words of a command with deferred expansions done, as when it runs
+    std::vector<std::string> expanded_words_of(const SimpleCommand& command, std::pmr::memory_resource& arena) {
+        std::vector<std::string> words;
+        std::pmr::vector<Word> expanded(&arena);
+        std::vector<ProcessSubstitution> substitutions;
+        for (const Word& word : command.words) {
+            if (!word.deferred) {
+                words.emplace_back(word.text);
+                continue;
+            }
+            expanded.clear();
+            expand_word(word, arena, expanded, substitutions);
+            for (const Word& expanded_word : expanded) words.emplace_back(expanded_word.text);
+        }
+        finish_process_substitutions(substitutions);
+        return words;
+    }
+
+} // namespace
+
+TEST(LineParserTest, BuildsListsPipelinesAndCommands) {
+    using V = std::vector<std::string>;
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("ls -l | grep x && echo ok || echo no; pwd", arena);
+
+    ASSERT_EQ(line.lists.size(), 2u);
+    const auto& items = line.lists[0].items;
+    ASSERT_EQ(items.size(), 3u);
+    EXPECT_EQ(items[0].op, ListOperator::None);
+    EXPECT_EQ(items[1].op, ListOperator::And);
+    EXPECT_EQ(items[2].op, ListOperator::Or);
+    ASSERT_EQ(items[0].pipeline.commands.size(), 2u);
+    EXPECT_EQ(words_of(items[0].pipeline.commands[0]), (V{"ls", "-l"}));
+    EXPECT_EQ(words_of(items[0].pipeline.commands[1]), (V{"grep", "x"}));
+    EXPECT_EQ(words_of(line.lists[1].items[0].pipeline.commands[0]), V{"pwd"});
+}
+
+TEST(LineParserTest, OperatorsInsideQuotesAreWords) {
+    using V = std::vector<std::string>;
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("echo 'a; b' \"c && d\" e\\|f", arena);
+
+    ASSERT_EQ(line.lists.size(), 1u);
+    ASSERT_EQ(line.lists[0].items.size(), 1u);
+    ASSERT_EQ(line.lists[0].items[0].pipeline.commands.size(), 1u);
+    EXPECT_EQ(words_of(line.lists[0].items[0].pipeline.commands[0]), (V{"echo", "a; b", "c && d", "e|f"}));
+}
+
+TEST(LineParserTest, UnquotedOperatorsSplitWords) {
+    using V = std::vector<std::string>;
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("echo a;echo b&&echo c", arena);
+
+    ASSERT_EQ(line.lists.size(), 2u);
+    EXPECT_EQ(words_of(line.lists[0].items[0].pipeline.commands[0]), (V{"echo", "a"}));
+    ASSERT_EQ(line.lists[1].items.size(), 2u);
+    EXPECT_EQ(words_of(line.lists[1].items[1].pipeline.commands[0]), (V{"echo", "c"}));
+}
+
+TEST(LineParserTest, AmpersandEndsABackgroundList) {
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("sleep 1 | cat &echo a && echo b & pwd", arena);
+
+    ASSERT_EQ(line.lists.size(), 3u);
+    EXPECT_TRUE(line.lists[0].background);
+    EXPECT_EQ(line.lists[0].text, "sleep 1 | cat");
+    EXPECT_TRUE(line.lists[1].background);
+    EXPECT_EQ(line.lists[1].text, "echo a && echo b");
+    EXPECT_FALSE(line.lists[2].background);
+    EXPECT_EQ(line.lists[2].text, "pwd");
+    EXPECT_THROW(parse_line("& echo", arena), std::runtime_error);
+}
+
+TEST(LineParserTest, RedirectionsAttachToTheirCommand) {
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("cat < in.txt | sort > 'out file' 2>&1", arena);
+
+    const auto& commands = line.lists[0].items[0].pipeline.commands;
+    ASSERT_EQ(commands.size(), 2u);
+    ASSERT_EQ(commands[0].redirects.size(), 1u);
+    EXPECT_EQ(commands[0].redirects[0].type, RedirectType::Stdin);
+    EXPECT_EQ(commands[0].redirects[0].target, "in.txt");
+    ASSERT_EQ(commands[1].redirects.size(), 2u);
+    EXPECT_EQ(commands[1].redirects[0].type, RedirectType::Stdout);
+    EXPECT_EQ(commands[1].redirects[0].target, "out file");
+    EXPECT_EQ(commands[1].redirects[1].type, RedirectType::StderrToStdout);
+    EXPECT_EQ(words_of(commands[1]), std::vector<std::string>{"sort"});
+}
+
+TEST(LineParserTest, DescriptorPrefixOnlyAtWordStart) {
+    using V = std::vector<std::string>;
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("echo a2>x 2>>err", arena);
+
+    const SimpleCommand& command = line.lists[0].items[0].pipeline.commands[0];
+    EXPECT_EQ(words_of(command), (V{"echo", "a2"}));
+    ASSERT_EQ(command.redirects.size(), 2u);
+    EXPECT_EQ(command.redirects[0].type, RedirectType::Stdout);
+    EXPECT_EQ(command.redirects[1].type, RedirectType::StderrAppend);
+}
+
+TEST(LineParserTest, CommentsEndTheLine) {
+    using V = std::vector<std::string>;
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("echo a#b '#c' # ; rm -rf /", arena);
+
+    ASSERT_EQ(line.lists.size(), 1u);
+    EXPECT_EQ(words_of(line.lists[0].items[0].pipeline.commands[0]), (V{"echo", "a#b", "#c"}));
+    EXPECT_TRUE(parse_line("# only a comment", arena).lists.empty());
+    EXPECT_TRUE(parse_line("   ", arena).lists.empty());
+}
+
+TEST(LineParserTest, OnlyUnquotedGlobCharactersMarkWords) {
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("ls *.txt '*.md' \"a?\" b\\*", arena);
+
+    const auto& words = line.lists[0].items[0].pipeline.commands[0].words;
+    ASSERT_EQ(words.size(), 5u);
+    EXPECT_FALSE(words[0].glob);
+    EXPECT_TRUE(words[1].glob);
+    EXPECT_FALSE(words[2].glob);
+    EXPECT_FALSE(words[3].glob);
+    EXPECT_FALSE(words[4].glob);
+}
+
+TEST(LineParserTest, OnlyUnquotedBracesMarkWords) {
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("echo {a,b} '{a,b}' {a\\,b} \"x\"{1..3} {} {a}", arena);
+
+    const auto& words = line.lists[0].items[0].pipeline.commands[0].words;
+    ASSERT_EQ(words.size(), 7u);
+    EXPECT_FALSE(words[0].brace);
+    EXPECT_TRUE(words[1].brace);
+    EXPECT_FALSE(words[2].brace);
+    EXPECT_FALSE(words[3].brace);
+    EXPECT_TRUE(words[4].brace);
+    EXPECT_FALSE(words[5].brace);
+    EXPECT_FALSE(words[6].brace);
+}
+
+TEST(LineParserTest, RejectsBraceExpansionsOverTheLimit) {
+    std::pmr::monotonic_buffer_resource arena;
+    EXPECT_THROW(parse_line("echo {1..1000}{1..1000}{1..2}", arena), std::runtime_error);
+    EXPECT_NO_THROW(parse_line("echo {1..1000}{1..1000}", arena));
+}
+
+TEST(ExecuteLineTest, ExpandsBracesIntoArguments) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    execute_line("echo a{b,c{1..3}}d '{x,y}' {01..3..2}");
+    std::cout.rdbuf(old);
+    EXPECT_EQ(buffer.str(), "abd ac1d ac2d ac3d {x,y} 01 03\n");
+    EXPECT_EQ(tokenize_input("mkdir -p src/{core,io}"), (std::vector<std::string>{"mkdir", "-p", "src/core", "src/io"}));
+}
+
+TEST(LineParserTest, ExpandsVariablesInsideWords) {
+    using V = std::vector<std::string>;
+    setenv("LINE_PARSER_VAR", "value", 1);
+    unsetenv("LINE_PARSER_UNSET");
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("echo $LINE_PARSER_VAR/x ${LINE_PARSER_VAR}y \\$LINE_PARSER_VAR $LINE_PARSER_UNSET $", arena);
+
+    const SimpleCommand& command = line.lists[0].items[0].pipeline.commands[0];
+    ASSERT_EQ(command.words.size(), 6u);
+    EXPECT_TRUE(command.words[1].deferred);
+    EXPECT_EQ(command.words[1].text, "$LINE_PARSER_VAR/x"); // Expanded when the command runs
+    EXPECT_FALSE(command.words[3].deferred);
+    EXPECT_EQ(expanded_words_of(command, arena), (V{"echo", "value/x", "valuey", "$LINE_PARSER_VAR", "$"}));
+    unsetenv("LINE_PARSER_VAR");
+}
+
+TEST(LineParserTest, UnquotedExpansionResultsAreGlobbed) {
+    variable_store.set("line_parser_glob", "*.cpp");
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("echo $line_parser_glob \"$line_parser_glob\" $(echo 'a *.h') x=$line_parser_glob", arena);
+
+    std::pmr::vector<Word> expanded(&arena);
+    std::vector<ProcessSubstitution> substitutions;
+    for (const Word& word : line.lists[0].items[0].pipeline.commands[0].words) {
+        if (word.deferred) expand_word(word, arena, expanded, substitutions);
+    }
+    ASSERT_EQ(expanded.size(), 5u);
+    EXPECT_TRUE(expanded[0].glob);
+    EXPECT_FALSE(expanded[1].glob);
+    EXPECT_FALSE(expanded[2].glob);
+    EXPECT_TRUE(expanded[3].glob);
+    EXPECT_EQ(expanded[4].text, "x=*.cpp");
+    EXPECT_FALSE(expanded[4].glob); // Assignments stay one literal word
+    variable_store.unset("line_parser_glob");
+}
+
+TEST(LineParserTest, PlainWordsPointIntoTheInput) {
+    std::string input = "echo plain 'quoted'";
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line(input, arena);
+
+    const auto& words = line.lists[0].items[0].pipeline.commands[0].words;
+    ASSERT_EQ(words.size(), 3u);
+    EXPECT_EQ(words[1].text.data(), input.data() + 5);
+    EXPECT_EQ(words[2].text, "quoted");
+}
+
+TEST(LineParserTest, RejectsSyntaxErrors) {
+    std::pmr::monotonic_buffer_resource arena;
+    EXPECT_THROW(parse_line("| grep x", arena), std::runtime_error);
+    EXPECT_THROW(parse_line("echo a &&", arena), std::runtime_error);
+    EXPECT_THROW(parse_line("echo a ;; echo b", arena), std::runtime_error);
+    EXPECT_THROW(parse_line("echo >", arena), std::runtime_error);
+    EXPECT_THROW(parse_line("echo > | cat", arena), std::runtime_error);
+    EXPECT_NO_THROW(parse_line("echo a;", arena));
+}
+
+TEST(ExecuteLineTest, RunsListsRespectingQuotes) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    execute_line("echo 'a;b' && false && echo skipped || echo \"c||d\"; echo e");
+    std::cout.rdbuf(old);
+    EXPECT_EQ(buffer.str(), "a;b\nc||d\ne\n");
+}
+
+TEST(ExecuteLineTest, ExpandsWordsWhenTheirPipelineRuns) {
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(run_subcommand("false && echo $(echo SIDE-EFFECT >&2)"), "");
+    EXPECT_EQ(run_subcommand("true || echo > $(echo SIDE-EFFECT >&2)"), "");
+    EXPECT_EQ(testing::internal::GetCapturedStderr(), ""); // Skipped pipelines expand nothing
+
+    std::string cwd = std::filesystem::current_path().string();
+    EXPECT_EQ(run_subcommand("cd / && echo $(pwd) && cd " + cwd), "/");
+    EXPECT_EQ(std::filesystem::current_path().string(), cwd);
+    EXPECT_EQ(run_subcommand("line_parser_x=1 && echo $line_parser_x"), "1");
+    variable_store.unset("line_parser_x");
+}
+
+TEST(ExecuteLineTest, ListsFollowExitStatuses) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    execute_line("ls /definitely/not/here 2>/dev/null && echo found || echo missing");
+    execute_line("sh -c 'exit 0' && echo ok");
+    std::cout.rdbuf(old);
+    EXPECT_EQ(buffer.str(), "missing\nok\n");
+    EXPECT_EQ(last_exit_status, 0);
+}
+
+TEST(ExecuteLineTest, ReportsSyntaxErrorsWithoutRunning) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    testing::internal::CaptureStderr();
+    bool should_exit = execute_line("echo a |");
+    std::string err = testing::internal::GetCapturedStderr();
+    std::cout.rdbuf(old);
+    EXPECT_FALSE(should_exit);
+    EXPECT_TRUE(buffer.str().empty());
+    EXPECT_NE(err.find("syntax error near unexpected token `newline'"), std::string::npos);
+}
+
+TEST(ExecuteLineTest, AppliesStderrDuplicationAfterFileRedirection) {
+    const char* filename = "line_parser_test_both.txt";
+    execute_line(std::string("ls /definitely/not/here > ") + filename + " 2>&1");
+    std::ifstream f(filename);
+    std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find("/definitely/not/here"), std::string::npos);
+    unlink(filename);
+}
+
+TEST(LineParserTest, TimeKeywordPrefixesAList) {
+    std::pmr::monotonic_buffer_resource arena;
+    CommandLine line = parse_line("time -v ls | wc -l && echo ok; time; echo time", arena);
+
+    ASSERT_EQ(line.lists.size(), 3u);
+    EXPECT_EQ(line.lists[0].time, TimeMode::Verbose);
+    EXPECT_EQ(line.lists[0].text, "ls | wc -l && echo ok");
+    EXPECT_EQ(line.lists[0].items.size(), 2u);
+    EXPECT_EQ(line.lists[1].time, TimeMode::Summary);
+    EXPECT_TRUE(line.lists[1].items.empty());
+    EXPECT_EQ(line.lists[2].time, TimeMode::None);
+    EXPECT_EQ(words_of(line.lists[2].items[0].pipeline.commands[0]), (std::vector<std::string>{"echo", "time"}));
+}
+
+TEST(LineParserTest, HereDocumentsReadBodiesFromFollowingLines) {
+    std::vector<std::string> input = {"a $HERE_DOC_VAR \\$x \"q\"", "EOF", "\t\tkept $HERE_DOC_VAR", "\tEND", "after"};
+    size_t next = 0;
+    LineSource more_lines = [&](std::string& line) {
+        if (next == input.size()) return false;
+        line = input[next++];
+        return true;
+    };
+    variable_store.set("HERE_DOC_VAR", "v");
+    std::pmr::monotonic_buffer_resource arena;
+    LineParser parser("cat <<EOF | cat <<-'END' <<< \"$HERE_DOC_VAR w\"", arena, &more_lines);
+    std::optional<AndOrList> list = parser.next_list();
+
+    ASSERT_TRUE(list);
+    std::vector<ProcessSubstitution> substitutions;
+    const auto& commands = list->items[0].pipeline.commands;
+    ASSERT_EQ(commands.size(), 2u);
+    ASSERT_EQ(commands[0].redirects.size(), 1u);
+    EXPECT_EQ(commands[0].redirects[0].type, RedirectType::HereDocument);
+    EXPECT_EQ(expand_redirect_target(commands[0].redirects[0], arena, substitutions), "a v $x \"q\"\n");
+    ASSERT_EQ(commands[1].redirects.size(), 2u);
+    EXPECT_EQ(commands[1].redirects[0].expansion, Redirect::Expansion::None); // Quoted delimiter: no expansion
+    EXPECT_EQ(commands[1].redirects[0].target, "kept $HERE_DOC_VAR\n");
+    EXPECT_EQ(expand_redirect_target(commands[1].redirects[1], arena, substitutions), "v w\n");
+    EXPECT_EQ(next, 4u); // The line after the last body is left for the caller
+    variable_store.unset("HERE_DOC_VAR");
+}
+
+TEST(LineParserTest, UnterminatedHereDocumentEndsAtEndOfInput) {
+    std::pmr::monotonic_buffer_resource arena;
+    testing::internal::CaptureStderr();
+    CommandLine line = parse_line("cat <<EOF", arena);
+    std::string err = testing::internal::GetCapturedStderr();
+    EXPECT_EQ(line.lists[0].items[0].pipeline.commands[0].redirects[0].target, "");
+    EXPECT_NE(err.find("wanted `EOF'"), std::string::npos);
+    EXPECT_THROW(parse_line("cat <<", arena), std::runtime_error);
+}
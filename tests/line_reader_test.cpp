@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+#include "line_reader.h"
+
+static std::vector<std::string> read_all(const std::string& input, size_t capacity) {
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    EXPECT_EQ(write(fds[1], input.data(), input.size()), static_cast<ssize_t>(input.size()));
+    close(fds[1]);
+
+    BufferedLineReader reader(fds[0], capacity);
+    std::vector<std::string> lines;
+    std::string_view line;
+    while (reader.next_line(line)) {
+        lines.emplace_back(line);
+    }
+    close(fds[0]);
+    return lines;
+}
+
+TEST(LineReaderTest, SplitsLines) {
+    using V = std::vector<std::string>;
+    EXPECT_EQ(read_all("echo one\necho two\n", 1024), (V{"echo one", "echo two"}));
+    EXPECT_EQ(read_all("a\n\nb", 1024), (V{"a", "", "b"}));
+    EXPECT_EQ(read_all("", 1024), V{});
+}
+
+TEST(LineReaderTest, HandlesLinesAcrossBufferBoundaries) {
+    using V = std::vector<std::string>;
+    EXPECT_EQ(read_all("abc\ndefgh\nij\n", 4), (V{"abc", "defgh", "ij"}));
+
+    std::string long_line(10000, 'x');
+    EXPECT_EQ(read_all("short\n" + long_line + "\nend", 16), (V{"short", long_line, "end"}));
+}
+
+static std::string read_rest(int fd) {
+    std::string rest;
+    char chunk[64];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) rest.append(chunk, n);
+    return rest;
+}
+
+TEST(LineReaderTest, SharedPipeIsNotReadPastTheLine) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string input = "cat\nhello\n";
+    ASSERT_EQ(write(fds[1], input.data(), input.size()), static_cast<ssize_t>(input.size()));
+    close(fds[1]);
+
+    BufferedLineReader reader(fds[0], 1024, true);
+    std::string_view line;
+    ASSERT_TRUE(reader.next_line(line));
+    EXPECT_EQ(line, "cat");
+    reader.release();
+    EXPECT_EQ(read_rest(fds[0]), "hello\n");
+    close(fds[0]);
+}
+
+TEST(LineReaderTest, SharedFileIsRewoundOnRelease) {
+    FILE* file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    int fd = fileno(file);
+    std::string input = "one\ntwo\nthree\n";
+    ASSERT_EQ(write(fd, input.data(), input.size()), static_cast<ssize_t>(input.size()));
+    lseek(fd, 0, SEEK_SET);
+
+    BufferedLineReader reader(fd, 1024, true);
+    std::string_view line;
+    ASSERT_TRUE(reader.next_line(line));
+    EXPECT_EQ(line, "one");
+    reader.release();
+    char next;
+    ASSERT_EQ(read(fd, &next, 1), 1);
+    EXPECT_EQ(next, 't');
+    ASSERT_TRUE(reader.next_line(line));
+    EXPECT_EQ(line, "wo");
+    std::fclose(file);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "output_buffer.h"
+
+class OutputBufferTest : public ::testing::Test {
+protected:
+    void SetUp() override { fd = open(test_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644); }
+
+    void TearDown() override {
+        close(fd);
+        unlink(test_file.c_str());
+    }
+
+    std::string contents() {
+        std::ifstream file(test_file);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    std::string test_file = "output_buffer_test.txt";
+    int fd = -1;
+};
+
+TEST_F(OutputBufferTest, BatchesSmallWritesUntilFlush) {
+    FdOutputBuffer buffer(fd, 1024);
+    std::ostream out(&buffer);
+    for (int i = 0; i < 100; ++i) {
+        out << "line " << i << '\n';
+    }
+    EXPECT_EQ(buffer.write_calls(), 0);
+    EXPECT_TRUE(contents().empty());
+
+    out.flush();
+    EXPECT_EQ(buffer.write_calls(), 1);
+    EXPECT_TRUE(contents().starts_with("line 0\nline 1\n"));
+    EXPECT_TRUE(contents().ends_with("line 99\n"));
+}
+
+TEST_F(OutputBufferTest, LargeWriteGoesOutWithBufferedBytesInOneCall) {
+    FdOutputBuffer buffer(fd, 16);
+    std::ostream out(&buffer);
+    std::string large(1000, 'x');
+    out << "head:" << large;
+    EXPECT_EQ(buffer.write_calls(), 1);
+    EXPECT_EQ(contents(), "head:" + large);
+}
+
+TEST_F(OutputBufferTest, FlushesWhenFull) {
+    FdOutputBuffer buffer(fd, 8);
+    std::ostream out(&buffer);
+    for (char c = 'a'; c < 'a' + 20; ++c) {
+        out << c;
+    }
+    EXPECT_EQ(buffer.write_calls(), 2);
+    out.flush();
+    EXPECT_EQ(contents(), "abcdefghijklmnopqrst");
+}
+
+TEST_F(OutputBufferTest, FollowsDescriptorAfterDup2) {
+    FdOutputBuffer buffer(fd, 64);
+    std::ostream out(&buffer);
+    out << "first\n";
+    out.flush();
+
+    int other = open("output_buffer_test_2.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int saved = dup(fd);
+    dup2(other, fd);
+    out << "second\n";
+    out.flush();
+    dup2(saved, fd);
+    close(saved);
+    close(other);
+
+    EXPECT_EQ(contents(), "first\n");
+    std::ifstream redirected("output_buffer_test_2.txt");
+    std::string line;
+    std::getline(redirected, line);
+    EXPECT_EQ(line, "second");
+    unlink("output_buffer_test_2.txt");
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include "path_index.h"
+
+namespace fs = std::filesystem;
+
+class PathIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        const char* path = std::getenv("PATH");
+        original_path = path ? path : "";
+        test_dir = fs::temp_directory_path() / "path_index_test";
+        fs::create_directories(test_dir / "bin1");
+        fs::create_directories(test_dir / "bin2");
+    }
+
+    void TearDown() override {
+        setenv("PATH", original_path.c_str(), 1);
+        fs::remove_all(test_dir);
+    }
+
+    void create_file(const std::string& relative, mode_t mode) {
+        fs::path file = test_dir / relative;
+        std::ofstream(file) << "#!/bin/sh\n";
+        chmod(file.c_str(), mode);
+    }
+
+    std::set<std::string> matching(const std::string& prefix) {
+        std::set<std::string> out;
+        index.refresh();
+        index.add_matching(prefix, out);
+        return out;
+    }
+
+    PathCommandIndex index;
+    std::string original_path;
+    fs::path test_dir;
+};
+
+TEST_F(PathIndexTest, IndexesExecutablesAcrossPathDirectories) {
+    create_file("bin1/idx_alpha", 0755);
+    create_file("bin1/idx_data", 0644); // Not executable
+    create_file("bin2/idx_beta", 0755);
+    create_file("bin2/idx_alpha", 0755); // Duplicate name
+    setenv("PATH", ((test_dir / "bin1").string() + ":" + (test_dir / "bin2").string()).c_str(), 1);
+
+    EXPECT_EQ(matching("idx_"), (std::set<std::string>{"idx_alpha", "idx_beta"}));
+    EXPECT_EQ(matching("idx_b"), (std::set<std::string>{"idx_beta"}));
+    EXPECT_TRUE(matching("zzz").empty());
+    EXPECT_EQ(index.size(), 2);
+}
+
+TEST_F(PathIndexTest, PicksUpDirectoryChanges) {
+    create_file("bin1/idx_alpha", 0755);
+    setenv("PATH", (test_dir / "bin1").c_str(), 1);
+    EXPECT_EQ(matching("idx_"), (std::set<std::string>{"idx_alpha"}));
+
+    create_file("bin1/idx_gamma", 0755);
+    EXPECT_EQ(matching("idx_"), (std::set<std::string>{"idx_alpha", "idx_gamma"}));
+
+    fs::remove(test_dir / "bin1/idx_alpha");
+    EXPECT_EQ(matching("idx_"), (std::set<std::string>{"idx_gamma"}));
+}
+
+TEST_F(PathIndexTest, FollowsPathChanges) {
+    create_file("bin1/idx_alpha", 0755);
+    create_file("bin2/idx_beta", 0755);
+    setenv("PATH", (test_dir / "bin1").c_str(), 1);
+    EXPECT_EQ(matching("idx_"), (std::set<std::string>{"idx_alpha"}));
+
+    setenv("PATH", (test_dir / "bin2").c_str(), 1);
+    EXPECT_EQ(matching("idx_"), (std::set<std::string>{"idx_beta"}));
+}
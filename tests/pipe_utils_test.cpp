@@ -6,6 +6,7 @@
 #include <vector>
 #include "command_parser.h"
 #include "pipe_utils.h"
+#include "shell_options.h"
 #include "shell_utils.h"
 
 static std::vector<std::vector<std::string>> executed_commands;
@@ -75,3 +76,64 @@ TEST(PipeUtilsTest, EmptyPipelineDoesNothing) {
     run_pipeline(cmd);
     EXPECT_TRUE(executed_commands.empty());
 }
+
+TEST(PipeUtilsTest, StagesInheritOnlyTheirOwnPipes) {
+    // ls sees stdin, stdout, stderr and its own directory descriptor, however long the pipeline
+    std::string short_pipeline = run_subcommand("ls /proc/self/fd | wc -l");
+    EXPECT_EQ(run_subcommand("true | ls /proc/self/fd | cat | cat | wc -l"), short_pipeline);
+}
+
+TEST(PipeUtilsTest, PipeSizeOptionRaisesCapacity) {
+    EXPECT_TRUE(set_shell_option("pipesize=1M"));
+    EXPECT_EQ(shell_options.pipe_size, 1u << 20);
+    // 512 KiB fits in the pipe, so the writer finishes although nothing reads
+    testing::internal::CaptureStderr();
+    execute_line("sh -c 'head -c 524288 /dev/zero && echo written >&2' | sleep 0.3");
+    EXPECT_EQ(testing::internal::GetCapturedStderr(), "written\n");
+
+    EXPECT_TRUE(set_shell_option("pipesize=default"));
+    EXPECT_EQ(shell_options.pipe_size, 0u);
+    EXPECT_FALSE(set_shell_option("pipesize=1T"));
+    EXPECT_FALSE(set_shell_option("pipesize=4G"));
+}
+
+TEST(PipeUtilsTest, ReadOnlyBuiltinStagesRunOnThreads) {
+    ParsedCommand cmd;
+    cmd.pipeline = {{"echo", "hi"}, {"false"}};
+    StageThreads threads;
+    std::vector<pid_t> pids = launch_pipeline(cmd, false, &threads);
+    EXPECT_EQ(pids, std::vector<pid_t>({0, 0}));
+    ASSERT_EQ(threads.threads.size(), 2u);
+    for (std::thread& thread : threads.threads) thread.join();
+    EXPECT_EQ(threads.results[0].status, 0);
+    EXPECT_EQ(threads.results[1].status, 1);
+
+    // cd changes the shell's state, so the whole pipeline forks as before
+    cmd.pipeline = {{"echo", "hi"}, {"cd", "/"}};
+    StageThreads forked;
+    pids = launch_pipeline(cmd, false, &forked);
+    EXPECT_TRUE(forked.threads.empty());
+    ASSERT_EQ(pids.size(), 2u);
+    EXPECT_GT(pids[0], 0);
+    EXPECT_EQ(wait_for_processes(pids).back().status, 0);
+}
+
+TEST(PipeUtilsTest, ThreadedStagesReportErrorsOnTheirOwnStream) {
+    ParsedCommand cmd;
+    cmd.pipeline = {{"which", "no_such_command_a"}, {"which", "no_such_command_b"}};
+    StageThreads threads;
+    testing::internal::CaptureStderr();
+    launch_pipeline(cmd, false, &threads);
+    for (std::thread& thread : threads.threads) thread.join();
+    std::string err = testing::internal::GetCapturedStderr();
+    ASSERT_EQ(threads.threads.size(), 2u);
+    EXPECT_NE(err.find("no_such_command_a: command not found\n"), std::string::npos) << err;
+    EXPECT_NE(err.find("no_such_command_b: command not found\n"), std::string::npos) << err;
+}
+
+TEST(PipeUtilsTest, ThreadedStagesPassDataAndStatus) {
+    EXPECT_EQ(run_subcommand("echo one two | cat | tee /dev/null | cat | wc -w"), "2");
+    EXPECT_EQ(run_subcommand("echo a | false; echo $?"), "1");
+    // A reader that exits early must not take the shell down with SIGPIPE
+    EXPECT_EQ(run_subcommand("cat /proc/self/exe | head -c 3 | wc -c"), "3");
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "process_substitution.h"
+#include "shell_utils.h"
+
+namespace {
+
+    // No child is left unreaped
+    bool no_children() {
+        return waitpid(-1, nullptr, WNOHANG) == -1 && errno == ECHILD;
+    }
+
+} // namespace
+
+TEST(ProcessSubstitutionTest, InputSubstitutionsBecomeDevFdPaths) {
+    EXPECT_EQ(run_subcommand("cat <(echo a) <(echo b)"), "a\nb");
+    EXPECT_EQ(run_subcommand("echo <(true)").rfind("/dev/fd/", 0), 0u);
+    EXPECT_EQ(run_subcommand("diff <(echo x) <(echo x) && echo same"), "same");
+    EXPECT_EQ(run_subcommand("cat < <(echo redirected) | tr a-z A-Z"), "REDIRECTED");
+    EXPECT_TRUE(no_children());
+}
+
+TEST(ProcessSubstitutionTest, OutputSubstitutionIsFinishedWithTheCommand) {
+    const char* filename = "process_substitution_test_out.txt";
+    execute_line(std::string("echo written > >(tr a-z A-Z > ") + filename + ")");
+    std::ifstream f(filename);
+    std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, "WRITTEN\n");
+    unlink(filename);
+    EXPECT_TRUE(no_children());
+}
+
+TEST(ProcessSubstitutionTest, ProducersRunConcurrently) {
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(run_subcommand("cat <(sleep 0.3; echo a) <(sleep 0.3; echo b) | cat"), "a\nb");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(550));
+}
+
+TEST(ProcessSubstitutionTest, UnusedSubstitutionsAreReaped) {
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(run_subcommand("false && cat <(echo never >&2) || echo skipped"), "skipped");
+    EXPECT_EQ(run_subcommand("true || echo > >(echo never >&2)"), "");
+    execute_line("cat <(echo never >&2) &&");
+    std::string err = testing::internal::GetCapturedStderr();
+    EXPECT_EQ(err.find("never"), std::string::npos); // Skipped commands start no producer
+    EXPECT_NE(err.find("syntax error"), std::string::npos);
+    EXPECT_TRUE(no_children());
+}
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <string>
 #include <unistd.h>
+#include <vector>
 #include "command_parser.h"
 #include "redirect_guard.h"
 
@@ -14,6 +15,20 @@ namespace {
         return content;
     }
 
+    std::string read_all(int fd) {
+        std::string content;
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0) content.append(buf, n);
+        return content;
+    }
+
+    std::string fd_target(int fd) {
+        char target[256] = {0};
+        ssize_t n = readlink(("/proc/self/fd/" + std::to_string(fd)).c_str(), target, sizeof(target) - 1);
+        return n > 0 ? std::string(target, n) : "";
+    }
+
 } // namespace
 
 TEST(RedirectGuardTest, StdoutRedirectionWritesToFile) {
@@ -65,3 +80,30 @@ TEST(RedirectGuardTest, InvalidFileDoesNotCrash) {
     // Should not crash
     SUCCEED();
 }
+
+TEST(RedirectGuardTest, SmallHereDocumentUsesAPipe) {
+    int fd = open_here_document("line one\nline two\n");
+    ASSERT_GE(fd, 0);
+    EXPECT_TRUE(fd_target(fd).starts_with("pipe:"));
+    EXPECT_TRUE(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+    EXPECT_EQ(read_all(fd), "line one\nline two\n");
+    close(fd);
+}
+
+TEST(RedirectGuardTest, LargeHereDocumentUsesAMemoryFile) {
+    std::string text(1 << 20, 'x');
+    int fd = open_here_document(text);
+    ASSERT_GE(fd, 0);
+    EXPECT_TRUE(fd_target(fd).starts_with("/memfd:here-document"));
+    EXPECT_EQ(read_all(fd), text);
+    close(fd);
+}
+
+TEST(RedirectGuardTest, HereDocumentFeedsStdin) {
+    char buf[32] = {0};
+    {
+        RedirectGuard guard(std::vector<Redirection>{{RedirectType::HereDocument, "from memory\n"}});
+        fgets(buf, sizeof(buf), stdin);
+    }
+    EXPECT_STREQ(buf, "from memory\n");
+}
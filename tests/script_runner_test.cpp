@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "script_runner.h"
+
+TEST(ScriptRunnerTest, RunsCommandStringLines) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    run_command_string("echo one; echo two\n# a comment\n\n  echo three  \nexit\necho never");
+    std::cout.rdbuf(old);
+    EXPECT_EQ(buffer.str(), "one\ntwo\nthree\n");
+}
+
+TEST(ScriptRunnerTest, RunsScriptFromDescriptor) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string script = "#!/bin/shell\necho first\necho second && echo third\n";
+    ASSERT_EQ(write(fds[1], script.data(), script.size()), static_cast<ssize_t>(script.size()));
+    close(fds[1]);
+
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    run_script(fds[0]);
+    std::cout.rdbuf(old);
+    close(fds[0]);
+    EXPECT_EQ(buffer.str(), "first\nsecond\nthird\n");
+}
+
+TEST(ScriptRunnerTest, HereDocumentBodiesComeFromTheFollowingLines) {
+    const char* filename = "script_runner_test_heredoc.txt";
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    run_command_string(std::string("cat <<EOF > ") + filename + "; echo ran\nbody 1\nbody 2\nEOF\necho done");
+    std::cout.rdbuf(old);
+    EXPECT_EQ(buffer.str(), "ran\ndone\n");
+
+    std::ifstream f(filename);
+    std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, "body 1\nbody 2\n");
+    unlink(filename);
+}
+
+TEST(ScriptRunnerTest, ReturnsTheLastCommandsStatus) {
+    EXPECT_EQ(run_command_string("true"), 0);
+    EXPECT_EQ(run_command_string("false"), 1);
+    EXPECT_EQ(run_command_string("false\ntrue"), 0);
+    EXPECT_EQ(run_command_string("true; sh -c 'exit 3'"), 3);
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(run_command_string("definitely_not_a_command_12345"), 127);
+    testing::internal::GetCapturedStderr();
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string script = "true\nsh -c 'exit 5'\n";
+    ASSERT_EQ(write(fds[1], script.data(), script.size()), static_cast<ssize_t>(script.size()));
+    close(fds[1]);
+    EXPECT_EQ(run_script(fds[0]), 5);
+    close(fds[0]);
+}
+
+TEST(ScriptRunnerTest, ExitSetsTheShellsStatus) {
+    EXPECT_EQ(run_command_string("exit 3\necho never"), 3);
+    EXPECT_EQ(run_command_string("false; exit"), 1);
+    EXPECT_EQ(run_command_string("exit 260"), 4);
+    EXPECT_EQ(run_command_string("exit -1"), 255);
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(run_command_string("exit nope"), 2);
+    EXPECT_NE(testing::internal::GetCapturedStderr().find("numeric argument required"), std::string::npos);
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::string script = "true\nexit 4\nexit 9\n";
+    ASSERT_EQ(write(fds[1], script.data(), script.size()), static_cast<ssize_t>(script.size()));
+    close(fds[1]);
+    EXPECT_EQ(run_script(fds[0]), 4);
+    close(fds[0]);
+}
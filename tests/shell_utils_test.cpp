@@ -4,7 +4,15 @@
 #include <vector>
 #include <filesystem>
 #include <ctime>
+#include <algorithm>
+#include <fstream>
+#include "alias_manager.h"
+#include "shell_options.h"
 #include "shell_utils.h"
+#include "spawn_utils.h"
+#include "variable_store.h"
+
+namespace fs = std::filesystem;
 
 TEST(TrimWhitespaceTest, RemovesLeadingAndTrailingSpaces) {
     EXPECT_EQ(trim_whitespace("  hello  "), "hello");
@@ -157,4 +165,88 @@ TEST(CommandSubstitutionTest, SubstitutesDate) {
     time_t t = time(nullptr);
     strftime(datebuf, sizeof(datebuf), "%Y-%m-%d", localtime(&t));
     EXPECT_EQ(tokens[3], std::string(datebuf));
-}
\ No newline at end of file
+}
+TEST(CommandSubstitutionTest, RunsBuiltinsAndAliases) {
+    using V = std::vector<std::string>;
+    EXPECT_EQ(tokenize_input("echo $(type echo)"), (V{"echo", "echo", "is", "a", "shell", "builtin"}));
+
+    alias_manager.set_alias("subst_alias", "echo from alias");
+    EXPECT_EQ(tokenize_input("x$(subst_alias)"), (V{"xfrom", "alias"}));
+    alias_manager.remove_alias("subst_alias");
+}
+
+TEST(CommandSubstitutionTest, CapturesLargeExternalOutput) {
+    std::vector<std::string> tokens = tokenize_input("echo \"$(seq 1 100000)\"");
+    ASSERT_EQ(tokens.size(), 2u);
+    EXPECT_EQ(std::count(tokens[1].begin(), tokens[1].end(), '\n'), 99999);
+    EXPECT_TRUE(tokens[1].ends_with("\n100000"));
+}
+
+TEST(CommandSubstitutionTest, SplitsWordsOnBlanksAndNewlines) {
+    using V = std::vector<std::string>;
+    EXPECT_EQ(tokenize_input("echo $(printf ' a\\tb \\n\\nc ')"), (V{"echo", "a", "b", "c"}));
+}
+
+TEST(CommandSubstitutionTest, JoinsOutputOntoSurroundingText) {
+    using V = std::vector<std::string>;
+    EXPECT_EQ(tokenize_input("echo a$(echo b)c"), (V{"echo", "abc"}));
+    EXPECT_EQ(tokenize_input("echo a$(echo b c)d"), (V{"echo", "ab", "cd"}));
+    EXPECT_EQ(tokenize_input("echo a$(echo ' b ')c"), (V{"echo", "a", "b", "c"}));
+    EXPECT_EQ(tokenize_input("echo a$(true)b"), (V{"echo", "ab"}));
+}
+
+TEST(CommandSubstitutionTest, DoesNotSplitAssignmentValues) {
+    using V = std::vector<std::string>;
+    EXPECT_EQ(tokenize_input("x=$(echo hi)"), (V{"x=hi"}));
+    EXPECT_EQ(tokenize_input("x=pre$(echo 'a  b')post"), (V{"x=prea  bpost"}));
+
+    EXPECT_EQ(run_subcommand("subst_x=$(echo hi); echo $subst_x"), "hi");
+    EXPECT_EQ(last_exit_status, 0);
+    EXPECT_EQ(run_subcommand("subst_x=pre$(echo a b)post; echo \"$subst_x\""), "prea bpost");
+}
+
+TEST(CommandSubstitutionTest, LeavesTheShellUnchanged) {
+    std::string cwd = fs::current_path().string();
+    EXPECT_EQ(run_subcommand("true $(cd /); pwd"), cwd);
+    EXPECT_EQ(fs::current_path().string(), cwd);
+
+    run_subcommand("true $(export SUBST_LEAK=x; subst_leak_var=y)");
+    EXPECT_EQ(getenv("SUBST_LEAK"), nullptr);
+    EXPECT_FALSE(variable_store.get("subst_leak_var"));
+
+    run_subcommand("true $(alias subst_leak=ls)");
+    EXPECT_FALSE(alias_manager.has_alias("subst_leak"));
+
+    // Waits for the job to close the pipe, as other shells do, but leaves no job behind
+    EXPECT_EQ(run_subcommand("echo [$(sleep 0.1 &)]; jobs"), "[]");
+
+    EXPECT_FALSE(execute_line("echo $(exit 3)"));
+    EXPECT_EQ(run_subcommand("echo $(exit 3) $?"), "3");
+}
+
+TEST(AutobatchTest, SplitsGlobLongerThanArgMax) {
+    // Enough long names that the expanded glob cannot go to a single execve()
+    fs::path dir = fs::temp_directory_path() / "autobatch_test";
+    fs::remove_all(dir);
+    fs::create_directory(dir);
+    std::string stem(200, 'x');
+    size_t files = exec_argument_budget() / stem.size() + 1000;
+    for (size_t i = 0; i < files; ++i) {
+        std::ofstream(dir / (stem + std::to_string(i)));
+    }
+    std::string command = "/usr/bin/printf '%s\\n' " + dir.string() + "/x*";
+
+    testing::internal::CaptureStderr();
+    run_subcommand(command);
+    testing::internal::GetCapturedStderr();
+    EXPECT_NE(last_exit_status, 0);
+
+    set_shell_option("autobatch=on");
+    std::string output = run_subcommand(command);
+    set_shell_option("autobatch=off");
+    EXPECT_EQ(last_exit_status, 0);
+    EXPECT_EQ(static_cast<size_t>(std::count(output.begin(), output.end(), '\n')) + 1, files);
+    EXPECT_TRUE(output.starts_with(dir.string() + "/" + stem + "0\n"));
+
+    fs::remove_all(dir);
+}
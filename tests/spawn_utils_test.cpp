@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "command_parser.h"
+#include "shell_options.h"
+#include "shell_utils.h"
+#include "spawn_utils.h"
+
+static std::string read_file(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+class SpawnUtilsTest : public ::testing::TestWithParam<SpawnBackend> {
+protected:
+    void TearDown() override { unlink(output_file.c_str()); }
+
+    std::string output_file = "spawn_test_output.txt";
+};
+
+TEST_P(SpawnUtilsTest, RedirectsStdoutToFile) {
+    std::vector<SpawnFdAction> actions;
+    add_redirect_actions(actions, output_file, RedirectType::Stdout);
+    pid_t pid = spawn_process(GetParam(), find_executable("echo"), {"echo", "spawned"}, actions);
+    ASSERT_GT(pid, 0);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    EXPECT_EQ(read_file(output_file), "spawned\n");
+}
+
+TEST_P(SpawnUtilsTest, Dup2ActionConnectsPipe) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::vector<SpawnFdAction> actions = {
+        {SpawnFdAction::Kind::Dup2, STDOUT_FILENO, fds[1]},
+        {SpawnFdAction::Kind::Close, fds[0]},
+        {SpawnFdAction::Kind::Close, fds[1]},
+    };
+    pid_t pid = spawn_process(GetParam(), find_executable("echo"), {"echo", "piped"}, actions);
+    close(fds[1]);
+    ASSERT_GT(pid, 0);
+    char buf[64] = {};
+    ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+    EXPECT_EQ(std::string(buf, n > 0 ? n : 0), "piped\n");
+}
+
+// Runs the spawn and waits for it, returning what it wrote to stderr
+static std::string spawn_stderr(SpawnBackend backend, const std::string& path, const std::vector<SpawnFdAction>& actions) {
+    testing::internal::CaptureStderr();
+    pid_t pid = spawn_process(backend, path, {path}, actions);
+    if (pid > 0) waitpid(pid, nullptr, 0);
+    return testing::internal::GetCapturedStderr();
+}
+
+TEST_P(SpawnUtilsTest, ReportsRedirectTargetThatCannotBeOpened) {
+    std::vector<SpawnFdAction> actions;
+    add_redirect_actions(actions, "/definitely/not/here/out.txt", RedirectType::Stdout);
+    std::string err = spawn_stderr(GetParam(), find_executable("true"), actions);
+    EXPECT_NE(err.find("/definitely/not/here/out.txt: No such file or directory"), std::string::npos) << err;
+    EXPECT_EQ(err.find("exec"), std::string::npos) << err;
+}
+
+TEST_P(SpawnUtilsTest, ReportsPathThatCannotBeExecuted) {
+    std::ofstream(output_file) << "not a program\n"; // Created without execute permission
+    std::string err = spawn_stderr(GetParam(), "./" + output_file, {});
+    EXPECT_NE(err.find("./" + output_file + ": Permission denied"), std::string::npos) << err;
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, SpawnUtilsTest, ::testing::Values(SpawnBackend::PosixSpawn, SpawnBackend::Fork));
+
+TEST(ShellOptionsTest, SetSpawnBackend) {
+    EXPECT_TRUE(set_shell_option("spawn=fork"));
+    EXPECT_EQ(shell_options.spawn_backend, SpawnBackend::Fork);
+    EXPECT_TRUE(set_shell_option("spawn=posix_spawn"));
+    EXPECT_EQ(shell_options.spawn_backend, SpawnBackend::PosixSpawn);
+
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(set_shell_option("spawn=vfork"));
+    EXPECT_FALSE(set_shell_option("nosuchoption=1"));
+    testing::internal::GetCapturedStderr();
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "alias_manager.h"
+#include "command_hash.h"
+#include "state_snapshot.h"
+
+namespace fs = std::filesystem;
+
+class StateSnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override { path = (fs::temp_directory_path() / "state_snapshot_test.bin").string(); }
+    void TearDown() override { fs::remove(path); }
+
+    std::string path;
+    AliasManager aliases;
+    CommandHash commands;
+};
+
+TEST_F(StateSnapshotTest, RoundTripsAliasesCommandsAndHistory) {
+    aliases.set_alias("ll", "ls -l");
+    aliases.set_alias("gs", "git status");
+    commands.remember("sh", "/bin/sh", 7);
+    ASSERT_TRUE(write_snapshot(path, aliases, commands, {"echo one", "echo two"}));
+
+    auto snapshot = StateSnapshot::open(path);
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(snapshot->size(StateSnapshot::Section::Aliases), 2u);
+    auto ll = snapshot->find(StateSnapshot::Section::Aliases, "ll");
+    ASSERT_TRUE(ll.has_value());
+    EXPECT_EQ(ll->value, "ls -l");
+    EXPECT_FALSE(snapshot->find(StateSnapshot::Section::Aliases, "l").has_value());
+    auto sh = snapshot->find(StateSnapshot::Section::Commands, "sh");
+    ASSERT_TRUE(sh.has_value());
+    EXPECT_EQ(sh->value, "/bin/sh");
+    EXPECT_EQ(sh->number, 7u);
+    ASSERT_EQ(snapshot->size(StateSnapshot::Section::History), 2u);
+    EXPECT_EQ(snapshot->at(StateSnapshot::Section::History, 1).value, "echo two");
+    EXPECT_EQ(snapshot->hashed_path(), std::getenv("PATH"));
+}
+
+TEST_F(StateSnapshotTest, AttachedAliasesMaterializeOnUse) {
+    aliases.set_alias("ll", "ls -l");
+    aliases.set_alias("la", "ls -a");
+    ASSERT_TRUE(write_snapshot(path, aliases, commands, {}));
+
+    AliasManager fresh;
+    fresh.attach_snapshot(StateSnapshot::open(path));
+    fresh.set_alias("la", "ls -A");
+    EXPECT_EQ(fresh.expand_aliases({"ll", "x"}), (std::vector<std::string>{"ls", "-l", "x"}));
+    EXPECT_EQ(fresh.get_alias("la"), "ls -A");
+    EXPECT_TRUE(fresh.remove_alias("ll"));
+    EXPECT_FALSE(fresh.has_alias("ll"));
+    EXPECT_EQ(fresh.get_all_aliases().size(), 1u);
+}
+
+TEST_F(StateSnapshotTest, CommandsAreDroppedWhenPathDiffers) {
+    commands.remember("sh", "/bin/sh", 3);
+    ASSERT_TRUE(write_snapshot(path, aliases, commands, {}));
+    auto snapshot = StateSnapshot::open(path);
+
+    CommandHash same_path;
+    same_path.attach_snapshot(snapshot);
+    EXPECT_EQ(same_path.lookup("sh"), "/bin/sh");
+    EXPECT_EQ(same_path.get_all_entries().at("sh").hits, 4u);
+
+    std::string original = std::getenv("PATH");
+    setenv("PATH", "/nonexistent", 1);
+    CommandHash other_path;
+    other_path.attach_snapshot(snapshot);
+    EXPECT_EQ(other_path.lookup("sh"), "");
+    setenv("PATH", original.c_str(), 1);
+}
+
+TEST_F(StateSnapshotTest, RejectsTruncatedOrForeignFiles) {
+    EXPECT_EQ(StateSnapshot::open(path), nullptr);
+    aliases.set_alias("ll", "ls -l");
+    ASSERT_TRUE(write_snapshot(path, aliases, commands, {}));
+    fs::resize_file(path, fs::file_size(path) - 1);
+    EXPECT_EQ(StateSnapshot::open(path), nullptr);
+
+    std::ofstream(path) << "ll='ls -l'\n";
+    EXPECT_EQ(StateSnapshot::open(path), nullptr);
+}
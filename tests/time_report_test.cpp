@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "shell_utils.h"
+#include "time_report.h"
+
+TEST(TimeReportTest, PrintsTotalsLikeBash) {
+    std::vector<StageUsage> stages = {{"sort", false, 1.5, 0.25, 0.125, 2048}, {"cat", false, 1.5, 0.5, 0.0, 1024}};
+    std::ostringstream out;
+    print_time_report(out, 61.5, stages, false);
+    EXPECT_EQ(out.str(), "\nreal\t1m1.500s\nuser\t0m0.750s\nsys\t0m0.125s\n");
+}
+
+TEST(TimeReportTest, VerboseListsEveryStage) {
+    std::vector<StageUsage> stages = {{"a very long command line", false, 0.5, 0.25, 0.0, 2048},
+                                      {"echo hi", true, 0.0, 0.0, 0.0, 4096}};
+    std::ostringstream out;
+    print_time_report(out, 0.5, stages, true);
+    std::string report = out.str();
+    EXPECT_NE(report.find("1      a very long com..."), std::string::npos);
+    EXPECT_NE(report.find("2      echo hi*"), std::string::npos);
+    EXPECT_NE(report.find("2048 KiB"), std::string::npos);
+    EXPECT_NE(report.find("* builtin run in the shell"), std::string::npos);
+}
+
+TEST(TimeReportTest, TimesEveryStageOfAPipelineAndList) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    testing::internal::CaptureStderr();
+    execute_line("time -v sh -c 'exit 0' | cat && echo done");
+    std::string err = testing::internal::GetCapturedStderr();
+    std::cout.rdbuf(old);
+
+    EXPECT_EQ(buffer.str(), "done\n");
+    EXPECT_NE(err.find("1      sh -c exit 0"), std::string::npos);
+    EXPECT_NE(err.find("2      cat"), std::string::npos);
+    EXPECT_NE(err.find("3      echo done*"), std::string::npos);
+    EXPECT_NE(err.find("\nreal\t0m"), std::string::npos);
+    EXPECT_EQ(time_stages, nullptr);
+}
+
+TEST(TimeReportTest, PipelineStatusIsThatOfTheLastStage) {
+    testing::internal::CaptureStderr();
+    execute_line("time sh -c 'exit 3' | sh -c 'exit 5'");
+    std::string err = testing::internal::GetCapturedStderr();
+    EXPECT_EQ(last_exit_status, 5);
+    EXPECT_NE(err.find("user\t"), std::string::npos);
+}
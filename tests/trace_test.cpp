@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include "alias_manager.h"
+#include "shell_utils.h"
+#include "trace.h"
+
+class TraceTest : public ::testing::Test {
+protected:
+    void TearDown() override { tracer.disable(); }
+
+    static std::string json() {
+        std::ostringstream out;
+        tracer.write_json(out);
+        return out.str();
+    }
+};
+
+TEST_F(TraceTest, DisabledSpansRecordNothing) {
+    tracer.enable(8);
+    tracer.disable();
+    { TraceSpan span("ignored"); }
+    EXPECT_EQ(tracer.size(), 0u);
+}
+
+TEST_F(TraceTest, WritesCompleteEventsWithDetail) {
+    tracer.enable(8);
+    { TraceSpan span("find_executable", "say \"hi\""); }
+    ASSERT_EQ(tracer.size(), 1u);
+    std::string text = json();
+    EXPECT_NE(text.find("{\"name\":\"find_executable\",\"ph\":\"X\",\"ts\":"), std::string::npos);
+    EXPECT_NE(text.find("\"args\":{\"detail\":\"say \\\"hi\\\"\"}"), std::string::npos);
+    EXPECT_EQ(text.rfind("\n]}\n"), text.size() - 4);
+}
+
+TEST_F(TraceTest, RingKeepsTheNewestEvents) {
+    tracer.enable(3); // Rounded up to 4
+    const char* names[] = {"a", "b", "c", "d", "e", "f"};
+    for (const char* name : names) TraceSpan span(name);
+    EXPECT_EQ(tracer.size(), 4u);
+    std::string text = json();
+    EXPECT_EQ(text.find("\"name\":\"b\""), std::string::npos);
+    size_t c = text.find("\"name\":\"c\"");
+    size_t f = text.find("\"name\":\"f\"");
+    ASSERT_NE(c, std::string::npos);
+    ASSERT_NE(f, std::string::npos);
+    EXPECT_LT(c, f);
+}
+
+TEST_F(TraceTest, ExecutionPhasesAreTraced) {
+    alias_manager.set_alias("trace_test_true", "sh -c 'exit 0'");
+    tracer.enable();
+    testing::internal::CaptureStderr();
+    execute_line("trace_test_true | cat; ls *.definitely-no-match");
+    testing::internal::GetCapturedStderr();
+    tracer.disable();
+    alias_manager.remove_alias("trace_test_true");
+    std::string text = json();
+    for (const char* phase : {"execute_line", "parse", "expand_aliases", "find_executable", "waitpid", "expand_glob"}) {
+        EXPECT_NE(text.find(std::string("\"name\":\"") + phase + "\""), std::string::npos) << phase;
+    }
+}
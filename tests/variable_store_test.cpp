@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "shell_utils.h"
+#include "variable_store.h"
+
+namespace {
+
+    bool envp_contains(char* const* envp, std::string_view entry) {
+        for (; *envp; ++envp) {
+            if (entry == *envp) return true;
+        }
+        return false;
+    }
+
+} // namespace
+
+TEST(VariableStoreTest, LocalVariablesStayOutOfTheEnvironment) {
+    VariableStore store;
+    store.set("VS_LOCAL", "1");
+    EXPECT_EQ(store.get("VS_LOCAL"), "1");
+    EXPECT_FALSE(store.is_exported("VS_LOCAL"));
+    EXPECT_FALSE(envp_contains(store.envp(), "VS_LOCAL=1"));
+    EXPECT_EQ(std::getenv("VS_LOCAL"), nullptr);
+
+    store.export_variable("VS_LOCAL");
+    store.set("VS_LOCAL", "2");
+    EXPECT_TRUE(envp_contains(store.envp(), "VS_LOCAL=2"));
+    EXPECT_STREQ(std::getenv("VS_LOCAL"), "2");
+    EXPECT_TRUE(store.unset("VS_LOCAL"));
+    EXPECT_EQ(store.get("VS_LOCAL"), std::nullopt);
+    EXPECT_EQ(std::getenv("VS_LOCAL"), nullptr);
+}
+
+TEST(VariableStoreTest, EnvpIsRebuiltOnlyAfterExportedChanges) {
+    VariableStore store;
+    store.envp();
+    size_t builds = store.envp_builds();
+    store.set("VS_ONLY_LOCAL", "x");
+    store.envp();
+    EXPECT_EQ(store.envp_builds(), builds);
+    store.set_exported("VS_EXPORTED", "y");
+    store.envp();
+    store.envp();
+    EXPECT_EQ(store.envp_builds(), builds + 1);
+    store.unset("VS_EXPORTED");
+}
+
+TEST(VariableStoreTest, SurvivesGrowthAndDeletion) {
+    VariableStore store;
+    for (int i = 0; i < 2000; ++i) store.set("VS_" + std::to_string(i), std::to_string(i));
+    for (int i = 0; i < 2000; i += 2) EXPECT_TRUE(store.unset("VS_" + std::to_string(i)));
+    for (int i = 0; i < 2000; ++i) {
+        auto value = store.get("VS_" + std::to_string(i));
+        if (i % 2) {
+            EXPECT_EQ(value, std::to_string(i));
+        } else {
+            EXPECT_EQ(value, std::nullopt);
+        }
+    }
+}
+
+TEST(VariableStoreTest, PositionalAndSpecialParameters) {
+    VariableStore store;
+    store.set_positional("script.sh", {"a", "b c"});
+    EXPECT_EQ(store.get("0"), "script.sh");
+    EXPECT_EQ(store.get("2"), "b c");
+    EXPECT_EQ(store.get("3"), std::nullopt);
+    EXPECT_EQ(store.get("#"), "2");
+    EXPECT_EQ(store.get("@"), "a b c");
+    EXPECT_EQ(store.get("$"), std::to_string(getpid()));
+    EXPECT_EQ(store.get("!"), std::nullopt);
+    last_exit_status = 3;
+    EXPECT_EQ(store.get("?"), "3");
+    last_exit_status = 0;
+}
+
+TEST(VariableStoreTest, AssignmentsSetShellOrCommandVariables) {
+    testing::internal::CaptureStdout();
+    execute_line("VS_A=1; echo $VS_A; sh -c 'echo [$VS_A]'; VS_B=2 sh -c 'echo [$VS_B]'; echo [$VS_B]; false; echo $?");
+    std::cout.flush();
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "1\n[]\n[2]\n[]\n1\n");
+    EXPECT_EQ(variable_store.get("VS_A"), "1");
+    EXPECT_FALSE(variable_store.is_exported("VS_A"));
+    variable_store.unset("VS_A");
+}